@@ -9,9 +9,11 @@ P32: First audio pipeline after P30 MultimodalService + P31 VisionPipeline.
 Exports:
     AudioPipeline — end-to-end audio processing pipeline
     AudioQualityMonitor — quality tracking for audio pipeline calls
+    SharedCaptureRing — zero-copy reader for the desktop capture addon's shared-memory ring
 """
 
 from .audio_pipeline import AudioPipeline
 from .quality_monitor import AudioQualityMonitor
+from .shared_capture_ring import SharedCaptureRing
 
-__all__ = ["AudioPipeline", "AudioQualityMonitor"]
+__all__ = ["AudioPipeline", "AudioQualityMonitor", "SharedCaptureRing"]
@@ -0,0 +1,199 @@
+# =============================================================================
+# ANGELA-MATRIX: [L3] [βγδ] [B] [L2]
+# =============================================================================
+"""
+SharedCaptureRing — zero-copy reader for the desktop capture addon's
+shared-memory ring.
+
+The node-pulseaudio-capture addon, started with ``sharedMemory: { name }``,
+writes captured frames into a POSIX shared-memory object. This reader maps the
+same object and hands out numpy views straight onto it, so audio reaches
+``AudioPipeline`` without passing through JS, IPC or a JSON/base64 encode.
+
+The header layout is defined in
+``apps/desktop-app/native_modules/node-pulseaudio-capture/src/shared-memory-ring.h``.
+The ring is single-writer and never waits for readers: each reader keeps its
+own position and is moved forward (with ``dropped_frames`` counted) if the
+writer laps it. Views returned by :meth:`read` stay valid until the writer
+wraps around to them, i.e. roughly one buffer length; check
+:meth:`still_valid` after processing, or copy, if that is not enough.
+"""
+
+import ctypes
+import logging
+import mmap
+import os
+import platform
+import time
+from typing import Optional
+
+import numpy as np
+
+logger = logging.getLogger(__name__)
+
+MAGIC = b"ANGLRING"
+VERSION = 1
+
+_OFFSET_VERSION = 8
+_OFFSET_HEADER_SIZE = 12
+_OFFSET_SAMPLE_RATE = 16
+_OFFSET_CHANNELS = 20
+_OFFSET_SAMPLE_TYPE = 24
+_OFFSET_BYTES_PER_FRAME = 28
+_OFFSET_CAPACITY = 32
+_OFFSET_CLOSED = 40
+_OFFSET_COMMITTED = 64
+_OFFSET_RESERVED = 72
+_OFFSET_FUTEX = 128
+
+_SAMPLE_DTYPES = {0: np.float32, 1: np.int16, 2: np.int32}
+
+_SYS_FUTEX = {"x86_64": 202, "aarch64": 98, "arm64": 98}.get(platform.machine())
+_FUTEX_WAIT = 0
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+
+class SharedCaptureRing:
+    """Reader side of the capture addon's shared-memory ring."""
+
+    def __init__(self, name: str, from_start: bool = False):
+        path = "/dev/shm/" + name.lstrip("/")
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self._mmap = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        if self._mmap[:8] != MAGIC:
+            self._mmap.close()
+            raise ValueError(f"{path} is not a capture ring")
+
+        u32 = np.frombuffer(self._mmap, dtype=np.uint32, count=_OFFSET_FUTEX // 4 + 1)
+        if int(u32[_OFFSET_VERSION // 4]) != VERSION:
+            self._mmap.close()
+            raise ValueError(f"Unsupported capture ring version {int(u32[_OFFSET_VERSION // 4])}")
+
+        self.sample_rate = int(u32[_OFFSET_SAMPLE_RATE // 4])
+        self.channels = int(u32[_OFFSET_CHANNELS // 4])
+        self.dtype = np.dtype(_SAMPLE_DTYPES[int(u32[_OFFSET_SAMPLE_TYPE // 4])])
+        self.bytes_per_frame = int(u32[_OFFSET_BYTES_PER_FRAME // 4])
+        header_size = int(u32[_OFFSET_HEADER_SIZE // 4])
+
+        self._u32 = u32
+        self._u64 = np.frombuffer(self._mmap, dtype=np.uint64, count=_OFFSET_RESERVED // 8 + 1)
+        self._capacity = int(self._u64[_OFFSET_CAPACITY // 8])
+        self.capacity_frames = self._capacity // self.bytes_per_frame
+        # (frames, channels) view of the whole data region.
+        self._frames = np.frombuffer(
+            self._mmap, dtype=self.dtype, count=self._capacity // self.dtype.itemsize, offset=header_size
+        ).reshape(-1, self.channels)
+
+        # The mapping is read-only, so ctypes.from_buffer cannot be used to
+        # find its address; the header view's data pointer is the base.
+        self._futex_address = None
+        self._libc = None
+        if _SYS_FUTEX is not None:
+            self._futex_address = u32.ctypes.data + _OFFSET_FUTEX
+            self._libc = ctypes.CDLL(None, use_errno=True)
+
+        committed = self._committed()
+        self._position = max(0, committed - self._capacity) if from_start else committed
+        self._last_start = self._position
+        self.dropped_frames = 0
+
+    # --- Header access ---
+
+    def _committed(self) -> int:
+        return int(self._u64[_OFFSET_COMMITTED // 8])
+
+    def _reserved(self) -> int:
+        return int(self._u64[_OFFSET_RESERVED // 8])
+
+    @property
+    def closed(self) -> bool:
+        """True once the writer has stopped capturing."""
+        return bool(self._u32[_OFFSET_CLOSED // 4])
+
+    # --- Reading ---
+
+    def available(self) -> int:
+        """Frames written since the last read (capped at the ring capacity)."""
+        return min(self._committed() - self._position, self._capacity) // self.bytes_per_frame
+
+    def read(self, max_frames: Optional[int] = None) -> np.ndarray:
+        """Return a (frames, channels) view of the next unread frames.
+
+        The view never crosses the end of the ring, so a wrapped region takes
+        two calls. Returns an empty view when nothing new is available.
+        """
+        committed = self._committed()
+        if committed - self._position > self._capacity:
+            lapped = committed - self._capacity
+            self.dropped_frames += (lapped - self._position) // self.bytes_per_frame
+            self._position = lapped
+
+        start_frame = (self._position % self._capacity) // self.bytes_per_frame
+        frames = min(
+            (committed - self._position) // self.bytes_per_frame,
+            self.capacity_frames - start_frame,
+        )
+        if max_frames is not None:
+            frames = min(frames, max_frames)
+
+        self._last_start = self._position
+        self._position += frames * self.bytes_per_frame
+        return self._frames[start_frame : start_frame + frames]
+
+    def still_valid(self) -> bool:
+        """Whether the view returned by the last read() has not been overwritten."""
+        return self._reserved() - self._last_start <= self._capacity
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        """Block until new frames are committed or the ring is closed.
+
+        Uses a futex on the shared header where available and falls back to
+        polling every 5 ms otherwise. Returns False on timeout.
+        """
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            sequence = int(self._u32[_OFFSET_FUTEX // 4])
+            if self._committed() > self._position or self.closed:
+                return True
+            remaining = None if deadline is None else deadline - time.monotonic()
+            if remaining is not None and remaining <= 0:
+                return False
+            if self._futex_address is None:
+                time.sleep(0.005 if remaining is None else min(0.005, remaining))
+                continue
+            timespec = None
+            if remaining is not None:
+                timespec = ctypes.byref(_Timespec(int(remaining), int((remaining % 1) * 1e9)))
+            self._libc.syscall(
+                _SYS_FUTEX,
+                ctypes.c_void_p(self._futex_address),
+                _FUTEX_WAIT,
+                ctypes.c_uint32(sequence),
+                timespec,
+                None,
+                0,
+            )
+
+    def close(self) -> None:
+        self._frames = None
+        self._u32 = None
+        self._u64 = None
+        try:
+            self._mmap.close()
+        except BufferError:
+            # Views handed out by read() are still alive; the mapping is
+            # released when they are garbage collected.
+            logger.debug("SharedCaptureRing closed with live views")
+
+    def __enter__(self) -> "SharedCaptureRing":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
@@ -0,0 +1,125 @@
+import mmap
+import os
+import struct
+import sys
+
+import numpy as np
+import pytest
+from ai.audio.shared_capture_ring import SharedCaptureRing
+
+pytestmark = pytest.mark.skipif(
+    not sys.platform.startswith("linux"), reason="POSIX shared memory under /dev/shm"
+)
+
+HEADER_SIZE = 4096
+
+
+class _Writer:
+    """Python stand-in for the addon's SharedMemoryRing writer."""
+
+    def __init__(self, name, capacity_frames, channels=1, sample_type=0, bytes_per_sample=4):
+        self.path = "/dev/shm/" + name
+        self.frame_size = channels * bytes_per_sample
+        self.capacity = capacity_frames * self.frame_size
+        size = HEADER_SIZE + self.capacity
+        with open(self.path, "wb") as f:
+            f.truncate(size)
+        fd = os.open(self.path, os.O_RDWR)
+        self.mm = mmap.mmap(fd, size)
+        os.close(fd)
+        self.mm[0:8] = b"ANGLRING"
+        struct.pack_into(
+            "<6I", self.mm, 8, 1, HEADER_SIZE, 16000, channels, sample_type, self.frame_size
+        )
+        struct.pack_into("<Q", self.mm, 32, self.capacity)
+
+    def write(self, samples):
+        data = samples.tobytes()
+        (committed,) = struct.unpack_from("<Q", self.mm, 64)
+        struct.pack_into("<Q", self.mm, 72, committed + len(data))
+        offset = committed % self.capacity
+        first = min(len(data), self.capacity - offset)
+        self.mm[HEADER_SIZE + offset : HEADER_SIZE + offset + first] = data[:first]
+        if first < len(data):
+            self.mm[HEADER_SIZE : HEADER_SIZE + len(data) - first] = data[first:]
+        struct.pack_into("<Q", self.mm, 64, committed + len(data))
+        (sequence,) = struct.unpack_from("<I", self.mm, 128)
+        struct.pack_into("<I", self.mm, 128, (sequence + 1) & 0xFFFFFFFF)
+
+    def close(self):
+        struct.pack_into("<I", self.mm, 40, 1)
+
+    def unlink(self):
+        self.mm.close()
+        os.unlink(self.path)
+
+
+@pytest.fixture
+def writer():
+    w = _Writer(f"angela-test-ring-{os.getpid()}", capacity_frames=100, channels=2)
+    yield w
+    w.unlink()
+
+
+def _ring(writer):
+    return SharedCaptureRing(os.path.basename(writer.path))
+
+
+def test_reads_header_and_frames_without_copying(writer):
+    ring = _ring(writer)
+    assert ring.sample_rate == 16000
+    assert ring.channels == 2
+    assert ring.dtype == np.float32
+    assert ring.capacity_frames == 100
+    assert ring.read().shape == (0, 2)
+
+    samples = np.arange(40, dtype=np.float32).reshape(20, 2)
+    writer.write(samples)
+    assert ring.available() == 20
+    view = ring.read()
+    np.testing.assert_array_equal(view, samples)
+    assert not view.flags.owndata
+    assert ring.still_valid()
+    ring.close()
+
+
+def test_wrapped_region_is_returned_in_two_views(writer):
+    ring = _ring(writer)
+    writer.write(np.zeros((90, 2), dtype=np.float32))
+    ring.read()
+
+    samples = np.arange(40, dtype=np.float32).reshape(20, 2)
+    writer.write(samples)
+    first = ring.read()
+    second = ring.read()
+    assert len(first) == 10 and len(second) == 10
+    np.testing.assert_array_equal(np.concatenate([first, second]), samples)
+    ring.close()
+
+
+def test_lapped_reader_skips_ahead_and_counts_drops(writer):
+    ring = _ring(writer)
+    writer.write(np.zeros((60, 2), dtype=np.float32))
+    stale = ring.read(10)
+    writer.write(np.ones((90, 2), dtype=np.float32))
+    assert not ring.still_valid()
+
+    view = ring.read()
+    assert ring.dropped_frames == 40
+    assert len(view) + len(ring.read()) == 100
+    del stale, view
+    ring.close()
+
+
+def test_wait_times_out_then_sees_writes_and_close(writer):
+    ring = _ring(writer)
+    assert ring.wait(timeout=0.02) is False
+
+    writer.write(np.zeros((5, 2), dtype=np.float32))
+    assert ring.wait(timeout=0.02) is True
+    ring.read()
+
+    writer.close()
+    assert ring.wait(timeout=1.0) is True
+    assert ring.closed
+    ring.close()
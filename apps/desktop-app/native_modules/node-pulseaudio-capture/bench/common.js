@@ -0,0 +1,87 @@
+// Helpers shared by the JS benchmarks: timing, a temporary null sink to
+// capture from, and CPU accounting for this process and the sound server.
+
+const { execFileSync, spawn } = require('child_process');
+const fs = require('fs');
+
+function nowMs() {
+    return Number(process.hrtime.bigint()) / 1e6;
+}
+
+function delay(ms) {
+    return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+// Loads a null sink named `sinkName`; `args` are extra module arguments such
+// as 'rate=48000'. Returns the module index for unloadModule().
+function loadNullSink(sinkName, args = []) {
+    const output = execFileSync('pactl', ['load-module', 'module-null-sink', `sink_name=${sinkName}`, ...args]);
+    return output.toString().trim();
+}
+
+function unloadModule(moduleIndex) {
+    execFileSync('pactl', ['unload-module', moduleIndex]);
+}
+
+// Keeps the sink from suspending, so its monitor delivers continuously.
+function startSilence(sinkName) {
+    const player = spawn('pacat', [
+        '--playback', `--device=${sinkName}`, '--format=float32le', '--rate=48000', '--channels=2', '--raw'
+    ], { stdio: ['pipe', 'ignore', 'inherit'] });
+    const chunk = Buffer.alloc(4800 * 8);
+    const writeChunk = () => {
+        if (player.stdin.write(chunk)) {
+            setImmediate(writeChunk);
+        } else {
+            player.stdin.once('drain', writeChunk);
+        }
+    };
+    player.stdin.on('error', () => {});
+    writeChunk();
+    return player;
+}
+
+function serverPid() {
+    for (const name of ['pulseaudio', 'pipewire-pulse']) {
+        try {
+            return Number(execFileSync('pgrep', ['-x', '-n', name]).toString().trim());
+        } catch (error) {
+            // try the next server name
+        }
+    }
+    return null;
+}
+
+// User plus system CPU time of `pid` so far; 0 without a pid.
+function processCpuSeconds(pid) {
+    if (!pid) {
+        return 0;
+    }
+    const fields = fs.readFileSync(`/proc/${pid}/stat`, 'utf8').split(') ')[1].split(' ');
+    return (Number(fields[11]) + Number(fields[12])) / 100;
+}
+
+// Median / p95 / max of a list of milliseconds; null when it is empty.
+function summary(values) {
+    if (values.length === 0) {
+        return null;
+    }
+    const sorted = values.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        medianMs: Number(pick(0.5).toFixed(2)),
+        p95Ms: Number(pick(0.95).toFixed(2)),
+        maxMs: Number(sorted[sorted.length - 1].toFixed(2))
+    };
+}
+
+module.exports = {
+    nowMs,
+    delay,
+    loadNullSink,
+    unloadModule,
+    startSilence,
+    serverPid,
+    processCpuSeconds,
+    summary
+};
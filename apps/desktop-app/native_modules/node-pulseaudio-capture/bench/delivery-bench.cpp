@@ -0,0 +1,202 @@
+// Native cost of the per-fragment delivery stages, without a sound server.
+//
+// The fake backend produces a 48 kHz stereo float32 sine unthrottled, and
+// each stage runs inside its fragment callback exactly where the read
+// callback would run it. For every stage it prints one JSON line with the
+// throughput of backend plus stage, the time spent in the stage per
+// fragment (p50 / p99 / max ns) and the heap allocations per fragment,
+// counted by replacing the global operator new. bench/delivery-bench.js
+// measures the same path end to end through N-API.
+//
+// Usage: ./build/Release/delivery-bench [seconds of audio per stage]
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/audio-converter.h"
+#include "../src/fake-capture-backend.h"
+#include "../src/history-buffer.h"
+#include "../src/rolling-archive.h"
+#include "../src/spsc-ring-buffer.h"
+
+static std::atomic<uint64_t> allocations{0};
+// Where the block-copy stage hands its blocks, so the allocation cannot be
+// optimised away.
+static uint8_t* volatile lastBlock = nullptr;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+static const uint32_t kRate = 48000;
+static const uint32_t kChannels = 2;
+static const pa_usec_t kFragmentUsec = 20000;
+
+struct Stage {
+    const char* name;
+    // Runs once per fragment on the backend thread.
+    std::function<void(const CaptureFragment&)> work;
+};
+
+static uint64_t Percentile(std::vector<uint64_t>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+}
+
+static void RunStage(const Stage& stage, double seconds) {
+    size_t expectedFragments = static_cast<size_t>(seconds * 1e6 / kFragmentUsec) + 1;
+    std::vector<uint64_t> durations;
+    durations.reserve(expectedFragments);
+    uint64_t stageAllocations = 0;
+    uint64_t frames = 0;
+    std::atomic<bool> ended{false};
+
+    FakeBackendConfig config;
+    config.realtime = false;
+    config.duration = seconds;
+    FakeCaptureBackend backend(config);
+
+    CaptureBackendCallbacks callbacks;
+    callbacks.fragment = [&](const CaptureFragment& fragment) {
+        uint64_t before = allocations.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        stage.work(fragment);
+        auto end = std::chrono::steady_clock::now();
+        stageAllocations += allocations.load(std::memory_order_relaxed) - before;
+        if (durations.size() < durations.capacity()) {
+            durations.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        }
+        frames += fragment.length / (kChannels * sizeof(float));
+    };
+    callbacks.ended = [&]() { ended.store(true, std::memory_order_release); };
+
+    pa_sample_spec spec;
+    spec.format = PA_SAMPLE_FLOAT32LE;
+    spec.rate = kRate;
+    spec.channels = kChannels;
+    pa_channel_map channelMap;
+    std::memset(&channelMap, 0, sizeof(channelMap));
+    std::string error;
+
+    auto begin = std::chrono::steady_clock::now();
+    if (!backend.Open("", &spec, channelMap, kFragmentUsec, std::move(callbacks), &error)) {
+        std::fprintf(stderr, "%s: %s\n", stage.name, error.c_str());
+        return;
+    }
+    while (!ended.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    backend.Close();
+
+    size_t fragments = durations.size();
+    std::sort(durations.begin(), durations.end());
+    std::printf("{\"bench\":\"delivery-native\",\"stage\":\"%s\",\"rate\":%u,\"channels\":%u,\"fragmentMs\":%.0f,"
+                "\"fragments\":%zu,\"samplesPerSec\":%.0f,\"realtimeFactor\":%.1f,"
+                "\"stageNs\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu},\"allocationsPerFragment\":%.2f}\n",
+                stage.name, kRate, kChannels, kFragmentUsec / 1000.0, fragments,
+                static_cast<double>(frames * kChannels) / elapsed, static_cast<double>(frames) / kRate / elapsed,
+                static_cast<unsigned long long>(Percentile(durations, 0.5)),
+                static_cast<unsigned long long>(Percentile(durations, 0.99)),
+                static_cast<unsigned long long>(durations.empty() ? 0 : durations.back()),
+                fragments ? static_cast<double>(stageAllocations) / fragments : 0.0);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 60.0;
+    const size_t frameSize = kChannels * sizeof(float);
+
+    AudioConverter converter(SampleType::Float32, kRate, kChannels, 16000, 1);
+    HistoryBuffer history(kRate, kRate * 30, frameSize);
+
+    // Pull mode: a consumer thread drains the ring like read() would.
+    SpscRingBuffer<uint8_t> ring(kRate * frameSize, OverflowPolicy::DropOldest);
+    std::atomic<bool> draining{true};
+    std::thread consumer([&]() {
+        std::vector<uint8_t> scratch(kRate / 50 * frameSize);
+        while (draining.load(std::memory_order_relaxed)) {
+            if (ring.Read(scratch.data(), scratch.size()) == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    });
+
+    char archivePath[] = "/tmp/delivery-bench-XXXXXX";
+    int archiveFd = mkstemp(archivePath);
+    if (archiveFd >= 0) {
+        close(archiveFd);
+    }
+    std::string error;
+    std::shared_ptr<RollingArchive> archive = RollingArchive::Open(archivePath, kRate * 61, kRate, kChannels, 0,
+        static_cast<uint32_t>(frameSize), &error);
+    if (!archive) {
+        std::fprintf(stderr, "archive: %s\n", error.c_str());
+    }
+
+    int64_t nanos = 0;
+    const std::vector<Stage> stages = {
+        { "backend", [](const CaptureFragment&) {} },
+        { "convert-16k-mono", [&](const CaptureFragment& f) {
+            size_t frames = 0;
+            converter.Process(f.data, f.length / frameSize, &frames);
+        } },
+        // Typed-array delivery allocates and fills a block per fragment and
+        // V8 frees it once the array is collected.
+        { "block-copy", [](const CaptureFragment& f) {
+            uint8_t* block = new uint8_t[f.length];
+            std::memcpy(block, f.data, f.length);
+            delete[] lastBlock;
+            lastBlock = block;
+        } },
+        { "pull-ring", [&](const CaptureFragment& f) {
+            ring.Write(static_cast<const uint8_t*>(f.data), f.length);
+        } },
+        { "history", [&](const CaptureFragment& f) {
+            history.Write(static_cast<const uint8_t*>(f.data), f.length / frameSize, f.captureNanos);
+        } },
+        { "archive", [&](const CaptureFragment& f) {
+            if (archive) {
+                archive->Write(static_cast<const uint8_t*>(f.data), f.length / frameSize, nanos);
+                nanos += static_cast<int64_t>(f.length / frameSize) * 1000000000 / kRate;
+            }
+        } },
+    };
+
+    for (const Stage& stage : stages) {
+        RunStage(stage, seconds);
+    }
+
+    delete[] lastBlock;
+    draining = false;
+    consumer.join();
+    archive.reset();
+    unlink(archivePath);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// End-to-end benchmark of the delivery path, from the read callback to the JS
+// callback, for each delivery mode:
+//   array       delivery: 'array' (a plain Array, one property set per sample)
+//   typedarray  one external-backed typed array per fragment
+//   blocks      typed arrays coalesced into 100 ms blocks
+//
+// Two phases per mode, one JSON line each:
+//   throughput  the fake backend produces 48 kHz stereo as fast as it can for
+//               `seconds` of audio; reports the samples per second that reached
+//               the JS callback and the share of blocks the queue dropped
+//   realtime    `seconds` of real-time capture; reports delivery latency
+//               (p50 / p99 us), main-thread CPU per second of audio (event loop
+//               utilisation), process CPU, and GC runs per 1000 blocks as the
+//               JS-side allocation cost
+//
+// --source=fake (default) runs without a sound server. --source=null-sink
+// captures the monitor of a temporary null sink fed with silence instead, and
+// skips the throughput phase. bench/delivery-bench.cpp reports the native
+// per-fragment stage cost and allocations.
+//
+// Usage: node bench/delivery-bench.js [--source=fake|null-sink] [--seconds=10]
+
+const { performance, PerformanceObserver } = require('perf_hooks');
+const PulseAudioCapture = require('../index');
+const { delay, loadNullSink, unloadModule, startSilence } = require('./common');
+
+const SINK_NAME = 'angela_delivery_bench';
+const BASE_OPTIONS = { rate: 48000, channels: 2, format: 'f32le', fragmentMs: 10 };
+const MODES = [
+    { name: 'array', options: { delivery: 'array' } },
+    { name: 'typedarray', options: {} },
+    { name: 'blocks', options: { blockMs: 100 } }
+];
+
+const args = Object.fromEntries(process.argv.slice(2).map((arg) => {
+    const [key, value] = arg.replace(/^--/, '').split('=');
+    return [key, value];
+}));
+const source = args.source || 'fake';
+const seconds = Number(args.seconds || 10);
+
+function gcCounter() {
+    const counter = { runs: 0, ms: 0 };
+    const observer = new PerformanceObserver((list) => {
+        for (const entry of list.getEntries()) {
+            counter.runs++;
+            counter.ms += entry.duration;
+        }
+    });
+    observer.observe({ entryTypes: ['gc'] });
+    counter.stop = () => observer.disconnect();
+    return counter;
+}
+
+// Resolves once `done()` holds, checked every 10 ms.
+function until(done) {
+    return new Promise((resolve) => {
+        const poll = () => (done() ? resolve() : setTimeout(poll, 10));
+        poll();
+    });
+}
+
+async function measureThroughput(mode) {
+    const capture = new PulseAudioCapture();
+    let samples = 0;
+    let delivered = 0;
+    let lastArrival = 0;
+    const ended = new Promise((resolve) => capture.once('ended', resolve));
+    const begin = performance.now();
+    await capture.start(null, (block, info) => {
+        samples += block.length;
+        delivered = info.frame + block.length / BASE_OPTIONS.channels;
+        lastArrival = performance.now();
+    }, Object.assign({}, BASE_OPTIONS, mode.options, {
+        backend: { type: 'fake', source: 'sine', realtime: false, duration: seconds }
+    }));
+    // Blocks and events travel on separate queues. The run is over when the
+    // blocks reach the frame 'ended' reports, or, if the queue dropped the
+    // last of them, when it has drained; the clock stops at the last block.
+    const { frame } = await ended;
+    await until(() => delivered >= frame
+        || (capture.getStats().blocksDropped > 0 && capture.getStats().queueDepth === 0));
+    const elapsed = (lastArrival - begin) / 1000;
+    const stats = capture.getStats();
+    await capture.stop();
+
+    const blocks = stats.blocksDelivered + stats.blocksDropped;
+    console.log(JSON.stringify({
+        bench: 'delivery',
+        phase: 'throughput',
+        source,
+        mode: mode.name,
+        audioSeconds: seconds,
+        samplesPerSec: Math.round(samples / elapsed),
+        blocksDelivered: stats.blocksDelivered,
+        dropRatio: Number((blocks ? stats.blocksDropped / blocks : 0).toFixed(4)),
+        callbackP99Us: stats.callbackDuration.p99Us
+    }));
+}
+
+async function measureRealtime(mode) {
+    const capture = new PulseAudioCapture();
+    const backend = source === 'fake' ? { backend: { type: 'fake', source: 'sine' } } : {};
+    const device = source === 'fake' ? null : `${SINK_NAME}.monitor`;
+    let blocks = 0;
+
+    await capture.start(device, () => {
+        blocks++;
+    }, Object.assign({}, BASE_OPTIONS, mode.options, backend));
+    // Skip connection setup and the first server timing updates.
+    await delay(500);
+
+    const gc = gcCounter();
+    const startBlocks = blocks;
+    const startElu = performance.eventLoopUtilization();
+    const startCpu = process.cpuUsage();
+    await delay(seconds * 1000);
+    const elu = performance.eventLoopUtilization(startElu);
+    const cpu = process.cpuUsage(startCpu);
+    gc.stop();
+    const measuredBlocks = blocks - startBlocks;
+    const stats = capture.getStats();
+    await capture.stop();
+
+    console.log(JSON.stringify({
+        bench: 'delivery',
+        phase: 'realtime',
+        source,
+        mode: mode.name,
+        seconds,
+        blocks: measuredBlocks,
+        latencyP50Us: stats.deliveryLatency.p50Us,
+        latencyP99Us: stats.deliveryLatency.p99Us,
+        mainThreadMsPerSec: Number((elu.active / seconds).toFixed(2)),
+        mainThreadUtilization: Number(elu.utilization.toFixed(4)),
+        processCpuMsPerSec: Number(((cpu.user + cpu.system) / 1000 / seconds).toFixed(2)),
+        gcRunsPer1000Blocks: Number((measuredBlocks ? gc.runs * 1000 / measuredBlocks : 0).toFixed(2)),
+        gcMsPerSec: Number((gc.ms / seconds).toFixed(3)),
+        blocksDropped: stats.blocksDropped
+    }));
+}
+
+async function main() {
+    let moduleIndex = null;
+    let player = null;
+    if (source === 'null-sink') {
+        moduleIndex = loadNullSink(SINK_NAME);
+        player = startSilence(SINK_NAME);
+        await delay(500);
+    } else if (source !== 'fake') {
+        throw new Error(`unknown source ${source}`);
+    }
+
+    try {
+        for (const mode of MODES) {
+            if (source === 'fake') {
+                await measureThroughput(mode);
+            }
+            await measureRealtime(mode);
+        }
+    } finally {
+        if (player) {
+            player.kill();
+            unloadModule(moduleIndex);
+        }
+    }
+}
+
+main().catch((error) => {
+    console.error('Benchmark failed:', error.message);
+    process.exit(1);
+});
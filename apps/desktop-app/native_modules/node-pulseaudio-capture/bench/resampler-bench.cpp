@@ -0,0 +1,128 @@
+// Quality and CPU benchmark for the capture-side conversion stage.
+//
+// For every SIMD level and rate pair it reports real-time factor, the SNR of
+// in-band tones and the rejection of an out-of-band tone, one JSON object per
+// line. bench/resampler-vs-pulse.js runs the same comparison against the
+// PulseAudio server's own resampler on a live null sink.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../src/audio-converter.h"
+
+static const double kPi = 3.14159265358979323846;
+
+struct RatePair {
+    uint32_t input;
+    uint32_t output;
+};
+
+// Fits a sine of known frequency by least squares and returns the ratio of
+// the fitted tone's power to the residual's, in dB, plus the tone amplitude.
+static void FitTone(const std::vector<float>& signal, size_t skip, double frequency, uint32_t rate,
+                    double* snrDb, double* amplitude) {
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    for (size_t i = skip; i < signal.size(); i++) {
+        double w = 2.0 * kPi * frequency * static_cast<double>(i) / rate;
+        double s = std::sin(w);
+        double c = std::cos(w);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += signal[i] * s;
+        yc += signal[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+
+    double tone = 0, residual = 0;
+    for (size_t i = skip; i < signal.size(); i++) {
+        double w = 2.0 * kPi * frequency * static_cast<double>(i) / rate;
+        double fitted = a * std::sin(w) + b * std::cos(w);
+        tone += fitted * fitted;
+        residual += (signal[i] - fitted) * (signal[i] - fitted);
+    }
+    *snrDb = 10.0 * std::log10(tone / std::max(residual, 1e-30));
+    *amplitude = std::sqrt(a * a + b * b);
+}
+
+static std::vector<float> MakeStereoTone(double frequency, uint32_t rate, size_t frames) {
+    std::vector<float> samples(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        float v = static_cast<float>(0.5 * std::sin(2.0 * kPi * frequency * static_cast<double>(i) / rate));
+        samples[2 * i] = v;
+        samples[2 * i + 1] = v;
+    }
+    return samples;
+}
+
+static std::vector<float> Convert(AudioConverter& converter, const std::vector<float>& input, size_t chunkFrames) {
+    std::vector<float> output;
+    size_t frames = input.size() / 2;
+    for (size_t offset = 0; offset < frames; offset += chunkFrames) {
+        size_t n = std::min(chunkFrames, frames - offset);
+        size_t produced = 0;
+        const float* out = converter.Process(input.data() + offset * 2, n, &produced);
+        output.insert(output.end(), out, out + produced);
+    }
+    return output;
+}
+
+int main() {
+    const RatePair pairs[] = { { 48000, 16000 }, { 44100, 16000 }, { 48000, 44100 } };
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2 };
+    const uint32_t qualityOptions[] = { 8, 16, 32 };
+    const double seconds = 10.0;
+
+    for (const RatePair& pair : pairs) {
+        size_t frames = static_cast<size_t>(pair.input * seconds);
+        size_t chunkFrames = pair.input / 50;
+
+        for (uint32_t zeroCrossings : qualityOptions) {
+            for (SimdLevel requested : levels) {
+                SimdKernels kernels = GetSimdKernels(requested);
+                if (kernels.level != requested) {
+                    continue;
+                }
+
+                std::vector<float> input = MakeStereoTone(1000.0, pair.input, frames);
+                AudioConverter converter(SampleType::Float32, pair.input, 2, pair.output, 1, zeroCrossings, kernels);
+                auto start = std::chrono::steady_clock::now();
+                std::vector<float> output = Convert(converter, input, chunkFrames);
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                size_t skip = pair.output / 10;
+                double snr1k, amp1k;
+                FitTone(output, skip, 1000.0, pair.output, &snr1k, &amp1k);
+
+                double nearNyquist = 0.4 * pair.output;
+                AudioConverter edgeConverter(SampleType::Float32, pair.input, 2, pair.output, 1, zeroCrossings, kernels);
+                std::vector<float> edge = Convert(edgeConverter, MakeStereoTone(nearNyquist, pair.input, frames), chunkFrames);
+                double snrEdge, ampEdge;
+                FitTone(edge, skip, nearNyquist, pair.output, &snrEdge, &ampEdge);
+
+                // A tone above the output Nyquist (but below the input
+                // Nyquist) must not alias back in.
+                double outOfBand = 0.5 * pair.output + 0.75 * (0.5 * pair.input - 0.5 * pair.output);
+                AudioConverter aliasConverter(SampleType::Float32, pair.input, 2, pair.output, 1, zeroCrossings, kernels);
+                std::vector<float> aliased = Convert(aliasConverter, MakeStereoTone(outOfBand, pair.input, frames), chunkFrames);
+                double energy = 0;
+                for (size_t i = skip; i < aliased.size(); i++) {
+                    energy += aliased[i] * aliased[i];
+                }
+                double rms = std::sqrt(energy / std::max<size_t>(1, aliased.size() - skip));
+                double rejectionDb = 20.0 * std::log10(0.5 / std::sqrt(2.0) / std::max(rms, 1e-12));
+
+                std::printf("{\"bench\":\"resampler\",\"inputRate\":%u,\"outputRate\":%u,\"zeroCrossings\":%u,"
+                            "\"simd\":\"%s\",\"realtimeFactor\":%.1f,\"snr1kDb\":%.1f,\"snrEdgeDb\":%.1f,"
+                            "\"edgeGainDb\":%.2f,\"aliasRejectionDb\":%.1f}\n",
+                            pair.input, pair.output, zeroCrossings, SimdLevelName(kernels.level),
+                            seconds / elapsed, snr1k, snrEdge, 20.0 * std::log10(ampEdge / 0.5), rejectionDb);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Compares the native conversion stage with the PulseAudio server's resampler.
+//
+// A 1 kHz tone is played into a temporary null sink at 48 kHz stereo and its
+// monitor is captured at 16 kHz mono twice: once with the server doing the
+// conversion, once with the server delivering 48 kHz stereo and the addon
+// converting. For each run it prints one JSON line with the tone SNR, the
+// capture process CPU time and the sound server CPU time.
+//
+// Usage: node bench/resampler-vs-pulse.js [seconds]
+
+const { spawn } = require('child_process');
+const PulseAudioCapture = require('../index');
+const { delay, loadNullSink, unloadModule, serverPid, processCpuSeconds } = require('./common');
+
+const SINK_NAME = 'angela_resampler_bench';
+const TONE_HZ = 1000;
+const PLAY_RATE = 48000;
+const TARGET_RATE = 16000;
+const seconds = Number(process.argv[2] || 5);
+
+function startTone() {
+    const player = spawn('pacat', [
+        '--playback', `--device=${SINK_NAME}`, '--format=float32le',
+        `--rate=${PLAY_RATE}`, '--channels=2', '--raw'
+    ], { stdio: ['pipe', 'ignore', 'inherit'] });
+
+    const chunkFrames = PLAY_RATE / 10;
+    let position = 0;
+    const writeChunk = () => {
+        const chunk = new Float32Array(chunkFrames * 2);
+        for (let i = 0; i < chunkFrames; i++) {
+            const v = 0.5 * Math.sin(2 * Math.PI * TONE_HZ * (position + i) / PLAY_RATE);
+            chunk[2 * i] = v;
+            chunk[2 * i + 1] = v;
+        }
+        position += chunkFrames;
+        if (player.stdin.write(Buffer.from(chunk.buffer))) {
+            setImmediate(writeChunk);
+        } else {
+            player.stdin.once('drain', writeChunk);
+        }
+    };
+    player.stdin.on('error', () => {});
+    writeChunk();
+    return player;
+}
+
+// Least-squares fit of a sine at a known frequency; returns SNR in dB.
+function toneSnr(samples, rate, frequency) {
+    let ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+    for (let i = 0; i < samples.length; i++) {
+        const w = 2 * Math.PI * frequency * i / rate;
+        const s = Math.sin(w), c = Math.cos(w);
+        ss += s * s; cc += c * c; sc += s * c;
+        ys += samples[i] * s; yc += samples[i] * c;
+    }
+    const det = ss * cc - sc * sc;
+    const a = (ys * cc - yc * sc) / det;
+    const b = (yc * ss - ys * sc) / det;
+    let tone = 0, residual = 0;
+    for (let i = 0; i < samples.length; i++) {
+        const w = 2 * Math.PI * frequency * i / rate;
+        const fitted = a * Math.sin(w) + b * Math.cos(w);
+        tone += fitted * fitted;
+        residual += (samples[i] - fitted) ** 2;
+    }
+    return 10 * Math.log10(tone / Math.max(residual, 1e-30));
+}
+
+async function run(mode, options) {
+    const capture = new PulseAudioCapture();
+    const blocks = [];
+    const pid = serverPid();
+    const serverBefore = processCpuSeconds(pid);
+    const clientBefore = process.cpuUsage();
+
+    await capture.start(`${SINK_NAME}.monitor`, (samples) => blocks.push(Float32Array.from(samples)), options);
+    await delay(seconds * 1000);
+    await capture.stop();
+
+    const client = process.cpuUsage(clientBefore);
+    const serverSeconds = processCpuSeconds(pid) - serverBefore;
+    const format = capture.getFormat();
+
+    const total = blocks.reduce((n, b) => n + b.length, 0);
+    const samples = new Float32Array(total);
+    let offset = 0;
+    for (const block of blocks) {
+        samples.set(block, offset);
+        offset += block.length;
+    }
+    // Skip the first half second: sink start-up and filter warm-up.
+    const steady = samples.subarray(Math.min(samples.length, format.sampleRate / 2));
+
+    console.log(JSON.stringify({
+        bench: 'resampler-vs-pulse',
+        mode,
+        seconds,
+        sampleRate: format.sampleRate,
+        channels: format.channels,
+        simd: format.conversion ? format.conversion.simd : null,
+        snrDb: Number(toneSnr(steady, format.sampleRate, TONE_HZ).toFixed(1)),
+        clientCpuMs: Number(((client.user + client.system) / 1000).toFixed(1)),
+        serverCpuMs: Number((serverSeconds * 1000).toFixed(1))
+    }));
+}
+
+async function main() {
+    const moduleIndex = loadNullSink(SINK_NAME);
+    const player = startTone();
+    try {
+        await delay(500);
+        await run('server', { rate: TARGET_RATE, channels: 1, format: 'f32le' });
+        await run('native', {
+            rate: PLAY_RATE, channels: 2, format: 'f32le',
+            convert: { rate: TARGET_RATE, channels: 1 }
+        });
+    } finally {
+        player.kill();
+        unloadModule(moduleIndex);
+    }
+}
+
+main().catch((error) => {
+    console.error('Benchmark failed:', error.message);
+    process.exit(1);
+});
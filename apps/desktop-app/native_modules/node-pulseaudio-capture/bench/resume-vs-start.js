@@ -0,0 +1,101 @@
+// Compares resuming a corked stream with starting capture from scratch.
+//
+// A null sink is kept running with silence and its monitor is captured
+// repeatedly in three ways:
+//   cold-start  start() with no other user of the shared PulseAudio
+//               connection, so each iteration also connects to the server
+//   warm-start  start() while the device registry holds the connection
+//   resume      pause() then resume() on one running capture
+// For each mode it prints one JSON line with the time until the returned
+// promise settled and until the first block arrived (median / p95 / max ms).
+//
+// Usage: node bench/resume-vs-start.js [iterations]
+
+const PulseAudioCapture = require('../index');
+const { nowMs, delay, loadNullSink, unloadModule, startSilence, summary } = require('./common');
+
+const SINK_NAME = 'angela_resume_bench';
+const OPTIONS = { rate: 48000, channels: 2, format: 'f32le', fragmentMs: 10 };
+const iterations = Number(process.argv[2] || 20);
+
+function report(mode, settled, firstBlock) {
+    console.log(JSON.stringify({
+        bench: 'resume-vs-start',
+        mode,
+        iterations,
+        fragmentMs: OPTIONS.fragmentMs,
+        settled: summary(settled),
+        firstBlock: summary(firstBlock)
+    }));
+}
+
+// Resolves with the time of the next block delivered to `capture`.
+function nextBlock(state) {
+    return new Promise((resolve) => {
+        state.onBlock = () => {
+            state.onBlock = null;
+            resolve(nowMs());
+        };
+    });
+}
+
+async function measureStarts(mode) {
+    const settled = [];
+    const firstBlock = [];
+    for (let i = 0; i < iterations; i++) {
+        const capture = new PulseAudioCapture();
+        const state = { onBlock: null };
+        const block = nextBlock(state);
+        const begin = nowMs();
+        await capture.start(`${SINK_NAME}.monitor`, () => state.onBlock && state.onBlock(), OPTIONS);
+        settled.push(nowMs() - begin);
+        firstBlock.push(await block - begin);
+        await capture.stop();
+    }
+    report(mode, settled, firstBlock);
+}
+
+async function measureResume() {
+    const settled = [];
+    const firstBlock = [];
+    const capture = new PulseAudioCapture();
+    const state = { onBlock: null };
+    await capture.start(`${SINK_NAME}.monitor`, () => state.onBlock && state.onBlock(), OPTIONS);
+    for (let i = 0; i < iterations; i++) {
+        await capture.pause();
+        // Let blocks already in flight drain before timing the resume.
+        await delay(50);
+        const block = nextBlock(state);
+        const begin = nowMs();
+        await capture.resume();
+        settled.push(nowMs() - begin);
+        firstBlock.push(await block - begin);
+    }
+    await capture.stop();
+    report('resume', settled, firstBlock);
+}
+
+async function main() {
+    const moduleIndex = loadNullSink(SINK_NAME);
+    const player = startSilence(SINK_NAME);
+    try {
+        await delay(500);
+        await measureStarts('cold-start');
+
+        // A device listener keeps the shared connection open between captures.
+        const onChange = () => {};
+        PulseAudioCapture.deviceEvents.on('devicechange', onChange);
+        await PulseAudioCapture.listDevices();
+        await measureStarts('warm-start');
+        await measureResume();
+        PulseAudioCapture.deviceEvents.off('devicechange', onChange);
+    } finally {
+        player.kill();
+        unloadModule(moduleIndex);
+    }
+}
+
+main().catch((error) => {
+    console.error('Benchmark failed:', error.message);
+    process.exit(1);
+});
@@ -0,0 +1,253 @@
+// Measures the true emit-to-callback latency of capture for a range of
+// buffer attributes, so fragmentMs and adjustLatency can be chosen from data.
+//
+// A temporary null sink is fed continuously by a paced pacat player. Every
+// CHIRP_INTERVAL_MS a windowed chirp replaces the silence; the time its first
+// sample is handed to the player is the emit time. PulseAudioCapture records
+// the sink's monitor, and the chirp is located in the captured stream by
+// normalised cross-correlation. From the block containing the onset we get
+//   emitToJs       emit -> the JS callback receiving that block (the total)
+//   emitToCapture  emit -> the capture timestamp of the onset (player and
+//                  sink buffering; the same for every configuration)
+//   captureToJs    capture timestamp -> JS callback (what the buffer
+//                  attributes control)
+// as median / p95 / max ms, next to the CPU the configuration costs: main
+// thread (event loop utilisation), the whole process, and the sound server.
+//
+// One JSON line per configuration on stdout; a summary table on stderr.
+//
+// Usage: node bench/roundtrip-latency.js [chirps per configuration]
+
+const { spawn } = require('child_process');
+const { performance } = require('perf_hooks');
+const PulseAudioCapture = require('../index');
+const {
+    nowMs, delay, loadNullSink, unloadModule, serverPid, processCpuSeconds, summary
+} = require('./common');
+
+const SINK_NAME = 'angela_roundtrip_bench';
+const RATE = 48000;
+const CHIRP_MS = 10;
+const CHIRP_INTERVAL_MS = 400;
+// Audio kept queued in the player ahead of real time.
+const PLAYER_LEAD_MS = 10;
+const DETECTION_THRESHOLD = 0.5;
+const FRAGMENT_MS = [2, 5, 10, 20, 40];
+const chirps = Number(process.argv[2] || 15);
+
+// Linear 2-6 kHz sweep under a Hann window: a sharp, unambiguous
+// correlation peak that survives the sink's resampling.
+function makeChirp() {
+    const length = RATE * CHIRP_MS / 1000;
+    const chirp = new Float32Array(length);
+    const f0 = 2000;
+    const f1 = 6000;
+    const seconds = length / RATE;
+    for (let i = 0; i < length; i++) {
+        const t = i / RATE;
+        const phase = 2 * Math.PI * (f0 * t + (f1 - f0) * t * t / (2 * seconds));
+        const window = 0.5 - 0.5 * Math.cos(2 * Math.PI * i / (length - 1));
+        chirp[i] = 0.8 * window * Math.sin(phase);
+    }
+    return chirp;
+}
+
+// Writes silence at the sink rate, keeping PLAYER_LEAD_MS queued, and
+// splices in the chirp on request. emit() resolves with the emit time.
+function startPlayer(chirp) {
+    const player = spawn('pacat', [
+        '--playback', `--device=${SINK_NAME}`, '--format=float32le', `--rate=${RATE}`, '--channels=1',
+        '--raw', `--latency-msec=${PLAYER_LEAD_MS}`
+    ], { stdio: ['pipe', 'ignore', 'inherit'] });
+    player.stdin.on('error', () => {});
+
+    const chunkFrames = RATE / 1000;
+    const start = nowMs();
+    let written = 0;
+    let pending = null;
+    let chirpOffset = -1;
+    let running = true;
+
+    const pump = () => {
+        if (!running) {
+            return;
+        }
+        const target = (nowMs() - start + PLAYER_LEAD_MS) * RATE / 1000;
+        while (written < target) {
+            const chunk = new Float32Array(chunkFrames);
+            if (pending && chirpOffset < 0) {
+                chirpOffset = 0;
+                pending.resolve(nowMs());
+            }
+            if (chirpOffset >= 0) {
+                const n = Math.min(chunkFrames, chirp.length - chirpOffset);
+                chunk.set(chirp.subarray(chirpOffset, chirpOffset + n));
+                chirpOffset += n;
+                if (chirpOffset >= chirp.length) {
+                    chirpOffset = -1;
+                    pending = null;
+                }
+            }
+            player.stdin.write(Buffer.from(chunk.buffer));
+            written += chunkFrames;
+        }
+        setTimeout(pump, 1);
+    };
+    pump();
+
+    return {
+        emit() {
+            return new Promise((resolve) => {
+                pending = { resolve };
+            });
+        },
+        stop() {
+            running = false;
+            player.kill();
+        }
+    };
+}
+
+// Index of the best normalised match of `template` in samples[from, to).
+function correlate(samples, template, from, to) {
+    let templateEnergy = 0;
+    for (let i = 0; i < template.length; i++) {
+        templateEnergy += template[i] * template[i];
+    }
+    const end = Math.min(to, samples.length - template.length);
+    let energy = 0;
+    for (let i = 0; i < template.length && from + i < samples.length; i++) {
+        energy += samples[from + i] * samples[from + i];
+    }
+    let best = { index: -1, score: 0 };
+    for (let k = from; k < end; k++) {
+        let dot = 0;
+        for (let i = 0; i < template.length; i++) {
+            dot += samples[k + i] * template[i];
+        }
+        const score = dot / Math.sqrt(templateEnergy * Math.max(energy, 1e-12));
+        if (score > best.score) {
+            best = { index: k, score };
+        }
+        energy += samples[k + template.length] * samples[k + template.length] - samples[k] * samples[k];
+    }
+    return best;
+}
+
+async function measure(player, chirp, config) {
+    const capture = new PulseAudioCapture();
+    const blocks = [];
+    let captured = 0;
+
+    const format = await capture.start(`${SINK_NAME}.monitor`, (samples, info) => {
+        blocks.push({ samples: samples.slice(), start: captured, timestamp: info.timestamp, arrival: nowMs() });
+        captured += samples.length;
+    }, { rate: RATE, channels: 1, format: 'f32le', fragmentMs: config.fragmentMs, adjustLatency: config.adjustLatency });
+    await delay(300);
+
+    const pid = serverPid();
+    const serverBefore = processCpuSeconds(pid);
+    const cpuBefore = process.cpuUsage();
+    const eluBefore = performance.eventLoopUtilization();
+    const begin = nowMs();
+
+    const emits = [];
+    for (let i = 0; i < chirps; i++) {
+        emits.push(await player.emit());
+        await delay(CHIRP_INTERVAL_MS);
+    }
+
+    const elapsed = (nowMs() - begin) / 1000;
+    const elu = performance.eventLoopUtilization(eluBefore);
+    const cpu = process.cpuUsage(cpuBefore);
+    const serverSeconds = processCpuSeconds(pid) - serverBefore;
+    await capture.stop();
+
+    const samples = new Float32Array(captured);
+    for (const block of blocks) {
+        samples.set(block.samples, block.start);
+    }
+
+    const emitToJs = [];
+    const emitToCapture = [];
+    const captureToJs = [];
+    const scores = [];
+    for (const emit of emits) {
+        // Search from the first block captured after the emit until the next chirp.
+        const first = blocks.find((block) => block.timestamp + block.samples.length * 1000 / RATE >= emit - 20);
+        if (!first) {
+            continue;
+        }
+        const from = first.start;
+        const to = from + Math.floor(RATE * (CHIRP_INTERVAL_MS - CHIRP_MS) / 1000);
+        const match = correlate(samples, chirp, from, to);
+        if (match.score < DETECTION_THRESHOLD) {
+            continue;
+        }
+        const block = blocks.find((b) => match.index >= b.start && match.index < b.start + b.samples.length);
+        const onsetCapture = block.timestamp + (match.index - block.start) * 1000 / RATE;
+        emitToJs.push(block.arrival - emit);
+        emitToCapture.push(onsetCapture - emit);
+        captureToJs.push(block.arrival - onsetCapture);
+        scores.push(match.score);
+    }
+
+    return {
+        bench: 'roundtrip-latency',
+        fragmentMs: config.fragmentMs,
+        adjustLatency: config.adjustLatency,
+        grantedFragmentMs: format.grantedFragmentMs,
+        chirps,
+        detected: emitToJs.length,
+        minScore: scores.length ? Number(Math.min(...scores).toFixed(3)) : null,
+        emitToJs: summary(emitToJs),
+        emitToCapture: summary(emitToCapture),
+        captureToJs: summary(captureToJs),
+        mainThreadMsPerSec: Number((elu.active / elapsed).toFixed(2)),
+        processCpuMsPerSec: Number(((cpu.user + cpu.system) / 1000 / elapsed).toFixed(2)),
+        serverCpuMsPerSec: Number((serverSeconds * 1000 / elapsed).toFixed(2))
+    };
+}
+
+function printTable(results) {
+    const header = ['fragmentMs', 'adjust', 'granted', 'detected', 'emit->JS p50', 'p95', 'capture->JS p50',
+        'main ms/s', 'proc ms/s', 'server ms/s'];
+    const rows = results.map((r) => [
+        r.fragmentMs, r.adjustLatency ? 'yes' : 'no', r.grantedFragmentMs, `${r.detected}/${r.chirps}`,
+        r.emitToJs ? r.emitToJs.medianMs : '-', r.emitToJs ? r.emitToJs.p95Ms : '-',
+        r.captureToJs ? r.captureToJs.medianMs : '-',
+        r.mainThreadMsPerSec, r.processCpuMsPerSec, r.serverCpuMsPerSec
+    ].map(String));
+    const widths = header.map((h, i) => Math.max(h.length, ...rows.map((row) => row[i].length)));
+    const line = (cells) => cells.map((cell, i) => cell.padStart(widths[i])).join('  ');
+    console.error(line(header));
+    for (const row of rows) {
+        console.error(line(row));
+    }
+}
+
+async function main() {
+    const chirp = makeChirp();
+    const moduleIndex = loadNullSink(SINK_NAME, [`rate=${RATE}`, 'channels=1']);
+    const player = startPlayer(chirp);
+    const results = [];
+    try {
+        await delay(500);
+        for (const adjustLatency of [true, false]) {
+            for (const fragmentMs of FRAGMENT_MS) {
+                const result = await measure(player, chirp, { fragmentMs, adjustLatency });
+                console.log(JSON.stringify(result));
+                results.push(result);
+            }
+        }
+    } finally {
+        player.stop();
+        unloadModule(moduleIndex);
+    }
+    printTable(results);
+}
+
+main().catch((error) => {
+    console.error('Benchmark failed:', error.message);
+    process.exit(1);
+});
@@ -1,4 +1,9 @@
 {
+  "variables": {
+    "build_benchmarks%": 0,
+    "with_opus%": "<!(pkg-config --exists opus && echo 1 || echo 0)",
+    "with_liburing%": "<!(pkg-config --exists liburing && echo 1 || echo 0)"
+  },
   "targets": [
     {
       "target_name": "pulseaudio-capture",
@@ -6,7 +11,26 @@
         "std": "c++17"
       },
       "sources": [
-        "src/pulseaudio-capture.cpp"
+        "src/pulseaudio-capture.cpp",
+        "src/audio-converter.cpp",
+        "src/polyphase-resampler.cpp",
+        "src/simd-kernels.cpp",
+        "src/fft.cpp",
+        "src/voice-activity-detector.cpp",
+        "src/feature-extractor.cpp",
+        "src/envelope-follower.cpp",
+        "src/shared-memory-ring.cpp",
+        "src/device-registry.cpp",
+        "src/pulse-connection.cpp",
+        "src/stream-aligner.cpp",
+        "src/capture-session.cpp",
+        "src/echo-canceller.cpp",
+        "src/history-buffer.cpp",
+        "src/opus-encoder-stage.cpp",
+        "src/recording-sink.cpp",
+        "src/rolling-archive.cpp",
+        "src/pulse-capture-backend.cpp",
+        "src/fake-capture-backend.cpp"
       ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")"
@@ -19,8 +43,63 @@
       ],
       "libraries": [
         "-lpulse",
-        "-lpulse-simple"
+        "-lpulse-simple",
+        "-lrt"
+      ],
+      "conditions": [
+        ["with_opus==1", {
+          "defines": [
+            "HAVE_OPUS"
+          ],
+          "cflags": [
+            "<!@(pkg-config --cflags opus)"
+          ],
+          "libraries": [
+            "<!@(pkg-config --libs opus)"
+          ]
+        }],
+        ["with_liburing==1", {
+          "defines": [
+            "HAVE_LIBURING"
+          ],
+          "libraries": [
+            "<!@(pkg-config --libs liburing)"
+          ]
+        }]
       ]
     }
+  ],
+  "conditions": [
+    ["build_benchmarks==1", {
+      "targets": [
+        {
+          "target_name": "resampler-bench",
+          "type": "executable",
+          "sources": [
+            "bench/resampler-bench.cpp",
+            "src/audio-converter.cpp",
+            "src/polyphase-resampler.cpp",
+            "src/simd-kernels.cpp"
+          ]
+        },
+        {
+          "target_name": "delivery-bench",
+          "type": "executable",
+          "sources": [
+            "bench/delivery-bench.cpp",
+            "src/fake-capture-backend.cpp",
+            "src/audio-converter.cpp",
+            "src/polyphase-resampler.cpp",
+            "src/simd-kernels.cpp",
+            "src/history-buffer.cpp",
+            "src/rolling-archive.cpp"
+          ],
+          "libraries": [
+            "-lpulse",
+            "-lpthread"
+          ]
+        }
+      ]
+    }]
   ]
 }
@@ -128,6 +128,14 @@ else
     log_success "PulseAudio开发库已安装"
 fi
 
+# libopus为可选依赖，缺少时encode选项不可用
+if pkg-config --exists opus 2>/dev/null; then
+    log_success "libopus已安装，启用Opus编码"
+else
+    log_warning "未找到libopus-dev，Opus编码（encode选项）将不可用"
+    log "如需启用: sudo apt-get install -y libopus-dev"
+fi
+
 # 检查是否安装了编译工具
 if ! command -v g++ &> /dev/null; then
     log_warning "g++编译器未安装"
@@ -1,52 +1,370 @@
+const EventEmitter = require('events');
+const { Readable } = require('stream');
 const PULSEAUDIO_BINDING = require('./build/Release/pulseaudio-capture.node');
 
-class PulseAudioCapture {
+// Process-wide device notifications. The native registry is only asked to
+// report changes while someone listens for 'devicechange'.
+const deviceEvents = new EventEmitter();
+deviceEvents.on('newListener', (event) => {
+    if (event === 'devicechange' && deviceEvents.listenerCount('devicechange') === 0) {
+        PULSEAUDIO_BINDING.PulseAudioCapture.watchDevices((change) => deviceEvents.emit('devicechange', change));
+    }
+});
+deviceEvents.on('removeListener', (event) => {
+    if (event === 'devicechange' && deviceEvents.listenerCount('devicechange') === 0) {
+        PULSEAUDIO_BINDING.PulseAudioCapture.watchDevices(null);
+    }
+});
+
+/**
+ * Events:
+ * - 'speechStart' / 'speechEnd' ({ sampleOffset, time, timestamp }) - voice activity transitions
+ *   when started with `vad`; sampleOffset counts stream frames like block info.frame (gaps
+ *   included) and timestamp is on the info.timestamp clock
+ * - 'features' ({ frames, frameIndex, time, melBands, mfccCount, logMel, mfcc }) - STFT
+ *   frames completed by one fragment when started with `features`; logMel and mfcc are
+ *   Float32Arrays laid out frame-major (frames x melBands, frames x mfccCount)
+ * - 'envelope' ({ rms, peak, time, low?, mid?, high? }) - one per tick when started with
+ *   `envelope`; low/mid/high are band RMS values (open vowels / front vowels / fricatives)
+ * - 'gap' ({ frame, frames, timestamp }) - audio lost to holes or server overruns
+ * - 'ended' ({ frame }) - a finite fake backend source has delivered everything
+ */
+class PulseAudioCapture extends EventEmitter {
     constructor() {
+        super();
         this._native = new PULSEAUDIO_BINDING.PulseAudioCapture();
         this._isCapturing = false;
+        this._isPaused = false;
+        this._corkQueue = Promise.resolve();
+        this._readWaiter = null;
+    }
+
+    _onNativeEvent(type, payload) {
+        if (type === 'readable') {
+            this._wakeReader();
+            return;
+        }
+        this.emit(type, payload);
     }
 
-    async start(deviceId = null, callback = null) {
+    _wakeReader() {
+        const waiter = this._readWaiter;
+        this._readWaiter = null;
+        if (waiter) waiter();
+    }
+
+    /**
+     * @param {string|null} deviceId - PulseAudio source name, or null for the default source
+     * @param {Function|null} callback - (samples, info) for each captured block of interleaved
+     *        samples. info = { sequence, frame, timestamp, gap, dropped }: the block's dispatch
+     *        number, the stream position of its first frame (gaps and VAD-gated frames included),
+     *        that frame's capture time in ms on the process.hrtime() clock (CLOCK_MONOTONIC),
+     *        frames lost to holes or server overruns since the previous block, and blocks the
+     *        full queue dropped just before it. Lost audio is also reported as a 'gap' event.
+     * @param {Object} [options]
+     * @param {number} [options.rate=48000] - requested sample rate
+     * @param {number} [options.channels=2] - requested channel count
+     * @param {'f32le'|'s16le'|'s32le'} [options.format='f32le'] - requested sample format;
+     *        blocks are delivered as Float32Array, Int16Array or Int32Array accordingly
+     * @param {Object} [options.convert] - native conversion to float32 before delivery, e.g.
+     *        { rate: 16000, channels: 1 } to downmix and resample a 48 kHz stereo stream;
+     *        `quality` (default 16) trades resampler filter length against CPU
+     * @param {'typedarray'|'array'} [options.delivery='typedarray'] - typed array backed by
+     *        the native buffer, or a plain Array (legacy, one property set per sample)
+     * @param {number} [options.bufferFrames] - capacity of the native buffer, defaults to 1 s.
+     *        Without a callback this is the pull ring read by read(); with a callback it bounds
+     *        the number of blocks queued for the JS thread.
+     * @param {'drop-oldest'|'drop-newest'} [options.overflow='drop-oldest'] - what the pull ring
+     *        discards when it is full
+     * @param {number} [options.fragmentMs=20] - fragment size requested from the PulseAudio server
+     * @param {boolean} [options.adjustLatency=true] - connect with PA_STREAM_ADJUST_LATENCY so the
+     *        server sizes the source latency to fragmentMs; the fragment actually granted is
+     *        getFormat().grantedFragmentMs
+     * @param {number} [options.blockFrames] - coalesce fragments into callback blocks of this many
+     *        frames; by default every server fragment is delivered on its own
+     * @param {number} [options.blockMs] - same as blockFrames, in milliseconds
+     * @param {boolean|Object} [options.vad=false] - gate delivery on voice activity: only speech
+     *        (plus its backdated onset) reaches the callback / pull ring, and 'speechStart' /
+     *        'speechEnd' are emitted. An object overrides thresholdDb, minEnergyDb, maxFlatness,
+     *        maxZeroCrossingRate, frameMs, attackMs and hangoverMs.
+     * @param {string|Object} [options.sharedMemory] - also write delivered frames into a POSIX
+     *        shared-memory ring for same-machine readers (see SharedCaptureRing in the backend):
+     *        a name, or { name, bufferFrames } (defaults to bufferFrames). Unlinked on stop().
+     * @param {boolean|Object} [options.envelope=false] - emit 'envelope' events at a display
+     *        rate instead of (or alongside) samples, e.g. for Live2D lip sync.
+     *        { rate: 60, bands: false }; `bands` adds viseme-band energies.
+     * @param {boolean|Object} [options.features=false] - emit 'features' events with log-mel and
+     *        MFCC frames computed natively from the delivered stream. Defaults (fftSize 512,
+     *        hopLength 256, melBands 20, mfccCount 13) match AudioSpectralEncoder when the
+     *        delivered rate is 16 kHz; an object overrides any of them.
+     * @param {string|Object} [options.encode] - deliver Opus packets (Buffer) instead of PCM,
+     *        encoded on a native worker thread: 'opus', or { codec: 'opus', bitrate, frameMs,
+     *        complexity, application: 'voip'|'audio'|'lowdelay' }. info gains `frames` per packet.
+     *        Needs a callback, a rate Opus supports and 1-2 channels; requires libopus at build time.
+     * @param {number} [options.history] - keep the last this many seconds (up to 600) of the
+     *        delivered-format stream, ungated, in a preallocated native buffer for snapshot()
+     * @param {string|Object} [options.backend='pulse'] - where fragments come from: 'pulse', or
+     *        'fake' / { type: 'fake', source: 'sine'|'noise'|'silence'|'file', path, frequency,
+     *        amplitude, realtime, loop, duration, gap: { at, seconds } } to drive the whole
+     *        delivery path without a sound server. A fake source produces exactly the requested
+     *        format at fragmentMs, paced at the stream rate or, with realtime: false, as fast as
+     *        it is consumed; WAV files are converted to the requested rate and channels up front.
+     *        A `duration` (seconds) or the end of a non-looping file emits 'ended'; a `gap` loses
+     *        audio after `at` seconds, like a server overrun. deviceId is ignored.
+     * @param {string|Object} [options.archive] - keep a longer look-back in a memory-mapped file
+     *        for readRange(): a path (300 seconds), or { path, seconds | minutes } up to 6 hours.
+     *        The file is reused across restarts of the process within one boot.
+     * @returns {Promise<Object>} resolves with the negotiated format (see getFormat()) once
+     *          the stream is connected; connecting never blocks the JS thread
+     */
+    async start(deviceId = null, callback = null, options = {}) {
         if (this._isCapturing) {
             throw new Error('Already capturing');
         }
 
-        return new Promise((resolve, reject) => {
-            try {
-                const wrappedCallback = callback ? (data) => {
-                    if (callback) callback(data);
-                } : null;
-
-                const result = this._native.start(deviceId || '', wrappedCallback);
-                
-                if (result) {
-                    this._isCapturing = true;
-                    resolve(true);
-                } else {
-                    reject(new Error('Failed to start capture'));
-                }
-            } catch (error) {
-                reject(error);
-            }
+        const wrappedCallback = callback ? (data, info) => {
+            if (callback) callback(data, info);
+        } : null;
+        const nativeOptions = Object.assign({}, options, {
+            onEvent: (type, payload) => this._onNativeEvent(type, payload)
         });
+
+        // The native start() validates options synchronously, then connects
+        // on a worker thread; stop() may be called while that is pending.
+        this._isCapturing = true;
+        try {
+            return await this._native.start(deviceId || '', wrappedCallback, nativeOptions);
+        } catch (error) {
+            this._isCapturing = false;
+            this._wakeReader();
+            throw error;
+        }
     }
 
+    /**
+     * Stop capturing. Called while start(), pause() or resume() is pending, it resolves once
+     * that step has torn the capture down, so start() may follow it directly.
+     */
     async stop() {
         if (!this._isCapturing) {
             return true;
         }
 
-        return new Promise((resolve, reject) => {
-            try {
-                const result = this._native.stop();
-                this._isCapturing = false;
-                resolve(result);
-            } catch (error) {
-                reject(error);
+        const result = await this._native.stop();
+        this._isCapturing = false;
+        this._isPaused = false;
+        this._wakeReader();
+        return result;
+    }
+
+    /**
+     * Stop delivering audio but keep the stream and the server connection (pa_stream_cork),
+     * e.g. between push-to-talk presses. Resolves once the server has acknowledged; a partial
+     * delivery block is handed out first so no block spans the pause.
+     */
+    pause() {
+        return this._cork(true);
+    }
+
+    /**
+     * Undo pause(). Audio recorded server-side before the pause is discarded, so the first
+     * block after resolving is fresh. Costs one server round trip instead of a start().
+     */
+    resume() {
+        return this._cork(false);
+    }
+
+    _cork(paused) {
+        const run = () => {
+            if (!this._isCapturing) {
+                throw new Error('Not capturing');
+            }
+            return this._native[paused ? 'pause' : 'resume']().then(() => {
+                this._isPaused = this._isCapturing && paused;
+            });
+        };
+        // Calls are applied in order; the native side allows one at a time.
+        const result = this._corkQueue.then(run, run);
+        this._corkQueue = result.catch(() => {});
+        return result;
+    }
+
+    /**
+     * Pull up to `frames` frames (all buffered frames if omitted) of interleaved samples,
+     * as a typed array matching getFormat().sampleFormat.
+     * Only available when capture was started without a callback.
+     */
+    read(frames) {
+        return this._native.read(frames);
+    }
+
+    /**
+     * Copy the newest `seconds` of the history buffer (all of it if omitted) in one step, e.g.
+     * to recover the audio just before a wake word. Requires start() with `history`; still
+     * works after stop() until the next start(). Gaps in the stream are held as silence.
+     * @param {number} [seconds]
+     * @returns {{samples: Float32Array|Int16Array|Int32Array, frame: number, timestamp: number}}
+     *          interleaved samples, the stream position of the first frame and its capture time
+     *          in ms on the process.hrtime() clock
+     */
+    snapshot(seconds) {
+        return this._native.snapshot(seconds);
+    }
+
+    /**
+     * Audio captured between two times on the process.hrtime() clock, in ms, e.g.
+     * `Number(process.hrtime.bigint()) / 1e6` or a block's `info.timestamp`. Requires start()
+     * with `archive`; still works after stop(). The chunks are views straight into the archive
+     * mapping, valid until the writer comes within a margin (min(1 s, half the archive)) of
+     * their first frame: for a range at the oldest readable frame that is only about a second.
+     * Copy them (slice()) and then call valid(); if it returns false the copy may be torn.
+     * @param {number} startTime
+     * @param {number} endTime
+     * @returns {{chunks: Array<Float32Array|Int16Array|Int32Array>, frame: number,
+     *          timestamp: number, frames: number, valid: function(): boolean}|null} one chunk,
+     *          or two where the range wraps round the archive; the archive frame index and
+     *          capture time of the first frame; whether the chunks still hold that audio;
+     *          null if the archive holds none of the range
+     */
+    readRange(startTime, endTime) {
+        return this._native.readRange(startTime, endTime);
+    }
+
+    /**
+     * Stream the capture to disk natively; JS never sees the samples. The file receives the
+     * delivered format (after convert, before the VAD gate), with gaps written as silence.
+     * A writer thread drains a lock-free buffer in large aligned writes.
+     * @param {string} path
+     * @param {Object} [options]
+     * @param {'wav'|'raw'} [options.format='wav']
+     * @param {number} [options.bufferMs=2000] - how far the writer may fall behind before
+     *        frames are dropped
+     * @param {boolean} [options.ioUring=false] - submit writes through io_uring when built with
+     *        liburing and permitted by the kernel; falls back to pwrite() otherwise
+     */
+    startRecording(path, options = {}) {
+        this._native.startRecording(path, options);
+    }
+
+    /**
+     * Finalise the recording (header, close) off the JS thread. stop() finalises it as well.
+     * @returns {Promise<{path: string, frames: number, bytes: number, framesDropped: number,
+     *          ioUring: boolean}>}
+     */
+    stopRecording() {
+        return this._native.stopRecording();
+    }
+
+    available() {
+        return this._native.available();
+    }
+
+    /**
+     * Resolve with exactly `frames` frames once the native buffer holds them. After stop() it
+     * resolves with whatever is left (possibly fewer frames), then with null once drained.
+     * Pull mode only; one read may be pending at a time.
+     * @param {number} frames - at most getFormat().bufferFrames, or the read could never complete
+     * @returns {Promise<Float32Array|Int16Array|Int32Array|null>}
+     * @throws {RangeError} if `frames` exceeds the native buffer
+     */
+    async readFrames(frames) {
+        if (this._readWaiter) {
+            throw new Error('readFrames() is already pending');
+        }
+        const { bufferFrames } = this.getFormat();
+        if (bufferFrames > 0 && frames > bufferFrames) {
+            throw new RangeError(`readFrames(${frames}) exceeds bufferFrames (${bufferFrames})`);
+        }
+        for (;;) {
+            if (this._native.available() >= frames) {
+                return this._native.read(frames);
+            }
+            if (!this._isCapturing) {
+                const rest = this._native.read(frames);
+                return rest.length > 0 ? rest : null;
+            }
+            await new Promise((resolve) => {
+                this._readWaiter = resolve;
+                if (this._native.notifyWhenAvailable(frames)) {
+                    this._wakeReader();
+                }
+            });
+        }
+    }
+
+    /**
+     * Async iterator over blocks of `frames` frames (default 100 ms) until capture stops:
+     * `for await (const block of capture.frames(1600)) { ... }`. Pull mode only.
+     */
+    async *frames(frames) {
+        const size = frames || Math.max(1, Math.round(this.getFormat().sampleRate / 10));
+        for (;;) {
+            const block = await this.readFrames(size);
+            if (!block) return;
+            yield block;
+        }
+    }
+
+    [Symbol.asyncIterator]() {
+        return this.frames();
+    }
+
+    /**
+     * Start capture in pull mode and expose it as an object-mode Readable of typed-array
+     * blocks. `highWaterMark` (frames, default 1 s) sizes the native buffer, which is the
+     * only place audio queues: a slow consumer overflows it according to `overflow`
+     * ('drop-oldest' by default) and getStats().samplesDropped, instead of growing memory.
+     * Destroying the stream stops capture.
+     * @param {string|null} deviceId
+     * @param {Object} [options] - start() options plus `frames` per chunk (default 100 ms)
+     *        and `highWaterMark` in frames; `frames` may not exceed `highWaterMark`
+     * @returns {Readable}
+     */
+    createReadStream(deviceId = null, options = {}) {
+        const { frames, highWaterMark, ...startOptions } = options;
+        if (highWaterMark) {
+            startOptions.bufferFrames = highWaterMark;
+        }
+        const capture = this;
+        let size = frames;
+
+        return new Readable({
+            objectMode: true,
+            highWaterMark: 1,
+            construct: (callback) => {
+                this.start(deviceId, null, startOptions).then(() => {
+                    const { sampleRate, bufferFrames } = this.getFormat();
+                    size = size || Math.max(1, Math.round(sampleRate / 10));
+                    if (size > bufferFrames) {
+                        callback(new RangeError(`frames (${size}) exceeds highWaterMark (${bufferFrames})`));
+                        return;
+                    }
+                    callback();
+                }, callback);
+            },
+            read() {
+                capture.readFrames(size).then((block) => this.push(block), (error) => this.destroy(error));
+            },
+            destroy: (error, callback) => {
+                this.stop().then(() => callback(error), callback);
             }
         });
     }
 
+    /**
+     * Native capture counters: fragments/bytes read, delivered and dropped blocks,
+     * TSFN queue depth and high-water mark, overflow/underflow/hole events, and
+     * histograms of read-callback duration and peek-to-JS delivery latency.
+     */
+    getStats() {
+        return this._native.getStats();
+    }
+
+    /**
+     * The delivered format: sampleRate, channels, sampleFormat ('float32' | 'int16' | 'int32'),
+     * bytesPerSample and the delivery settings in effect. `stream` holds the format negotiated
+     * with the server and `conversion` describes the native conversion stage, if any.
+     */
     getFormat() {
         return this._native.getFormat();
     }
@@ -55,6 +373,24 @@ class PulseAudioCapture {
         return this._isCapturing;
     }
 
+    get isPaused() {
+        return this._isPaused;
+    }
+
+    /**
+     * Run the native feature extractor over a whole mono Float32Array.
+     * @param {Float32Array} samples
+     * @param {Object} [options] - sampleRate (default 16000), fftSize, hopLength, melBands, mfccCount
+     * @returns {{frames: number, melBands: number, mfccCount: number, logMel: Float32Array, mfcc: Float32Array}}
+     */
+    static extractFeatures(samples, options = {}) {
+        return PULSEAUDIO_BINDING.PulseAudioCapture.extractFeatures(samples, options);
+    }
+
+    /**
+     * Capturable devices (sink monitors) from the native registry cache. Only the first call
+     * after loading waits (up to 2 s) for the registry to connect; prefer listDevices().
+     */
     static getDevices() {
         return PULSEAUDIO_BINDING.PulseAudioCapture.getDevices();
     }
@@ -62,6 +398,93 @@ class PulseAudioCapture {
     static getDefaultDevice() {
         return PULSEAUDIO_BINDING.PulseAudioCapture.getDefaultDevice();
     }
+
+    /**
+     * Non-blocking device enumeration.
+     * @returns {Promise<{devices: Array<{id: string, name: string, description: string}>, defaultDevice: Object|null}>}
+     */
+    static listDevices() {
+        return PULSEAUDIO_BINDING.PulseAudioCapture.listDevices();
+    }
+
+    /**
+     * Emits 'devicechange' ({ devices, defaultDevice }) whenever sinks, sources or the default
+     * sink change, driven by a PulseAudio subscription instead of polling:
+     * `PulseAudioCapture.deviceEvents.on('devicechange', ({ devices }) => ...)`.
+     * Listening does not keep the process alive.
+     */
+    static get deviceEvents() {
+        return deviceEvents;
+    }
+}
+
+/**
+ * Records several sources together, e.g. the microphone and the desktop monitor, aligned on
+ * one timeline: block N covers the same instant in every source. Alignment uses the
+ * streams' timing info; clock drift between devices is corrected by dropping or padding
+ * single frames, and a source that stops delivering is padded with silence.
+ */
+class CaptureSession {
+    constructor() {
+        this._native = new PULSEAUDIO_BINDING.CaptureSession();
+        this._isCapturing = false;
+    }
+
+    /**
+     * @param {Array<string|{device: string, channels?: number}>} sources - source names (a sink's
+     *        monitor is '<sink>.monitor'); '' is the default source. channels defaults to 1.
+     * @param {Function} callback - ({ frame, time, timestamp, sources }) per block, timestamp
+     *        being the capture time of `frame` in ms on the process.hrtime() clock; sources[i] is an
+     *        interleaved Float32Array, or an array of per-channel Float32Arrays when planar
+     * @param {Object} [options]
+     * @param {number} [options.rate=48000] - common rate; the server converts each source
+     * @param {number} [options.blockMs=10] - block length (or blockFrames)
+     * @param {string} [options.layout='interleaved'] - 'interleaved' | 'planar'
+     * @param {number} [options.maxSkewMs=200] - how far a stalled source may fall behind
+     *        before it is padded with silence
+     * @param {number} [options.fragmentMs=10] - requested fragment size per stream
+     * @param {boolean|Object} [options.echoCancel] - remove the echo of `reference` (default
+     *        source 1, e.g. the monitor of the sink the assistant speaks through) from `mic`
+     *        (default source 0) before delivery; { mic, reference, tailMs: 250, delayMs: 0,
+     *        stepSize: 0.5 }. getStats().echoCancel reports ERLE per mic channel.
+     * @returns {Promise<Object>} resolves with the format once every stream is connected
+     */
+    async start(sources, callback, options = {}) {
+        if (this._isCapturing) {
+            throw new Error('Already capturing');
+        }
+        this._isCapturing = true;
+        try {
+            return await this._native.start(sources, callback, options);
+        } catch (error) {
+            this._isCapturing = false;
+            throw error;
+        }
+    }
+
+    async stop() {
+        const result = this._native.stop();
+        this._isCapturing = false;
+        return result;
+    }
+
+    getFormat() {
+        return this._native.getFormat();
+    }
+
+    /**
+     * blocksDelivered/blocksDropped plus, per source, framesRead, holes and the aligner's
+     * framesPadded, framesDropped, corrections and residual offsetMs.
+     */
+    getStats() {
+        return this._native.getStats();
+    }
+
+    get isCapturing() {
+        return this._isCapturing;
+    }
 }
 
+PulseAudioCapture.CaptureSession = CaptureSession;
+
 module.exports = PulseAudioCapture;
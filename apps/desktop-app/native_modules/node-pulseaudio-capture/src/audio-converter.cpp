@@ -0,0 +1,79 @@
+#include "audio-converter.h"
+
+#include <cstring>
+
+AudioConverter::AudioConverter(SampleType inputType, uint32_t inputRate, uint32_t inputChannels,
+                               uint32_t outputRate, uint32_t outputChannels,
+                               uint32_t zeroCrossings, SimdKernels kernels)
+    : inputType(inputType), inputChannels(inputChannels), outputRate(outputRate),
+      outputChannels(outputChannels), kernels(kernels) {
+    if (inputRate != outputRate) {
+        resampler.reset(new PolyphaseResampler(inputRate, outputRate, outputChannels, zeroCrossings, kernels));
+    }
+}
+
+bool AudioConverter::SupportsChannels(uint32_t inputChannels, uint32_t outputChannels) {
+    return outputChannels == inputChannels || outputChannels == 1;
+}
+
+void AudioConverter::Reset() {
+    if (resampler) {
+        resampler->Reset();
+    }
+}
+
+const float* AudioConverter::Process(const void* input, size_t frames, size_t* outputFrames) {
+    size_t samples = frames * inputChannels;
+    const float* current;
+
+    if (inputType == SampleType::Float32) {
+        current = static_cast<const float*>(input);
+    } else {
+        if (floatBuffer.size() < samples) {
+            floatBuffer.resize(samples);
+        }
+        if (inputType == SampleType::Int16) {
+            const int16_t* src = static_cast<const int16_t*>(input);
+            for (size_t i = 0; i < samples; i++) {
+                floatBuffer[i] = src[i] * (1.0f / 32768.0f);
+            }
+        } else {
+            const int32_t* src = static_cast<const int32_t*>(input);
+            for (size_t i = 0; i < samples; i++) {
+                floatBuffer[i] = static_cast<float>(src[i]) * (1.0f / 2147483648.0f);
+            }
+        }
+        current = floatBuffer.data();
+    }
+
+    if (outputChannels == 1 && inputChannels > 1) {
+        if (mixBuffer.size() < frames) {
+            mixBuffer.resize(frames);
+        }
+        if (inputChannels == 2) {
+            kernels.downmixStereo(current, mixBuffer.data(), frames);
+        } else {
+            float scale = 1.0f / static_cast<float>(inputChannels);
+            for (size_t i = 0; i < frames; i++) {
+                float sum = 0.0f;
+                for (uint32_t c = 0; c < inputChannels; c++) {
+                    sum += current[i * inputChannels + c];
+                }
+                mixBuffer[i] = sum * scale;
+            }
+        }
+        current = mixBuffer.data();
+    }
+
+    if (!resampler) {
+        *outputFrames = frames;
+        return current;
+    }
+
+    size_t maxFrames = resampler->MaxOutputFrames(frames);
+    if (outputBuffer.size() < maxFrames * outputChannels) {
+        outputBuffer.resize(maxFrames * outputChannels);
+    }
+    *outputFrames = resampler->Process(current, frames, outputBuffer.data());
+    return outputBuffer.data();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "polyphase-resampler.h"
+#include "sample-type.h"
+#include "simd-kernels.h"
+
+// Capture-side conversion stage: integer to float32, downmix to mono, and
+// polyphase resampling, in that order so the resampler sees as few channels
+// as possible. Output is always interleaved float32. Scratch buffers only
+// grow, so steady-state processing does not allocate.
+class AudioConverter {
+public:
+    AudioConverter(SampleType inputType, uint32_t inputRate, uint32_t inputChannels,
+                   uint32_t outputRate, uint32_t outputChannels,
+                   uint32_t zeroCrossings = 16, SimdKernels kernels = GetSimdKernels());
+
+    // Output channels must equal the input channels or be 1 (downmix).
+    static bool SupportsChannels(uint32_t inputChannels, uint32_t outputChannels);
+
+    // Converts `frames` interleaved input frames. The returned pointer stays
+    // valid until the next call; *outputFrames receives the frame count.
+    const float* Process(const void* input, size_t frames, size_t* outputFrames);
+
+    void Reset();
+
+    uint32_t OutputRate() const {
+        return outputRate;
+    }
+
+    uint32_t OutputChannels() const {
+        return outputChannels;
+    }
+
+    bool Resampling() const {
+        return resampler != nullptr;
+    }
+
+    SimdLevel Level() const {
+        return kernels.level;
+    }
+
+private:
+    SampleType inputType;
+    uint32_t inputChannels;
+    uint32_t outputRate;
+    uint32_t outputChannels;
+    SimdKernels kernels;
+    std::unique_ptr<PolyphaseResampler> resampler;
+
+    std::vector<float> floatBuffer;
+    std::vector<float> mixBuffer;
+    std::vector<float> outputBuffer;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// One fragment as the backend produced it, in the negotiated stream format.
+struct CaptureFragment {
+    // Interleaved samples, or null for `length` bytes the source lost.
+    const void* data;
+    size_t length;
+    // CLOCK_MONOTONIC capture time of the first frame. When `timed` is
+    // false the source could not tell, and this is a best guess.
+    int64_t captureNanos;
+    bool timed;
+};
+
+// All callbacks run on the backend's delivery thread with its lock held.
+// Any of them may be empty.
+struct CaptureBackendCallbacks {
+    std::function<void(const CaptureFragment&)> fragment;
+    std::function<void()> overflow;
+    std::function<void()> underflow;
+    // A finite source has delivered everything it had.
+    std::function<void()> ended;
+};
+
+// Where PulseAudioCapture gets its fragments from. The capture owns one
+// backend per start(): Open() runs on a worker thread, the callbacks on
+// the backend's own delivery thread, and Close() on the JS thread. Holding
+// the Lock keeps the delivery thread out, which is how the capture swaps
+// state (recorder, pending block) the callbacks touch.
+class CaptureBackend {
+public:
+    class Lock {
+    public:
+        explicit Lock(CaptureBackend& backend) : backend(backend) {
+            backend.LockDelivery();
+        }
+        ~Lock() {
+            backend.UnlockDelivery();
+        }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+
+    private:
+        CaptureBackend& backend;
+    };
+
+    virtual ~CaptureBackend() {}
+
+    // Starts delivering from `device` (empty for the default). `spec` holds
+    // the requested format on entry and the one delivered on return.
+    virtual bool Open(const std::string& device, pa_sample_spec* spec, const pa_channel_map& channelMap,
+        pa_usec_t fragmentUsec, CaptureBackendCallbacks callbacks, std::string* error) = 0;
+
+    // Called with the Lock held. Data from before a resume is discarded.
+    virtual bool SetPaused(bool paused, std::string* error) = 0;
+
+    // Once this returns no callback runs again. Must not hold the Lock.
+    virtual void Close() = 0;
+
+    virtual const char* Name() const = 0;
+
+    // The fragment size the source settled on, which a server may round or
+    // ignore; valid after Open().
+    virtual pa_usec_t FragmentUsec() const = 0;
+
+    virtual void LockDelivery() = 0;
+    virtual void UnlockDelivery() = 0;
+};
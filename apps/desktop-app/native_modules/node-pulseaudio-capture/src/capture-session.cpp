@@ -0,0 +1,642 @@
+#include "capture-session.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "capture-stats.h"
+
+static const uint32_t kSessionDefaultRate = 48000;
+static const double kSessionDefaultBlockMs = 10.0;
+static const double kSessionDefaultMaxSkewMs = 200.0;
+static const pa_usec_t kSessionFragmentUsec = 10000;
+static const size_t kSessionMaxSources = 8;
+
+// A block on its way to JS; planar blocks are already deinterleaved.
+struct SessionBlock {
+    uint64_t frame;
+    // CLOCK_MONOTONIC capture time of the block's first frame.
+    int64_t captureNanos;
+    std::vector<std::vector<float>> sources;
+};
+
+Napi::Object CaptureSession::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "CaptureSession", {
+        InstanceMethod("start", &CaptureSession::Start),
+        InstanceMethod("stop", &CaptureSession::Stop),
+        InstanceMethod("getFormat", &CaptureSession::GetFormat),
+        InstanceMethod("getStats", &CaptureSession::GetStats)
+    });
+
+    exports.Set("CaptureSession", func);
+    return exports;
+}
+
+CaptureSession::CaptureSession(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<CaptureSession>(info), sampleRate(kSessionDefaultRate), blockFrames(0), maxSkewFrames(0),
+      fragmentUsec(kSessionFragmentUsec), planar(false), echoEnabled(false), echoMic(0), echoReference(1),
+      isCapturing(false), isStarting(false),
+      stopRequested(false), blocksDelivered(0), blocksDropped(0) {
+}
+
+CaptureSession::~CaptureSession() {
+    Cleanup();
+}
+
+void CaptureSession::Cleanup() {
+    if (connection) {
+        PulseConnection::Lock lock(*connection);
+        for (const std::unique_ptr<Source>& source : sources) {
+            if (!source->stream) {
+                continue;
+            }
+            pa_stream_set_state_callback(source->stream, NULL, NULL);
+            pa_stream_set_read_callback(source->stream, NULL, NULL);
+            pa_stream_disconnect(source->stream);
+            pa_stream_unref(source->stream);
+            source->stream = nullptr;
+        }
+    }
+    connection.reset();
+
+    // No read callback can run any more. The aligner is kept for getStats().
+    if (tsfn) {
+        tsfn.Release();
+        tsfn = Napi::ThreadSafeFunction();
+    }
+}
+
+// sources: Array<string | { device, channels }>; an empty device name
+// records the server's default source.
+bool CaptureSession::ParseSources(Napi::Env env, Napi::Value value) {
+    if (!value.IsArray() || value.As<Napi::Array>().Length() == 0) {
+        Napi::TypeError::New(env, "sources must be a non-empty array").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Array list = value.As<Napi::Array>();
+    if (list.Length() > kSessionMaxSources) {
+        Napi::RangeError::New(env, "At most 8 sources are supported").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    sources.clear();
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        std::unique_ptr<Source> source(new Source());
+        source->session = this;
+        source->index = i;
+        source->channels = 1;
+        source->stream = nullptr;
+        source->bytesRead = 0;
+        source->holes = 0;
+
+        Napi::Value entry = list.Get(i);
+        if (entry.IsString()) {
+            source->device = entry.As<Napi::String>().Utf8Value();
+        } else if (entry.IsObject()) {
+            Napi::Object object = entry.As<Napi::Object>();
+            if (object.Has("device") && object.Get("device").IsString()) {
+                source->device = object.Get("device").As<Napi::String>().Utf8Value();
+            }
+            if (object.Has("channels") && object.Get("channels").IsNumber()) {
+                int64_t channels = object.Get("channels").As<Napi::Number>().Int64Value();
+                if (channels < 1 || channels > PA_CHANNELS_MAX) {
+                    Napi::RangeError::New(env, "channels must be between 1 and 32").ThrowAsJavaScriptException();
+                    return false;
+                }
+                source->channels = static_cast<uint32_t>(channels);
+            }
+        } else {
+            Napi::TypeError::New(env, "Each source must be a device name or { device, channels }")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        sources.push_back(std::move(source));
+    }
+    return true;
+}
+
+bool CaptureSession::ParseOptions(Napi::Env env, Napi::Object options) {
+    sampleRate = kSessionDefaultRate;
+    if (options.Has("rate") && options.Get("rate").IsNumber()) {
+        int64_t rate = options.Get("rate").As<Napi::Number>().Int64Value();
+        if (rate < 1000 || rate > 384000) {
+            Napi::RangeError::New(env, "rate must be between 1000 and 384000").ThrowAsJavaScriptException();
+            return false;
+        }
+        sampleRate = static_cast<uint32_t>(rate);
+    }
+
+    double blockMs = kSessionDefaultBlockMs;
+    if (options.Has("blockMs") && options.Get("blockMs").IsNumber()) {
+        blockMs = options.Get("blockMs").As<Napi::Number>().DoubleValue();
+        if (!(blockMs > 0)) {
+            Napi::RangeError::New(env, "blockMs must be positive").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    blockFrames = std::max<uint32_t>(1, static_cast<uint32_t>(sampleRate * blockMs / 1000.0));
+    if (options.Has("blockFrames") && options.Get("blockFrames").IsNumber()) {
+        int64_t frames = options.Get("blockFrames").As<Napi::Number>().Int64Value();
+        if (frames <= 0) {
+            Napi::RangeError::New(env, "blockFrames must be positive").ThrowAsJavaScriptException();
+            return false;
+        }
+        blockFrames = static_cast<uint32_t>(frames);
+    }
+
+    fragmentUsec = kSessionFragmentUsec;
+    if (options.Has("fragmentMs") && options.Get("fragmentMs").IsNumber()) {
+        double ms = options.Get("fragmentMs").As<Napi::Number>().DoubleValue();
+        if (!(ms > 0)) {
+            Napi::RangeError::New(env, "fragmentMs must be positive").ThrowAsJavaScriptException();
+            return false;
+        }
+        fragmentUsec = static_cast<pa_usec_t>(ms * 1000);
+    }
+
+    double maxSkewMs = kSessionDefaultMaxSkewMs;
+    if (options.Has("maxSkewMs") && options.Get("maxSkewMs").IsNumber()) {
+        maxSkewMs = options.Get("maxSkewMs").As<Napi::Number>().DoubleValue();
+        if (!(maxSkewMs > 0)) {
+            Napi::RangeError::New(env, "maxSkewMs must be positive").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    // The skew bound must exceed a block, or no source could ever fill one.
+    maxSkewFrames = std::max<uint32_t>(2 * blockFrames, static_cast<uint32_t>(sampleRate * maxSkewMs / 1000.0));
+
+    planar = false;
+    if (options.Has("layout") && options.Get("layout").IsString()) {
+        std::string layout = options.Get("layout").As<Napi::String>().Utf8Value();
+        if (layout == "planar") {
+            planar = true;
+        } else if (layout != "interleaved") {
+            Napi::TypeError::New(env, "layout must be 'interleaved' or 'planar'").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    echoEnabled = false;
+    if (options.Has("echoCancel")) {
+        return ParseEchoCancel(env, options.Get("echoCancel"));
+    }
+    return true;
+}
+
+// echoCancel: true | { mic: 0, reference: 1, tailMs: 250, delayMs: 0, stepSize: 0.5 }
+bool CaptureSession::ParseEchoCancel(Napi::Env env, Napi::Value value) {
+    if (value.IsBoolean() && !value.As<Napi::Boolean>().Value()) {
+        return true;
+    }
+    if (!value.IsBoolean() && !value.IsObject()) {
+        Napi::TypeError::New(env, "echoCancel must be a boolean or an object").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    echoMic = 0;
+    echoReference = 1;
+    echoConfig = EchoCancellerConfig();
+    if (value.IsObject()) {
+        Napi::Object options = value.As<Napi::Object>();
+        if (options.Has("mic") && options.Get("mic").IsNumber()) {
+            echoMic = static_cast<size_t>(options.Get("mic").As<Napi::Number>().Uint32Value());
+        }
+        if (options.Has("reference") && options.Get("reference").IsNumber()) {
+            echoReference = static_cast<size_t>(options.Get("reference").As<Napi::Number>().Uint32Value());
+        }
+        if (options.Has("tailMs") && options.Get("tailMs").IsNumber()) {
+            echoConfig.tailMs = options.Get("tailMs").As<Napi::Number>().DoubleValue();
+        }
+        if (options.Has("delayMs") && options.Get("delayMs").IsNumber()) {
+            echoConfig.delayMs = options.Get("delayMs").As<Napi::Number>().DoubleValue();
+        }
+        if (options.Has("stepSize") && options.Get("stepSize").IsNumber()) {
+            echoConfig.stepSize = options.Get("stepSize").As<Napi::Number>().FloatValue();
+        }
+    }
+
+    if (echoMic >= sources.size() || echoReference >= sources.size() || echoMic == echoReference) {
+        Napi::RangeError::New(env, "echoCancel.mic and echoCancel.reference must be two different source indices")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    if (!(echoConfig.tailMs > 0) || echoConfig.tailMs > 1000 || !(echoConfig.delayMs >= 0)
+        || echoConfig.delayMs > 1000) {
+        Napi::RangeError::New(env, "echoCancel.tailMs must be in (0, 1000] and delayMs in [0, 1000]")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    if (!(echoConfig.stepSize > 0) || echoConfig.stepSize > 1) {
+        Napi::RangeError::New(env, "echoCancel.stepSize must be in (0, 1]").ThrowAsJavaScriptException();
+        return false;
+    }
+    echoEnabled = true;
+    return true;
+}
+
+// Connects all streams off the JS thread, like PulseAudioCapture::start().
+class CaptureSession::StartWorker : public Napi::AsyncWorker {
+public:
+    StartWorker(Napi::Env env, CaptureSession* session)
+        : Napi::AsyncWorker(env, "PulseAudioCaptureSessionStart"), session(session),
+          deferred(Napi::Promise::Deferred::New(env)) {
+    }
+
+    Napi::Promise Promise() const {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override {
+        std::string error;
+        if (!session->Connect(&error)) {
+            SetError(error);
+        }
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        session->isStarting = false;
+        session->Unref();
+
+        if (session->stopRequested) {
+            session->stopRequested = false;
+            session->Cleanup();
+            deferred.Reject(Napi::Error::New(env, "Capture stopped while starting").Value());
+            return;
+        }
+
+        session->isCapturing = true;
+        deferred.Resolve(session->FormatObject(env));
+    }
+
+    void OnError(const Napi::Error& error) override {
+        session->isStarting = false;
+        session->stopRequested = false;
+        session->Unref();
+        session->Cleanup();
+        deferred.Reject(error.Value());
+    }
+
+private:
+    CaptureSession* session;
+    Napi::Promise::Deferred deferred;
+};
+
+// start(sources, callback, options?) -> Promise<format>. The callback gets
+// { frame, time, sources } per block, where sources[i] is a Float32Array
+// (interleaved) or an array of per-channel Float32Arrays (planar).
+Napi::Value CaptureSession::Start(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (isCapturing || isStarting) {
+        Napi::Error::New(env, "Already capturing").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 1 || !ParseSources(env, info[0])) {
+        if (!env.IsExceptionPending()) {
+            Napi::TypeError::New(env, "sources must be a non-empty array").ThrowAsJavaScriptException();
+        }
+        return env.Null();
+    }
+    if (info.Length() < 2 || !info[1].IsFunction()) {
+        Napi::TypeError::New(env, "callback must be a function").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info.Length() >= 3 && info[2].IsObject() ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+    if (!ParseOptions(env, options)) {
+        return env.Null();
+    }
+
+    std::vector<uint32_t> channels;
+    for (const std::unique_ptr<Source>& source : sources) {
+        source->spec.format = PA_SAMPLE_FLOAT32LE;
+        source->spec.rate = sampleRate;
+        source->spec.channels = static_cast<uint8_t>(source->channels);
+        channels.push_back(source->channels);
+    }
+    aligner.reset(new StreamAligner(sampleRate, channels, blockFrames, maxSkewFrames));
+    echoCancellers.clear();
+    if (echoEnabled) {
+        echoConfig.sampleRate = sampleRate;
+        echoConfig.blockFrames = blockFrames;
+        for (uint32_t c = 0; c < sources[echoMic]->channels; c++) {
+            echoCancellers.emplace_back(new EchoCanceller(echoConfig));
+        }
+        echoReferenceMono.assign(blockFrames, 0.0f);
+        echoChannel.assign(blockFrames, 0.0f);
+    }
+    blocksDelivered = 0;
+    blocksDropped = 0;
+
+    // About a second of blocks may queue up before new ones are dropped.
+    size_t maxQueuedBlocks = std::max<size_t>(4, sampleRate / blockFrames);
+    tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "PulseAudioCaptureSession",
+        maxQueuedBlocks, 1);
+
+    isStarting = true;
+    stopRequested = false;
+    Ref();
+    StartWorker* worker = new StartWorker(env, this);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// Streams are connected one after another but all wait for READY together,
+// so the slowest device, not the sum, bounds start-up.
+bool CaptureSession::Connect(std::string* error) {
+    connection = PulseConnection::Acquire(error);
+    if (!connection) {
+        return false;
+    }
+
+    PulseConnection::Lock lock(*connection);
+    if (!connection->WaitReady(error)) {
+        return false;
+    }
+
+    for (const std::unique_ptr<Source>& source : sources) {
+        pa_channel_map channelMap;
+        pa_channel_map_init_auto(&channelMap, source->channels, PA_CHANNEL_MAP_DEFAULT);
+
+        source->stream = pa_stream_new(connection->Context(), "Angela Capture Session", &source->spec, &channelMap);
+        if (!source->stream) {
+            *error = connection->Error("Failed to create stream");
+            return false;
+        }
+        pa_stream_set_state_callback(source->stream, StreamStateCallback, source.get());
+        pa_stream_set_read_callback(source->stream, StreamReadCallback, source.get());
+
+        pa_buffer_attr bufferAttr;
+        bufferAttr.maxlength = (uint32_t)-1;
+        bufferAttr.tlength = (uint32_t)-1;
+        bufferAttr.prebuf = (uint32_t)-1;
+        bufferAttr.minreq = (uint32_t)-1;
+        bufferAttr.fragsize = pa_usec_to_bytes(fragmentUsec, &source->spec);
+
+        // Timing updates keep pa_stream_get_time() current for alignment.
+        pa_stream_flags_t flags = static_cast<pa_stream_flags_t>(
+            PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE);
+        const char* device = source->device.empty() ? NULL : source->device.c_str();
+        if (pa_stream_connect_record(source->stream, device, &bufferAttr, flags) < 0) {
+            *error = connection->Error("Failed to connect stream");
+            return false;
+        }
+    }
+
+    for (const std::unique_ptr<Source>& source : sources) {
+        while (true) {
+            pa_stream_state_t state = pa_stream_get_state(source->stream);
+            if (state == PA_STREAM_READY) {
+                break;
+            }
+            if (!PA_STREAM_IS_GOOD(state)) {
+                *error = connection->Error(("Stream connection failed for " +
+                    (source->device.empty() ? std::string("default source") : source->device)).c_str());
+                return false;
+            }
+            pa_threaded_mainloop_wait(connection->Mainloop());
+        }
+    }
+    return true;
+}
+
+void CaptureSession::StreamStateCallback(pa_stream* p, void* userdata) {
+    Source* source = static_cast<Source*>(userdata);
+    pa_threaded_mainloop_signal(source->session->connection->Mainloop(), 0);
+}
+
+// Runs on the mainloop thread. The first frame of a fragment sits at the
+// stream's read index; pa_stream_get_time() says how far the stream has
+// recorded past that, so the fragment started that long before now.
+void CaptureSession::StreamReadCallback(pa_stream* p, size_t nbytes, void* userdata) {
+    Source* source = static_cast<Source*>(userdata);
+    CaptureSession* session = source->session;
+
+    const void* data;
+    size_t length;
+    if (pa_stream_peek(p, &data, &length) < 0 || length == 0) {
+        return;
+    }
+
+    int64_t now = CaptureStats::MonotonicNanos();
+    pa_usec_t readUsec = pa_bytes_to_usec(source->bytesRead, &source->spec);
+    pa_usec_t streamUsec;
+    int64_t captureNanos;
+    if (pa_stream_get_time(p, &streamUsec) == 0) {
+        captureNanos = now - (static_cast<int64_t>(streamUsec) - static_cast<int64_t>(readUsec)) * 1000;
+    } else {
+        // No timing info yet: assume the fragment has just been completed.
+        captureNanos = now - static_cast<int64_t>(pa_bytes_to_usec(length, &source->spec)) * 1000;
+    }
+
+    if (!data) {
+        source->holes.fetch_add(1, std::memory_order_relaxed);
+    }
+    size_t frameBytes = source->channels * sizeof(float);
+    session->aligner->Push(source->index, static_cast<const float*>(data), length / frameBytes, captureNanos);
+    source->bytesRead += length;
+    pa_stream_drop(p);
+
+    AlignedBlock block;
+    while (session->aligner->Pop(&block)) {
+        session->Dispatch(&block);
+    }
+}
+
+// Runs on the mainloop thread on each aligned block before delivery, so the
+// microphone source is replaced by the residual with the echo removed.
+void CaptureSession::CancelEcho(AlignedBlock* block) {
+    const std::vector<float>& reference = block->sources[echoReference];
+    uint32_t referenceChannels = sources[echoReference]->channels;
+    for (size_t f = 0; f < blockFrames; f++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < referenceChannels; c++) {
+            sum += reference[f * referenceChannels + c];
+        }
+        echoReferenceMono[f] = sum / referenceChannels;
+    }
+
+    std::vector<float>& mic = block->sources[echoMic];
+    uint32_t micChannels = sources[echoMic]->channels;
+    for (uint32_t c = 0; c < micChannels; c++) {
+        for (size_t f = 0; f < blockFrames; f++) {
+            echoChannel[f] = mic[f * micChannels + c];
+        }
+        echoCancellers[c]->Process(echoChannel.data(), echoReferenceMono.data());
+        for (size_t f = 0; f < blockFrames; f++) {
+            mic[f * micChannels + c] = echoChannel[f];
+        }
+    }
+}
+
+void CaptureSession::Dispatch(AlignedBlock* block) {
+    if (!echoCancellers.empty()) {
+        CancelEcho(block);
+    }
+
+    SessionBlock* out = new SessionBlock();
+    out->frame = block->frame;
+    out->captureNanos = aligner->OriginNanos() + static_cast<int64_t>(block->frame) * 1000000000 / sampleRate;
+    out->sources.resize(block->sources.size());
+    for (size_t i = 0; i < block->sources.size(); i++) {
+        uint32_t channels = sources[i]->channels;
+        if (!planar || channels == 1) {
+            out->sources[i].swap(block->sources[i]);
+            continue;
+        }
+        const std::vector<float>& interleaved = block->sources[i];
+        std::vector<float>& deinterleaved = out->sources[i];
+        deinterleaved.resize(interleaved.size());
+        size_t frames = interleaved.size() / channels;
+        for (size_t f = 0; f < frames; f++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                deinterleaved[c * frames + f] = interleaved[f * channels + c];
+            }
+        }
+    }
+
+    std::vector<uint32_t> channels;
+    for (const std::unique_ptr<Source>& source : sources) {
+        channels.push_back(source->channels);
+    }
+    bool planarLayout = planar;
+    uint32_t rate = sampleRate;
+    std::atomic<uint64_t>* delivered = &blocksDelivered;
+    auto callback = [channels, planarLayout, rate, delivered](Napi::Env env, Napi::Function jsCallback,
+        SessionBlock* block) {
+        std::unique_ptr<SessionBlock> owned(block);
+        if (env == nullptr || jsCallback.IsEmpty()) {
+            return;
+        }
+
+        Napi::Array list = Napi::Array::New(env, owned->sources.size());
+        for (size_t i = 0; i < owned->sources.size(); i++) {
+            const std::vector<float>& samples = owned->sources[i];
+            Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, samples.size() * sizeof(float));
+            if (!samples.empty()) {
+                std::memcpy(buffer.Data(), samples.data(), samples.size() * sizeof(float));
+            }
+            if (planarLayout) {
+                size_t frames = samples.size() / channels[i];
+                Napi::Array planes = Napi::Array::New(env, channels[i]);
+                for (uint32_t c = 0; c < channels[i]; c++) {
+                    planes.Set(c, Napi::Float32Array::New(env, frames, buffer, c * frames * sizeof(float)));
+                }
+                list.Set(static_cast<uint32_t>(i), planes);
+            } else {
+                list.Set(static_cast<uint32_t>(i), Napi::Float32Array::New(env, samples.size(), buffer, 0));
+            }
+        }
+
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("frame", static_cast<double>(owned->frame));
+        result.Set("time", static_cast<double>(owned->frame) / rate);
+        result.Set("timestamp", static_cast<double>(owned->captureNanos) / 1e6);
+        result.Set("sources", list);
+        delivered->fetch_add(1, std::memory_order_relaxed);
+        jsCallback.Call({result});
+    };
+
+    if (tsfn.NonBlockingCall(out, callback) != napi_ok) {
+        blocksDropped.fetch_add(1, std::memory_order_relaxed);
+        delete out;
+    }
+}
+
+Napi::Value CaptureSession::Stop(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (isStarting) {
+        stopRequested = true;
+        return Napi::Boolean::New(env, true);
+    }
+    if (!isCapturing) {
+        return Napi::Boolean::New(env, true);
+    }
+
+    Cleanup();
+    isCapturing = false;
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value CaptureSession::GetFormat(const Napi::CallbackInfo& info) {
+    return FormatObject(info.Env());
+}
+
+Napi::Object CaptureSession::FormatObject(Napi::Env env) {
+    Napi::Object format = Napi::Object::New(env);
+    format.Set("sampleRate", sampleRate);
+    format.Set("sampleFormat", "float32");
+    format.Set("blockFrames", blockFrames);
+    format.Set("layout", planar ? "planar" : "interleaved");
+    format.Set("maxSkewMs", static_cast<double>(maxSkewFrames) * 1000.0 / sampleRate);
+    if (echoEnabled) {
+        Napi::Object echo = Napi::Object::New(env);
+        echo.Set("mic", static_cast<double>(echoMic));
+        echo.Set("reference", static_cast<double>(echoReference));
+        echo.Set("tailMs", echoConfig.tailMs);
+        echo.Set("delayMs", echoConfig.delayMs);
+        echo.Set("stepSize", echoConfig.stepSize);
+        format.Set("echoCancel", echo);
+    } else {
+        format.Set("echoCancel", env.Null());
+    }
+
+    Napi::Array list = Napi::Array::New(env, sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("device", sources[i]->device);
+        entry.Set("channels", sources[i]->channels);
+        list.Set(static_cast<uint32_t>(i), entry);
+    }
+    format.Set("sources", list);
+    return format;
+}
+
+// Per-source alignment counters. offsetMs is the residual misalignment the
+// drift filter currently sees; padded/dropped frames are the corrections.
+Napi::Value CaptureSession::GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("blocksDelivered", static_cast<double>(blocksDelivered.load(std::memory_order_relaxed)));
+    stats.Set("blocksDropped", static_cast<double>(blocksDropped.load(std::memory_order_relaxed)));
+
+    Napi::Array list = Napi::Array::New(env, sources.size());
+    // Counters are written by read callbacks; while starting, the worker
+    // thread still owns the connection.
+    std::unique_ptr<PulseConnection::Lock> lock;
+    if (isCapturing && connection) {
+        lock.reset(new PulseConnection::Lock(*connection));
+    }
+    for (size_t i = 0; i < sources.size(); i++) {
+        const Source& source = *sources[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("device", source.device);
+        entry.Set("holes", static_cast<double>(source.holes.load(std::memory_order_relaxed)));
+        if (aligner && !isStarting) {
+            entry.Set("framesRead", static_cast<double>(source.bytesRead / (source.channels * sizeof(float))));
+            const AlignerSourceStats& aligned = aligner->Stats(i);
+            entry.Set("framesPadded", static_cast<double>(aligned.framesPadded));
+            entry.Set("framesDropped", static_cast<double>(aligned.framesDropped));
+            entry.Set("corrections", static_cast<double>(aligned.corrections));
+            entry.Set("offsetMs", aligned.offsetFrames * 1000.0 / sampleRate);
+        }
+        list.Set(static_cast<uint32_t>(i), entry);
+    }
+    stats.Set("sources", list);
+
+    if (!echoCancellers.empty() && !isStarting) {
+        Napi::Array channelsErle = Napi::Array::New(env, echoCancellers.size());
+        bool converged = true;
+        for (size_t c = 0; c < echoCancellers.size(); c++) {
+            channelsErle.Set(static_cast<uint32_t>(c), echoCancellers[c]->Erle());
+            converged = converged && echoCancellers[c]->Converged();
+        }
+        Napi::Object echo = Napi::Object::New(env);
+        echo.Set("erle", channelsErle);
+        echo.Set("converged", converged);
+        stats.Set("echoCancel", echo);
+    }
+    return stats;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <napi.h>
+#include <pulse/pulseaudio.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "echo-canceller.h"
+#include "pulse-connection.h"
+#include "stream-aligner.h"
+
+// Records several sources at once, e.g. the microphone and the desktop
+// monitor, on the shared PulseAudio connection and delivers them as blocks
+// on one timeline (see StreamAligner), so a frame index means the same
+// instant in every source. Exposed to JS as CaptureSession.
+class CaptureSession : public Napi::ObjectWrap<CaptureSession> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    CaptureSession(const Napi::CallbackInfo& info);
+    ~CaptureSession();
+
+private:
+    struct Source {
+        CaptureSession* session;
+        size_t index;
+        std::string device;
+        uint32_t channels;
+        pa_sample_spec spec;
+        pa_stream* stream;
+        // Bytes consumed so far, i.e. the stream's read index.
+        uint64_t bytesRead;
+        std::atomic<uint64_t> holes;
+    };
+
+    class StartWorker;
+
+    Napi::Value Start(const Napi::CallbackInfo& info);
+    Napi::Value Stop(const Napi::CallbackInfo& info);
+    Napi::Value GetFormat(const Napi::CallbackInfo& info);
+    Napi::Value GetStats(const Napi::CallbackInfo& info);
+
+    bool ParseSources(Napi::Env env, Napi::Value value);
+    bool ParseOptions(Napi::Env env, Napi::Object options);
+    Napi::Object FormatObject(Napi::Env env);
+    bool ParseEchoCancel(Napi::Env env, Napi::Value value);
+    bool Connect(std::string* error);
+    void Cleanup();
+    void CancelEcho(AlignedBlock* block);
+    void Dispatch(AlignedBlock* block);
+
+    static void StreamReadCallback(pa_stream* stream, size_t nbytes, void* userdata);
+    static void StreamStateCallback(pa_stream* stream, void* userdata);
+
+    std::shared_ptr<PulseConnection> connection;
+    std::vector<std::unique_ptr<Source>> sources;
+    std::unique_ptr<StreamAligner> aligner;
+    uint32_t sampleRate;
+    uint32_t blockFrames;
+    uint32_t maxSkewFrames;
+    pa_usec_t fragmentUsec;
+    bool planar;
+    // Echo cancellation of source `echoMic` (one canceller per channel)
+    // against the downmixed source `echoReference`, e.g. the monitor of the
+    // sink the assistant speaks through.
+    bool echoEnabled;
+    size_t echoMic;
+    size_t echoReference;
+    EchoCancellerConfig echoConfig;
+    std::vector<std::unique_ptr<EchoCanceller>> echoCancellers;
+    std::vector<float> echoReferenceMono;
+    std::vector<float> echoChannel;
+    bool isCapturing;
+    bool isStarting;
+    bool stopRequested;
+    std::atomic<uint64_t> blocksDelivered;
+    std::atomic<uint64_t> blocksDropped;
+    Napi::ThreadSafeFunction tsfn;
+};
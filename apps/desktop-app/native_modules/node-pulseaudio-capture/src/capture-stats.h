@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Log2-bucketed histogram of microsecond durations. Bucket i counts values
+// in [2^(i-1), 2^i) us, bucket 0 counts values below 1 us and the last
+// bucket is open-ended. Recording is a single relaxed fetch_add.
+class DurationHistogram {
+public:
+    static constexpr size_t kBuckets = 24;
+
+    void Record(uint64_t micros) {
+        size_t bucket = 0;
+        while (bucket + 1 < kBuckets && micros >= (uint64_t(1) << bucket)) {
+            bucket++;
+        }
+        counts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t previous = max.load(std::memory_order_relaxed);
+        while (micros > previous && !max.compare_exchange_weak(previous, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count(size_t bucket) const {
+        return counts[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Exclusive upper bound of a bucket in microseconds.
+    static uint64_t UpperBound(size_t bucket) {
+        return uint64_t(1) << bucket;
+    }
+
+    uint64_t Max() const {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Total() const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            total += Count(i);
+        }
+        return total;
+    }
+
+    // Upper bound of the bucket containing the given quantile (0..1).
+    uint64_t Quantile(double q) const {
+        uint64_t total = Total();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(q * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += Count(i);
+            if (seen > target) {
+                return UpperBound(i);
+            }
+        }
+        return UpperBound(kBuckets - 1);
+    }
+
+private:
+    std::atomic<uint64_t> counts[kBuckets] = {};
+    std::atomic<uint64_t> max{0};
+};
+
+// Counters shared between the mainloop thread (writer) and the JS thread
+// (writer for queue depth, reader for everything). Every field is a relaxed
+// atomic so the hot path never takes a lock. A fresh instance is created per
+// start() and shared with queued TSFN calls, which may outlive the capture.
+struct CaptureStats {
+    std::atomic<uint64_t> fragmentsRead{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> blocksDelivered{0};
+    std::atomic<uint64_t> blocksDropped{0};
+    std::atomic<int64_t> queueDepth{0};
+    std::atomic<int64_t> queueHighWater{0};
+    std::atomic<uint64_t> overflows{0};
+    std::atomic<uint64_t> underflows{0};
+    std::atomic<uint64_t> holes{0};
+    // Converted bytes held back by the voice activity gate.
+    std::atomic<uint64_t> bytesGated{0};
+    // Discontinuities in the delivered stream (holes and server-side
+    // overruns) and the delivered-rate frames they cost.
+    std::atomic<uint64_t> gaps{0};
+    std::atomic<uint64_t> framesLost{0};
+    DurationHistogram callbackDuration;
+    DurationHistogram deliveryLatency;
+
+    void QueuePush() {
+        int64_t depth = queueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+        int64_t high = queueHighWater.load(std::memory_order_relaxed);
+        while (depth > high && !queueHighWater.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    void QueuePop() {
+        queueDepth.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static uint64_t NowNanos() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // CLOCK_MONOTONIC, the clock behind process.hrtime.bigint(), so capture
+    // timestamps can be compared with JS-side times directly. steady_clock
+    // makes no promise about which clock it reads.
+    static int64_t MonotonicNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+};
@@ -0,0 +1,217 @@
+#include "device-registry.h"
+
+DeviceRegistry::DeviceRegistry()
+    : refreshing(false), refreshAgain(false), pendingQueries(0), hasSnapshot(false), failed(false) {
+}
+
+DeviceRegistry::~DeviceRegistry() {
+    Stop();
+}
+
+void DeviceRegistry::Start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (connection && !failed) {
+            return;
+        }
+    }
+    Stop();
+
+    std::string error;
+    std::shared_ptr<PulseConnection> acquired = PulseConnection::Acquire(&error);
+    if (!acquired) {
+        Fail();
+        return;
+    }
+
+    PulseConnection::Lock loopLock(*acquired);
+    connection = acquired;
+    refreshing = false;
+    refreshAgain = false;
+    pendingQueries = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = false;
+    }
+
+    connection->AddStateListener(this, [this](pa_context_state_t state) { ContextStateChanged(state); });
+    // The shared context may already be up if a capture is running.
+    ContextStateChanged(pa_context_get_state(connection->Context()));
+}
+
+void DeviceRegistry::Stop() {
+    if (!connection) {
+        return;
+    }
+
+    {
+        PulseConnection::Lock loopLock(*connection);
+        connection->RemoveStateListener(this);
+        pa_context* context = connection->Context();
+        if (PA_CONTEXT_IS_GOOD(pa_context_get_state(context))) {
+            pa_operation* op = pa_context_subscribe(context, PA_SUBSCRIPTION_MASK_NULL, NULL, NULL);
+            if (op) {
+                pa_operation_unref(op);
+            }
+        }
+        pa_context_set_subscribe_callback(context, NULL, NULL);
+        // The context outlives the registry's use of it, so queries still
+        // in flight must not call back into it.
+        for (pa_operation* op : operations) {
+            pa_operation_cancel(op);
+            pa_operation_unref(op);
+        }
+        operations.clear();
+    }
+    connection.reset();
+}
+
+bool DeviceRegistry::Snapshot(DeviceSnapshot* out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasSnapshot) {
+        return false;
+    }
+    *out = snapshot;
+    return true;
+}
+
+bool DeviceRegistry::WaitForSnapshot(DeviceSnapshot* out, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait_for(lock, timeout, [this] { return hasSnapshot || failed; });
+    if (!hasSnapshot) {
+        return false;
+    }
+    *out = snapshot;
+    return true;
+}
+
+void DeviceRegistry::SetListener(Listener newListener) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    listener = std::move(newListener);
+}
+
+void DeviceRegistry::ContextStateChanged(pa_context_state_t state) {
+    if (state == PA_CONTEXT_READY) {
+        pa_context* context = connection->Context();
+        pa_context_set_subscribe_callback(context, SubscribeCallback, this);
+        pa_subscription_mask_t mask = static_cast<pa_subscription_mask_t>(
+            PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SERVER);
+        pa_operation* op = pa_context_subscribe(context, mask, NULL, NULL);
+        if (op) {
+            pa_operation_unref(op);
+        }
+        Refresh();
+    } else if (!PA_CONTEXT_IS_GOOD(state)) {
+        Fail();
+    }
+}
+
+// The list described the server that went away; after a reconnect
+// callers wait for the new server's first query instead. The generation
+// keeps counting so listeners still see the next list as a change.
+void DeviceRegistry::Fail() {
+    std::lock_guard<std::mutex> lock(mutex);
+    failed = true;
+    hasSnapshot = false;
+    snapshot.devices.clear();
+    snapshot.defaultDevice.clear();
+    ready.notify_all();
+}
+
+void DeviceRegistry::SubscribeCallback(pa_context* c, pa_subscription_event_type_t type, uint32_t index, void* userdata) {
+    static_cast<DeviceRegistry*>(userdata)->Refresh();
+}
+
+// Events arrive in bursts (a new sink brings its monitor source with it), so
+// at most one query runs at a time and events during it schedule one more.
+void DeviceRegistry::Refresh() {
+    if (refreshing) {
+        refreshAgain = true;
+        return;
+    }
+    refreshing = true;
+    refreshAgain = false;
+    stagingDevices.clear();
+    stagingDefault.clear();
+    pendingQueries = 2;
+
+    pa_context* context = connection->Context();
+    pa_operation* op = pa_context_get_sink_info_list(context, SinkInfoCallback, this);
+    if (op) {
+        operations.push_back(op);
+    } else {
+        pendingQueries--;
+    }
+
+    op = pa_context_get_server_info(context, ServerInfoCallback, this);
+    if (op) {
+        operations.push_back(op);
+    } else {
+        pendingQueries--;
+    }
+
+    if (pendingQueries == 0) {
+        refreshing = false;
+    }
+}
+
+void DeviceRegistry::SinkInfoCallback(pa_context* c, const pa_sink_info* info, int eol, void* userdata) {
+    DeviceRegistry* registry = static_cast<DeviceRegistry*>(userdata);
+    if (eol != 0) {
+        registry->QueryDone();
+        return;
+    }
+
+    if (info && info->monitor_source_name) {
+        registry->stagingDevices.push_back({
+            info->monitor_source_name,
+            info->name ? info->name : "Unknown",
+            info->description ? info->description : "Unknown"
+        });
+    }
+}
+
+void DeviceRegistry::ServerInfoCallback(pa_context* c, const pa_server_info* info, void* userdata) {
+    DeviceRegistry* registry = static_cast<DeviceRegistry*>(userdata);
+    if (info && info->default_sink_name) {
+        registry->stagingDefault = info->default_sink_name;
+    }
+    registry->QueryDone();
+}
+
+void DeviceRegistry::QueryDone() {
+    if (--pendingQueries > 0) {
+        return;
+    }
+    for (pa_operation* op : operations) {
+        pa_operation_unref(op);
+    }
+    operations.clear();
+
+    DeviceSnapshot published;
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed = !hasSnapshot || stagingDevices != snapshot.devices || stagingDefault != snapshot.defaultDevice;
+        if (changed) {
+            snapshot.devices.swap(stagingDevices);
+            snapshot.defaultDevice.swap(stagingDefault);
+            snapshot.generation++;
+            hasSnapshot = true;
+            ready.notify_all();
+            published = snapshot;
+        }
+    }
+
+    if (changed) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        if (listener) {
+            listener(published);
+        }
+    }
+
+    refreshing = false;
+    if (refreshAgain) {
+        Refresh();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pulse-connection.h"
+
+// A capturable device: the monitor source of a sink.
+struct DeviceInfo {
+    std::string id;
+    std::string name;
+    std::string description;
+
+    bool operator==(const DeviceInfo& other) const {
+        return id == other.id && name == other.name && description == other.description;
+    }
+};
+
+struct DeviceSnapshot {
+    std::vector<DeviceInfo> devices;
+    // Name of the server's default sink; empty if unknown.
+    std::string defaultDevice;
+    // Incremented every time the published list or default changes.
+    uint64_t generation = 0;
+};
+
+// Long-lived device list kept current through pa_context_subscribe on the
+// shared PulseConnection; it is the only user of the context's subscribe
+// callback. Start() only kicks off the connection and never waits for the
+// server. Sink, source and server events trigger a re-query of the sink
+// list and server info, and a changed result is published as a new snapshot
+// and handed to the listener on the mainloop thread. If the server goes
+// away the next Start() call reconnects.
+class DeviceRegistry {
+public:
+    using Listener = std::function<void(const DeviceSnapshot&)>;
+
+    DeviceRegistry();
+    ~DeviceRegistry();
+
+    void Start();
+
+    // Copies the latest snapshot; false until the first query on the
+    // current connection completed.
+    bool Snapshot(DeviceSnapshot* snapshot);
+
+    // Like Snapshot(), but waits up to `timeout` for the first query.
+    bool WaitForSnapshot(DeviceSnapshot* snapshot, std::chrono::milliseconds timeout);
+
+    // Runs on the mainloop thread after each published change. Once
+    // SetListener() returns, the previous listener is no longer running.
+    void SetListener(Listener listener);
+
+private:
+    static void SubscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* userdata);
+    static void SinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata);
+    static void ServerInfoCallback(pa_context* context, const pa_server_info* info, void* userdata);
+
+    void Stop();
+    void ContextStateChanged(pa_context_state_t state);
+    void Fail();
+    void Refresh();
+    void QueryDone();
+
+    std::shared_ptr<PulseConnection> connection;
+
+    // Mainloop-thread state for the query in flight.
+    std::vector<pa_operation*> operations;
+    bool refreshing;
+    bool refreshAgain;
+    int pendingQueries;
+    std::vector<DeviceInfo> stagingDevices;
+    std::string stagingDefault;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool hasSnapshot;
+    bool failed;
+    DeviceSnapshot snapshot;
+
+    std::mutex listenerMutex;
+    Listener listener;
+};
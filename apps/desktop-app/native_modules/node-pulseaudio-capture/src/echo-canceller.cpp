@@ -0,0 +1,151 @@
+#include "echo-canceller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Smoothing of the per-bin reference power and of the block energies.
+static const float kPowerSmoothing = 0.9f;
+static const double kEnergySmoothing = 0.95;
+// Reference blocks below this mean square (about -80 dBFS) do not adapt.
+static const double kSilentReference = 1e-8;
+// Minimum ERLE before the double-talk step control takes over.
+static const double kConvergedErle = 2.0;
+
+EchoCanceller::EchoCanceller(const EchoCancellerConfig& config)
+    : config(config), block(std::max<size_t>(1, config.blockFrames)), fftSize(Fft::NextPowerOfTwo(2 * block)),
+      bins(fftSize / 2 + 1),
+      partitions(std::max<size_t>(1, static_cast<size_t>(std::ceil(config.tailMs * config.sampleRate / 1000.0 / block)))),
+      delayFrames(static_cast<size_t>(std::max(0.0, config.delayMs) * config.sampleRate / 1000.0)), fft(fftSize),
+      frame(fftSize), delayLine(delayFrames), delayPosition(0), spectra(partitions * bins), weights(partitions * bins),
+      newest(0), constrainNext(0), referencePower(bins), scratch(fftSize), error(bins), micEnergy(0.0),
+      residualEnergy(0.0), echoEnergy(0.0), converged(false) {
+}
+
+void EchoCanceller::Reset() {
+    std::fill(frame.begin(), frame.end(), 0.0f);
+    std::fill(delayLine.begin(), delayLine.end(), 0.0f);
+    std::fill(spectra.begin(), spectra.end(), std::complex<float>());
+    std::fill(weights.begin(), weights.end(), std::complex<float>());
+    std::fill(referencePower.begin(), referencePower.end(), 0.0f);
+    delayPosition = 0;
+    newest = 0;
+    constrainNext = 0;
+    micEnergy = residualEnergy = echoEnergy = 0.0;
+    converged = false;
+}
+
+double EchoCanceller::Erle() const {
+    if (residualEnergy <= 0.0 || micEnergy <= 0.0) {
+        return 0.0;
+    }
+    return 10.0 * std::log10(micEnergy / residualEnergy);
+}
+
+void EchoCanceller::Process(float* mic, const float* reference) {
+    // Slide the reference frame, passing new samples through the delay line.
+    std::move(frame.begin() + block, frame.end(), frame.begin());
+    float* incoming = frame.data() + fftSize - block;
+    double referenceEnergy = 0.0;
+    for (size_t i = 0; i < block; i++) {
+        float sample = reference[i];
+        if (delayFrames > 0) {
+            std::swap(sample, delayLine[delayPosition]);
+            delayPosition = (delayPosition + 1) % delayFrames;
+        }
+        incoming[i] = sample;
+        referenceEnergy += static_cast<double>(sample) * sample;
+    }
+    referenceEnergy /= block;
+
+    // Newest reference spectrum replaces the oldest partition.
+    newest = (newest + partitions - 1) % partitions;
+    for (size_t i = 0; i < fftSize; i++) {
+        scratch[i] = std::complex<float>(frame[i], 0.0f);
+    }
+    fft.Forward(scratch.data());
+    std::complex<float>* current = &spectra[newest * bins];
+    for (size_t k = 0; k < bins; k++) {
+        current[k] = scratch[k];
+        referencePower[k] = kPowerSmoothing * referencePower[k] + (1.0f - kPowerSmoothing) * std::norm(scratch[k]);
+    }
+
+    // Echo estimate: sum over partitions of X_p * W_p, back to time domain.
+    std::fill(scratch.begin(), scratch.end(), std::complex<float>());
+    for (size_t p = 0; p < partitions; p++) {
+        const std::complex<float>* x = &spectra[((newest + p) % partitions) * bins];
+        const std::complex<float>* w = &weights[p * bins];
+        for (size_t k = 0; k < bins; k++) {
+            scratch[k] += x[k] * w[k];
+        }
+    }
+    for (size_t k = 1; k < fftSize / 2; k++) {
+        scratch[fftSize - k] = std::conj(scratch[k]);
+    }
+    fft.Inverse(scratch.data());
+
+    const float scale = 1.0f / static_cast<float>(fftSize);
+    double blockMic = 0.0;
+    double blockResidual = 0.0;
+    double blockEcho = 0.0;
+    std::fill(scratch.begin(), scratch.begin() + (fftSize - block), std::complex<float>());
+    for (size_t i = 0; i < block; i++) {
+        float echo = scratch[fftSize - block + i].real() * scale;
+        float residual = mic[i] - echo;
+        blockMic += static_cast<double>(mic[i]) * mic[i];
+        blockEcho += static_cast<double>(echo) * echo;
+        blockResidual += static_cast<double>(residual) * residual;
+        mic[i] = residual;
+        scratch[fftSize - block + i] = std::complex<float>(residual, 0.0f);
+    }
+
+    bool active = referenceEnergy > kSilentReference;
+    if (!active) {
+        return;
+    }
+    micEnergy = kEnergySmoothing * micEnergy + (1.0 - kEnergySmoothing) * blockMic;
+    residualEnergy = kEnergySmoothing * residualEnergy + (1.0 - kEnergySmoothing) * blockResidual;
+    echoEnergy = kEnergySmoothing * echoEnergy + (1.0 - kEnergySmoothing) * blockEcho;
+    if (!converged && micEnergy > kConvergedErle * residualEnergy) {
+        converged = true;
+    }
+
+    // A residual louder than the predicted echo means near-end speech;
+    // adapt proportionally slower. A residual louder than the microphone
+    // itself means the echo path changed, which needs the full step.
+    float step = config.stepSize;
+    if (converged && blockResidual > blockEcho && blockResidual < blockMic) {
+        step *= static_cast<float>(blockEcho / blockResidual);
+    }
+
+    fft.Forward(scratch.data());
+    for (size_t k = 0; k < bins; k++) {
+        error[k] = scratch[k] * (step / (static_cast<float>(partitions) * referencePower[k] + 1e-6f * fftSize));
+    }
+
+    for (size_t p = 0; p < partitions; p++) {
+        const std::complex<float>* x = &spectra[((newest + p) % partitions) * bins];
+        std::complex<float>* w = &weights[p * bins];
+        for (size_t k = 0; k < bins; k++) {
+            w[k] += std::conj(x[k]) * error[k];
+        }
+    }
+
+    // Gradient constraint for one partition: its impulse response may only
+    // span `block` taps, or the circular wrap-around leaks into the output.
+    std::complex<float>* w = &weights[constrainNext * bins];
+    for (size_t k = 0; k < bins; k++) {
+        scratch[k] = w[k];
+    }
+    for (size_t k = 1; k < fftSize / 2; k++) {
+        scratch[fftSize - k] = std::conj(scratch[k]);
+    }
+    fft.Inverse(scratch.data());
+    for (size_t i = 0; i < fftSize; i++) {
+        scratch[i] = i < block ? std::complex<float>(scratch[i].real() * scale, 0.0f) : std::complex<float>();
+    }
+    fft.Forward(scratch.data());
+    for (size_t k = 0; k < bins; k++) {
+        w[k] = scratch[k];
+    }
+    constrainNext = (constrainNext + 1) % partitions;
+}
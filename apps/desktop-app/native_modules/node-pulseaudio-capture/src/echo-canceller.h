@@ -0,0 +1,79 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft.h"
+
+struct EchoCancellerConfig {
+    uint32_t sampleRate = 48000;
+    // Samples per Process() call; also the filter's partition length.
+    size_t blockFrames = 480;
+    // Echo path length the filter covers, after `delayMs`.
+    double tailMs = 250.0;
+    // Bulk delay applied to the reference first, for playback paths whose
+    // latency exceeds what the tail should spend taps on.
+    double delayMs = 0.0;
+    float stepSize = 0.5f;
+};
+
+// Acoustic echo canceller: a partitioned-block frequency-domain adaptive
+// filter (overlap-save, one partition per block, so no added latency)
+// that predicts the echo of a reference signal in the microphone signal
+// and subtracts it.
+//
+// The step is normalised per bin by the smoothed reference power. Once the
+// filter has converged it is scaled down when the residual grows larger
+// than the predicted echo, which is what near-end speech over the echo
+// (double talk) looks like, so the filter does not adapt to the talker.
+// Adaptation also pauses while the reference is silent. The gradient
+// constraint is applied to one partition per block in rotation.
+class EchoCanceller {
+public:
+    explicit EchoCanceller(const EchoCancellerConfig& config);
+
+    // Replaces `blockFrames` mono microphone samples with the echo-free
+    // residual, given the reference samples played at the same time.
+    void Process(float* mic, const float* reference);
+
+    void Reset();
+
+    const EchoCancellerConfig& Config() const { return config; }
+
+    // Echo return loss enhancement over recent far-end activity, in dB.
+    double Erle() const;
+    bool Converged() const { return converged; }
+
+private:
+    EchoCancellerConfig config;
+    size_t block;
+    size_t fftSize;
+    size_t bins;
+    size_t partitions;
+    size_t delayFrames;
+    Fft fft;
+
+    // Reference history: the last fftSize samples seen by the filter, and
+    // the delay line in front of it.
+    std::vector<float> frame;
+    std::vector<float> delayLine;
+    size_t delayPosition;
+
+    // spectra[p] is the reference spectrum from p blocks ago; newest at
+    // `newest`, stored as a ring of partitions.
+    std::vector<std::complex<float>> spectra;
+    std::vector<std::complex<float>> weights;
+    size_t newest;
+    size_t constrainNext;
+
+    std::vector<float> referencePower;
+    std::vector<std::complex<float>> scratch;
+    std::vector<std::complex<float>> error;
+
+    double micEnergy;
+    double residualEnergy;
+    double echoEnergy;
+    bool converged;
+};
@@ -0,0 +1,92 @@
+#include "envelope-follower.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Band edges in Hz; each band is a constant-peak-gain band-pass centred on
+// the geometric mean of its edges.
+static const double kBandEdges[kEnvelopeBands][2] = {
+    { 300.0, 1000.0 },
+    { 1000.0, 2500.0 },
+    { 2500.0, 6000.0 },
+};
+
+EnvelopeFollower::EnvelopeFollower(uint32_t rate, uint32_t channels, SampleType type, double tickRate, bool bands)
+    : rate(rate), channels(channels), type(type), tickRate(tickRate), bandsEnabled(bands),
+      framesPerTick(std::max(1.0, static_cast<double>(rate) / tickRate)), tickBoundary(0.0),
+      position(0), tickFrames(0), tickSamples(0), sumSquares(0.0), peak(0.0f) {
+    tickBoundary = framesPerTick;
+
+    const double pi = 3.14159265358979323846;
+    for (size_t b = 0; b < kEnvelopeBands; b++) {
+        double low = kBandEdges[b][0];
+        double high = kBandEdges[b][1];
+        double center = std::min(std::sqrt(low * high), 0.45 * rate);
+        double q = center / (high - low);
+        double w0 = 2.0 * pi * center / rate;
+        double alpha = std::sin(w0) / (2.0 * q);
+        double a0 = 1.0 + alpha;
+
+        Biquad& filter = filters[b];
+        filter.b0 = static_cast<float>(alpha / a0);
+        filter.b1 = 0.0f;
+        filter.b2 = static_cast<float>(-alpha / a0);
+        filter.a1 = static_cast<float>(-2.0 * std::cos(w0) / a0);
+        filter.a2 = static_cast<float>((1.0 - alpha) / a0);
+        filter.z1 = 0.0f;
+        filter.z2 = 0.0f;
+        bandSquares[b] = 0.0;
+    }
+}
+
+void EnvelopeFollower::Emit(std::vector<EnvelopeTick>* ticks) {
+    EnvelopeTick tick;
+    tick.frame = position;
+    tick.rms = tickSamples > 0 ? static_cast<float>(std::sqrt(sumSquares / tickSamples)) : 0.0f;
+    tick.peak = peak;
+    for (size_t b = 0; b < kEnvelopeBands; b++) {
+        tick.bands[b] = bandsEnabled && tickFrames > 0
+            ? static_cast<float>(std::sqrt(bandSquares[b] / tickFrames)) : 0.0f;
+        bandSquares[b] = 0.0;
+    }
+    ticks->push_back(tick);
+
+    tickFrames = 0;
+    tickSamples = 0;
+    sumSquares = 0.0;
+    peak = 0.0f;
+}
+
+void EnvelopeFollower::Process(const void* data, size_t frames, std::vector<EnvelopeTick>* ticks) {
+    float scale = 1.0f / static_cast<float>(channels);
+
+    for (size_t i = 0; i < frames; i++) {
+        float mix = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            float sample = SampleToFloat(data, i * channels + c, type);
+            sumSquares += static_cast<double>(sample) * sample;
+            peak = std::max(peak, std::fabs(sample));
+            mix += sample;
+        }
+        tickSamples += channels;
+
+        if (bandsEnabled) {
+            mix *= scale;
+            for (size_t b = 0; b < kEnvelopeBands; b++) {
+                // Transposed direct form II.
+                Biquad& f = filters[b];
+                float y = f.b0 * mix + f.z1;
+                f.z1 = f.b1 * mix - f.a1 * y + f.z2;
+                f.z2 = f.b2 * mix - f.a2 * y;
+                bandSquares[b] += static_cast<double>(y) * y;
+            }
+        }
+
+        tickFrames++;
+        position++;
+        if (static_cast<double>(position) >= tickBoundary) {
+            Emit(ticks);
+            tickBoundary += framesPerTick;
+        }
+    }
+}
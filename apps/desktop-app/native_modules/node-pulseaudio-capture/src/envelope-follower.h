@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sample-type.h"
+
+// Rough viseme grouping: open vowels (A/O) carry most energy in the first
+// band, front vowels (E/I) in the second, fricatives (S/F) in the third.
+static const size_t kEnvelopeBands = 3;
+
+struct EnvelopeTick {
+    // Stream position (frames) at the end of the tick.
+    uint64_t frame;
+    float rms;
+    float peak;
+    float bands[kEnvelopeBands];
+};
+
+// Reduces the sample stream to a few values per display tick: RMS and peak
+// over all channels and, optionally, the RMS of three band-passed copies of
+// the channel mix. Ticks are spaced rate / tickRate frames apart, with the
+// fractional remainder carried so the long-term tick rate is exact.
+class EnvelopeFollower {
+public:
+    EnvelopeFollower(uint32_t rate, uint32_t channels, SampleType type, double tickRate, bool bands);
+
+    void Process(const void* data, size_t frames, std::vector<EnvelopeTick>* ticks);
+
+    double TickRate() const {
+        return tickRate;
+    }
+
+    bool Bands() const {
+        return bandsEnabled;
+    }
+
+private:
+    struct Biquad {
+        float b0, b1, b2, a1, a2;
+        float z1, z2;
+    };
+
+    void Emit(std::vector<EnvelopeTick>* ticks);
+
+    uint32_t rate;
+    uint32_t channels;
+    SampleType type;
+    double tickRate;
+    bool bandsEnabled;
+
+    double framesPerTick;
+    double tickBoundary;
+    uint64_t position;
+    size_t tickFrames;
+    size_t tickSamples;
+    double sumSquares;
+    float peak;
+    Biquad filters[kEnvelopeBands];
+    double bandSquares[kEnvelopeBands];
+};
@@ -0,0 +1,302 @@
+#include "fake-capture-backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "audio-converter.h"
+#include "capture-stats.h"
+
+static uint32_t GetU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8
+        | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static uint16_t GetU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+FakeCaptureBackend::FakeCaptureBackend(const FakeBackendConfig& config)
+    : config(config), fragmentFrames(0), totalFrames(0), filePosition(0), phase(0), noiseState(0x2545F491),
+      paused(false), resumed(false), stopping(false) {
+}
+
+FakeCaptureBackend::~FakeCaptureBackend() {
+    Close();
+}
+
+bool FakeCaptureBackend::Open(const std::string& device, pa_sample_spec* spec, const pa_channel_map& channelMap,
+    pa_usec_t fragmentUsec, CaptureBackendCallbacks callbacks, std::string* error) {
+    this->spec = *spec;
+    this->callbacks = std::move(callbacks);
+    fragmentFrames = std::max<size_t>(1, static_cast<size_t>(static_cast<uint64_t>(spec->rate) * fragmentUsec / 1000000));
+    totalFrames = static_cast<uint64_t>(std::llround(config.duration * spec->rate));
+
+    if (spec->format != PA_SAMPLE_FLOAT32LE && spec->format != PA_SAMPLE_S16LE && spec->format != PA_SAMPLE_S32LE) {
+        *error = "The fake backend produces f32le, s16le or s32le only";
+        return false;
+    }
+    if (config.source == FakeSource::File && !LoadFile(error)) {
+        return false;
+    }
+
+    scratch.assign(fragmentFrames * spec->channels, 0.0f);
+    output.assign(fragmentFrames * pa_frame_size(spec), 0);
+    worker = std::thread(&FakeCaptureBackend::Run, this);
+    return true;
+}
+
+// Reads a canonical or extensible WAV file and converts it to float32 at
+// the stream rate. The stream gets the file's channels, a downmix, or a
+// mono file copied to every channel.
+bool FakeCaptureBackend::LoadFile(std::string* error) {
+    std::ifstream in(config.path, std::ios::binary);
+    if (!in) {
+        *error = "Failed to open " + config.path;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        *error = config.path + " is not a WAV file";
+        return false;
+    }
+
+    uint16_t formatTag = 0;
+    uint16_t channels = 0;
+    uint32_t rate = 0;
+    uint16_t bits = 0;
+    const uint8_t* data = nullptr;
+    size_t dataBytes = 0;
+    size_t offset = 12;
+    while (offset + 8 <= bytes.size()) {
+        const uint8_t* chunk = bytes.data() + offset;
+        size_t size = std::min<size_t>(GetU32(chunk + 4), bytes.size() - offset - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            formatTag = GetU16(chunk + 8);
+            channels = GetU16(chunk + 10);
+            rate = GetU32(chunk + 12);
+            bits = GetU16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag in its subformat GUID.
+            if (formatTag == 0xFFFE && size >= 40) {
+                formatTag = GetU16(chunk + 32);
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            data = chunk + 8;
+            dataBytes = size;
+        }
+        offset += 8 + size + (size & 1);
+    }
+
+    SampleType type;
+    if (formatTag == 1 && bits == 16) {
+        type = SampleType::Int16;
+    } else if (formatTag == 1 && bits == 32) {
+        type = SampleType::Int32;
+    } else if (formatTag == 3 && bits == 32) {
+        type = SampleType::Float32;
+    } else {
+        *error = config.path + ": only 16/32-bit PCM and 32-bit float WAV files are supported";
+        return false;
+    }
+    if (!data || channels == 0 || rate == 0) {
+        *error = config.path + " has no audio";
+        return false;
+    }
+
+    uint32_t mixChannels = AudioConverter::SupportsChannels(channels, spec.channels) ? spec.channels
+        : channels == 1 ? 1 : 0;
+    if (mixChannels == 0) {
+        *error = config.path + " has " + std::to_string(channels) + " channels; the stream needs "
+            + std::to_string(spec.channels) + ", 1, or a mono file";
+        return false;
+    }
+
+    // Copied so integer samples are aligned for the converter.
+    size_t frames = dataBytes / (channels * SampleTypeSize(type));
+    std::vector<uint8_t> samples(data, data + frames * channels * SampleTypeSize(type));
+    AudioConverter converter(type, rate, channels, spec.rate, mixChannels);
+    size_t converted = 0;
+    const float* mixed = converter.Process(samples.data(), frames, &converted);
+    if (converted == 0) {
+        *error = config.path + " has no audio";
+        return false;
+    }
+
+    file.resize(converted * spec.channels);
+    for (size_t i = 0; i < converted; i++) {
+        for (uint32_t c = 0; c < spec.channels; c++) {
+            file[i * spec.channels + c] = mixed[i * mixChannels + (mixChannels == 1 ? 0 : c)];
+        }
+    }
+    filePosition = 0;
+    return true;
+}
+
+void FakeCaptureBackend::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void FakeCaptureBackend::LockDelivery() {
+    mutex.lock();
+}
+
+void FakeCaptureBackend::UnlockDelivery() {
+    mutex.unlock();
+}
+
+bool FakeCaptureBackend::SetPaused(bool paused, std::string* error) {
+    if (this->paused && !paused) {
+        resumed = true;
+    }
+    this->paused = paused;
+    wake.notify_all();
+    return true;
+}
+
+// Fragment k covers stream frames [k * fragmentFrames, ...); in realtime
+// mode it is delivered once its last frame would have been captured, like
+// a server fragment. A pause shifts the timeline by the paused span.
+void FakeCaptureBackend::Run() {
+    const double nanosPerFrame = 1e9 / spec.rate;
+    int64_t base = CaptureStats::MonotonicNanos();
+    uint64_t produced = 0;
+    uint64_t gapFrame = config.gapSeconds > 0 ? static_cast<uint64_t>(std::llround(config.gapAt * spec.rate))
+        : UINT64_MAX;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return !paused || stopping; });
+        if (stopping) {
+            break;
+        }
+        if (resumed) {
+            resumed = false;
+            base = CaptureStats::MonotonicNanos() - static_cast<int64_t>(produced * nanosPerFrame);
+        }
+
+        if (produced >= gapFrame) {
+            base += static_cast<int64_t>(config.gapSeconds * 1e9);
+            gapFrame = UINT64_MAX;
+        }
+        size_t frames = fragmentFrames;
+        if (totalFrames > 0) {
+            frames = static_cast<size_t>(std::min<uint64_t>(frames, totalFrames - produced));
+        }
+        if (gapFrame != UINT64_MAX) {
+            frames = static_cast<size_t>(std::min<uint64_t>(frames, gapFrame - produced));
+        }
+        int64_t start = base + static_cast<int64_t>(produced * nanosPerFrame);
+
+        if (config.realtime) {
+            int64_t end = base + static_cast<int64_t>((produced + frames) * nanosPerFrame);
+            std::chrono::steady_clock::time_point deadline{std::chrono::nanoseconds(end)};
+            if (wake.wait_until(lock, deadline, [this] { return paused || stopping; })) {
+                continue;
+            }
+        }
+
+        size_t generated = Generate(frames);
+        if (generated > 0) {
+            Encode(generated);
+            CaptureFragment fragment;
+            fragment.data = output.data();
+            fragment.length = generated * pa_frame_size(&spec);
+            fragment.captureNanos = start;
+            fragment.timed = true;
+            if (callbacks.fragment) {
+                callbacks.fragment(fragment);
+            }
+            produced += generated;
+        }
+
+        if (generated < frames || (totalFrames > 0 && produced >= totalFrames)) {
+            if (callbacks.ended) {
+                callbacks.ended();
+            }
+            break;
+        }
+
+        if (!config.realtime) {
+            // Let the JS thread take the lock between fragments.
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }
+}
+
+size_t FakeCaptureBackend::Generate(size_t frames) {
+    const uint32_t channels = spec.channels;
+    const float amplitude = static_cast<float>(config.amplitude);
+
+    switch (config.source) {
+        case FakeSource::Sine: {
+            const double step = 2.0 * M_PI * config.frequency / spec.rate;
+            for (size_t i = 0; i < frames; i++) {
+                float value = amplitude * static_cast<float>(std::sin(phase));
+                phase = std::fmod(phase + step, 2.0 * M_PI);
+                std::fill_n(scratch.data() + i * channels, channels, value);
+            }
+            return frames;
+        }
+        case FakeSource::Noise:
+            // xorshift32: cheap, and the same sequence on every run.
+            for (size_t i = 0; i < frames * channels; i++) {
+                noiseState ^= noiseState << 13;
+                noiseState ^= noiseState >> 17;
+                noiseState ^= noiseState << 5;
+                scratch[i] = amplitude * (static_cast<float>(noiseState) * (2.0f / 4294967296.0f) - 1.0f);
+            }
+            return frames;
+        case FakeSource::Silence:
+            std::fill_n(scratch.data(), frames * channels, 0.0f);
+            return frames;
+        case FakeSource::File: {
+            size_t fileFrames = file.size() / channels;
+            size_t done = 0;
+            while (done < frames) {
+                if (filePosition == fileFrames) {
+                    if (!config.loop) {
+                        break;
+                    }
+                    filePosition = 0;
+                }
+                size_t n = std::min(frames - done, fileFrames - filePosition);
+                std::copy_n(file.data() + filePosition * channels, n * channels, scratch.data() + done * channels);
+                filePosition += n;
+                done += n;
+            }
+            return done;
+        }
+    }
+    return 0;
+}
+
+// Float scratch to the stream format, clipped like a real source.
+void FakeCaptureBackend::Encode(size_t frames) {
+    size_t samples = frames * spec.channels;
+    if (spec.format == PA_SAMPLE_FLOAT32LE) {
+        std::memcpy(output.data(), scratch.data(), samples * sizeof(float));
+    } else if (spec.format == PA_SAMPLE_S16LE) {
+        int16_t* out = reinterpret_cast<int16_t*>(output.data());
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = static_cast<int16_t>(std::lrint(std::max(-1.0f, std::min(1.0f, scratch[i])) * 32767.0f));
+        }
+    } else {
+        int32_t* out = reinterpret_cast<int32_t*>(output.data());
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = static_cast<int32_t>(std::llrint(std::max(-1.0, std::min(1.0, static_cast<double>(scratch[i])))
+                * 2147483647.0));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture-backend.h"
+
+enum class FakeSource {
+    Sine,
+    Noise,
+    Silence,
+    File
+};
+
+struct FakeBackendConfig {
+    FakeSource source = FakeSource::Sine;
+    // WAV file for FakeSource::File: PCM s16/s32 or IEEE float32.
+    std::string path;
+    double frequency = 440.0;
+    double amplitude = 0.5;
+    // Pace fragments at the stream rate; otherwise produce them as fast as
+    // the delivery path takes them.
+    bool realtime = true;
+    // Replay the file from the start when it ends.
+    bool loop = false;
+    // Stop after this many seconds of audio (0: sources run until stopped,
+    // files until they end).
+    double duration = 0;
+    // Lose gapSeconds of audio once gapAt seconds have been produced: later
+    // fragments are stamped that much later, as after a server overrun.
+    double gapAt = 0;
+    double gapSeconds = 0;
+};
+
+// Stands in for the sound server so the delivery path can be exercised and
+// measured anywhere. A thread produces fragmentUsec-sized fragments of a
+// synthetic signal or a WAV file in exactly the requested format; a file
+// at another rate or channel count is converted once when it is opened.
+// Capture timestamps follow the stream position from Open(), so in
+// unthrottled mode they run ahead of the clock.
+class FakeCaptureBackend : public CaptureBackend {
+public:
+    explicit FakeCaptureBackend(const FakeBackendConfig& config);
+    ~FakeCaptureBackend() override;
+
+    bool Open(const std::string& device, pa_sample_spec* spec, const pa_channel_map& channelMap,
+        pa_usec_t fragmentUsec, CaptureBackendCallbacks callbacks, std::string* error) override;
+    bool SetPaused(bool paused, std::string* error) override;
+    void Close() override;
+
+    const char* Name() const override {
+        return "fake";
+    }
+
+    pa_usec_t FragmentUsec() const override {
+        return static_cast<pa_usec_t>(fragmentFrames) * 1000000 / spec.rate;
+    }
+
+    void LockDelivery() override;
+    void UnlockDelivery() override;
+
+private:
+    bool LoadFile(std::string* error);
+    void Run();
+    // Fills `scratch` with the next `frames` float frames; returns how many
+    // the source still had.
+    size_t Generate(size_t frames);
+    void Encode(size_t frames);
+
+    FakeBackendConfig config;
+    pa_sample_spec spec;
+    size_t fragmentFrames;
+    uint64_t totalFrames;
+    CaptureBackendCallbacks callbacks;
+
+    // The file, interleaved float32 in the stream rate and channels.
+    std::vector<float> file;
+    size_t filePosition;
+    double phase;
+    uint32_t noiseState;
+
+    std::vector<float> scratch;
+    std::vector<uint8_t> output;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool paused;
+    bool resumed;
+    bool stopping;
+    std::thread worker;
+};
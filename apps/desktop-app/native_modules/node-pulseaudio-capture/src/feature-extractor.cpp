@@ -0,0 +1,124 @@
+#include "feature-extractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const float kLogFloor = 1e-10f;
+
+FeatureExtractor::FeatureExtractor(uint32_t channels, SampleType type, const FeatureConfig& config)
+    : channels(channels), type(type), config(config), bins(config.fftSize / 2 + 1),
+      fft(Fft::NextPowerOfTwo(config.fftSize)), window(config.fftSize), history(config.fftSize),
+      windowed(fft.Size(), 0.0f), power(fft.Size() / 2 + 1), magnitude(bins),
+      melEnergy(config.melBands), melStart(config.melBands), melWeights(config.melBands),
+      dct(static_cast<size_t>(config.mfccCount) * config.melBands), fill(0), frameIndex(0) {
+    this->config.hopLength = std::max<uint32_t>(1, std::min(config.hopLength, config.fftSize));
+
+    const double pi = 3.14159265358979323846;
+    size_t n = config.fftSize;
+
+    // np.hanning: symmetric window.
+    for (size_t i = 0; i < n; i++) {
+        window[i] = n > 1 ? static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * static_cast<double>(i) / (n - 1))) : 1.0f;
+    }
+
+    // Same construction as AudioSpectralEncoder._mel_spectrogram, including
+    // its bin mapping (hz / rate * 2 * n_freqs) and integer truncation.
+    size_t bands = config.melBands;
+    double melMax = 2595.0 * std::log10(1.0 + config.sampleRate / 2.0 / 700.0);
+    std::vector<int64_t> binPoints(bands + 2);
+    for (size_t i = 0; i < bands + 2; i++) {
+        double mel = i == bands + 1 ? melMax : melMax * static_cast<double>(i) / static_cast<double>(bands + 1);
+        double hz = 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+        binPoints[i] = static_cast<int64_t>(hz / config.sampleRate * 2.0 * static_cast<double>(bins));
+    }
+    for (size_t m = 0; m < bands; m++) {
+        int64_t left = binPoints[m];
+        int64_t center = binPoints[m + 1];
+        int64_t right = binPoints[m + 2];
+        int64_t end = std::min<int64_t>(right, static_cast<int64_t>(bins));
+        melStart[m] = static_cast<size_t>(left);
+        melWeights[m].assign(static_cast<size_t>(std::max<int64_t>(0, end - left)), 0.0f);
+        for (int64_t f = left; f < center && f < end; f++) {
+            melWeights[m][f - left] = static_cast<float>(static_cast<double>(f - left) / (center - left));
+        }
+        for (int64_t f = center; f < end; f++) {
+            melWeights[m][f - left] = static_cast<float>(static_cast<double>(right - f) / (right - center));
+        }
+    }
+
+    // DCT-II as built by AudioSpectralEncoder._mfcc. Its orthonormal scale
+    // factors are applied per mel band (column) rather than per coefficient;
+    // that is reproduced here so the features stay interchangeable.
+    for (size_t k = 0; k < config.mfccCount; k++) {
+        for (size_t m = 0; m < bands; m++) {
+            double scale = std::sqrt((m == 0 ? 1.0 : 2.0) / static_cast<double>(bands));
+            dct[k * bands + m] = static_cast<float>(std::cos(pi * k * (m + 0.5) / bands) * scale);
+        }
+    }
+}
+
+void FeatureExtractor::Reset() {
+    fill = 0;
+    frameIndex = 0;
+}
+
+void FeatureExtractor::ComputeFrame(std::vector<float>* logMel, std::vector<float>* mfcc) {
+    size_t n = config.fftSize;
+    for (size_t i = 0; i < n; i++) {
+        windowed[i] = history[i] * window[i];
+    }
+    fft.PowerSpectrum(windowed.data(), power.data());
+    for (size_t k = 0; k < bins; k++) {
+        magnitude[k] = std::sqrt(power[k]);
+    }
+
+    size_t bands = config.melBands;
+    for (size_t m = 0; m < bands; m++) {
+        const std::vector<float>& weights = melWeights[m];
+        const float* source = magnitude.data() + melStart[m];
+        float sum = 0.0f;
+        for (size_t i = 0; i < weights.size(); i++) {
+            sum += weights[i] * source[i];
+        }
+        melEnergy[m] = std::log(std::max(sum, kLogFloor));
+    }
+    logMel->insert(logMel->end(), melEnergy.begin(), melEnergy.end());
+
+    for (size_t k = 0; k < config.mfccCount; k++) {
+        const float* row = dct.data() + k * bands;
+        float sum = 0.0f;
+        for (size_t m = 0; m < bands; m++) {
+            sum += row[m] * melEnergy[m];
+        }
+        mfcc->push_back(sum);
+    }
+}
+
+size_t FeatureExtractor::Process(const void* data, size_t frames, std::vector<float>* logMel, std::vector<float>* mfcc) {
+    size_t n = config.fftSize;
+    size_t hop = config.hopLength;
+    float scale = 1.0f / static_cast<float>(channels);
+    size_t produced = 0;
+
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            sum += SampleToFloat(data, i * channels + c, type);
+        }
+        history[fill++] = sum * scale;
+
+        if (fill < n) {
+            continue;
+        }
+
+        ComputeFrame(logMel, mfcc);
+        frameIndex++;
+        produced++;
+
+        std::memmove(history.data(), history.data() + hop, (n - hop) * sizeof(float));
+        fill = n - hop;
+    }
+
+    return produced;
+}
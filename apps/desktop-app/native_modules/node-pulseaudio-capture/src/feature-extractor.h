@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft.h"
+#include "sample-type.h"
+
+// Defaults match AudioSpectralEncoder (apps/backend/src/ai/multimodal/
+// audio_encoder_spectral.py): SAMPLE_RATE, N_FFT, HOP_LENGTH, N_MELS, N_MFCC.
+struct FeatureConfig {
+    uint32_t sampleRate = 16000;
+    uint32_t fftSize = 512;
+    uint32_t hopLength = 256;
+    uint32_t melBands = 20;
+    uint32_t mfccCount = 13;
+};
+
+// Streaming STFT -> log-mel -> MFCC. Frames are produced every hopLength
+// samples once fftSize samples are available, i.e. exactly the frames the
+// encoder's _stft() yields for the same signal. The Hann window, mel
+// filterbank and DCT matrix are built once; Process() does not allocate
+// beyond growing the output vectors.
+class FeatureExtractor {
+public:
+    FeatureExtractor(uint32_t channels, SampleType type, const FeatureConfig& config);
+
+    // Consumes interleaved input (channels are averaged) and appends
+    // melBands log-mel values and mfccCount MFCCs per completed frame.
+    // Returns the number of frames appended.
+    size_t Process(const void* data, size_t frames, std::vector<float>* logMel, std::vector<float>* mfcc);
+
+    const FeatureConfig& Config() const {
+        return config;
+    }
+
+    // Index of the next frame to be produced; frame n starts at sample
+    // n * hopLength of the stream.
+    uint64_t FrameIndex() const {
+        return frameIndex;
+    }
+
+    void Reset();
+
+private:
+    void ComputeFrame(std::vector<float>* logMel, std::vector<float>* mfcc);
+
+    uint32_t channels;
+    SampleType type;
+    FeatureConfig config;
+    size_t bins;
+
+    Fft fft;
+    std::vector<float> window;
+    std::vector<float> history;
+    std::vector<float> windowed;
+    std::vector<float> power;
+    std::vector<float> magnitude;
+    std::vector<float> melEnergy;
+
+    // Triangular filters stored sparsely: band m covers bins
+    // [melStart[m], melStart[m] + melWeights[m].size()).
+    std::vector<size_t> melStart;
+    std::vector<std::vector<float>> melWeights;
+    std::vector<float> dct;
+
+    size_t fill;
+    uint64_t frameIndex;
+};
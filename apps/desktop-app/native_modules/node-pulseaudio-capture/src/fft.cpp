@@ -0,0 +1,74 @@
+#include "fft.h"
+
+#include <cmath>
+#include <utility>
+
+Fft::Fft(size_t size) : size(size), twiddles(size / 2), bitReversed(size), scratch(size) {
+    const double pi = 3.14159265358979323846;
+    for (size_t k = 0; k < size / 2; k++) {
+        double angle = -2.0 * pi * static_cast<double>(k) / static_cast<double>(size);
+        twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size) {
+        bits++;
+    }
+    for (size_t i = 0; i < size; i++) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            if (i & (size_t(1) << b)) {
+                reversed |= size_t(1) << (bits - 1 - b);
+            }
+        }
+        bitReversed[i] = reversed;
+    }
+}
+
+size_t Fft::NextPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+void Fft::Forward(std::complex<float>* data) const {
+    for (size_t i = 0; i < size; i++) {
+        if (i < bitReversed[i]) {
+            std::swap(data[i], data[bitReversed[i]]);
+        }
+    }
+
+    for (size_t length = 2; length <= size; length <<= 1) {
+        size_t half = length / 2;
+        size_t stride = size / length;
+        for (size_t start = 0; start < size; start += length) {
+            for (size_t k = 0; k < half; k++) {
+                std::complex<float> t = twiddles[k * stride] * data[start + k + half];
+                data[start + k + half] = data[start + k] - t;
+                data[start + k] += t;
+            }
+        }
+    }
+}
+
+void Fft::Inverse(std::complex<float>* data) const {
+    for (size_t i = 0; i < size; i++) {
+        data[i] = std::conj(data[i]);
+    }
+    Forward(data);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = std::conj(data[i]);
+    }
+}
+
+void Fft::PowerSpectrum(const float* input, float* power) {
+    for (size_t i = 0; i < size; i++) {
+        scratch[i] = std::complex<float>(input[i], 0.0f);
+    }
+    Forward(scratch.data());
+    for (size_t k = 0; k <= size / 2; k++) {
+        power[k] = std::norm(scratch[k]);
+    }
+}
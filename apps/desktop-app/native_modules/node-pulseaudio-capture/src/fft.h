@@ -0,0 +1,33 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// In-place iterative radix-2 FFT with precomputed twiddles and bit-reversal
+// table. Sized once; Forward() and PowerSpectrum() never allocate.
+class Fft {
+public:
+    explicit Fft(size_t size);
+
+    size_t Size() const {
+        return size;
+    }
+
+    void Forward(std::complex<float>* data) const;
+
+    // Unscaled inverse: Inverse(Forward(x)) == size * x.
+    void Inverse(std::complex<float>* data) const;
+
+    // Power spectrum |X[k]|^2 for k = 0..size/2 of a real input of `size`
+    // samples. `power` must hold size/2 + 1 values.
+    void PowerSpectrum(const float* input, float* power);
+
+    static size_t NextPowerOfTwo(size_t n);
+
+private:
+    size_t size;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<size_t> bitReversed;
+    std::vector<std::complex<float>> scratch;
+};
@@ -0,0 +1,71 @@
+#include "history-buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+HistoryBuffer::HistoryBuffer(uint32_t sampleRate, size_t capacityFrames, size_t frameSize)
+    : sampleRate(sampleRate), capacityFrames(capacityFrames), frameSize(frameSize),
+      buffer(new uint8_t[capacityFrames * frameSize]), endFrame(0), endNanos(0), held(0) {
+}
+
+void HistoryBuffer::Write(const uint8_t* data, size_t frames, int64_t captureNanos) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Append(data, frames);
+    endFrame += frames;
+    endNanos = captureNanos + static_cast<int64_t>(frames) * 1000000000 / sampleRate;
+}
+
+void HistoryBuffer::WriteSilence(size_t frames) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Append(nullptr, frames);
+    endFrame += frames;
+    endNanos += static_cast<int64_t>(frames) * 1000000000 / sampleRate;
+}
+
+// Stores frames [endFrame, endFrame + frames); only the last capacityFrames
+// of a longer run survive, so the rest is skipped. A null `data` appends
+// silence, which every supported format encodes as zero bytes.
+void HistoryBuffer::Append(const uint8_t* data, size_t frames) {
+    uint64_t position = endFrame;
+    if (frames > capacityFrames) {
+        size_t skipped = frames - capacityFrames;
+        if (data) {
+            data += skipped * frameSize;
+        }
+        position += skipped;
+        frames = capacityFrames;
+    }
+
+    size_t offset = static_cast<size_t>((position % capacityFrames) * frameSize);
+    size_t bytes = frames * frameSize;
+    size_t first = std::min(bytes, capacityFrames * frameSize - offset);
+    if (data) {
+        std::memcpy(buffer.get() + offset, data, first);
+        std::memcpy(buffer.get(), data + first, bytes - first);
+    } else {
+        std::memset(buffer.get() + offset, 0, first);
+        std::memset(buffer.get(), 0, bytes - first);
+    }
+    held = std::min(capacityFrames, held + frames);
+}
+
+size_t HistoryBuffer::Snapshot(size_t frames, uint8_t* out, uint64_t* firstFrame, int64_t* firstNanos) {
+    std::lock_guard<std::mutex> lock(mutex);
+    frames = std::min(frames, held);
+
+    uint64_t start = endFrame - frames;
+    size_t offset = static_cast<size_t>((start % capacityFrames) * frameSize);
+    size_t bytes = frames * frameSize;
+    size_t first = std::min(bytes, capacityFrames * frameSize - offset);
+    std::memcpy(out, buffer.get() + offset, first);
+    std::memcpy(out + first, buffer.get(), bytes - first);
+
+    *firstFrame = start;
+    *firstNanos = endNanos - static_cast<int64_t>(frames) * 1000000000 / sampleRate;
+    return frames;
+}
+
+size_t HistoryBuffer::Held() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return held;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Fixed-size record of the most recent audio of a capture, for handing out
+// the seconds before a wake word or button press. All memory is allocated
+// up front; writing overwrites the oldest frames.
+//
+// The mainloop thread writes every converted fragment, gated or not, and
+// fills gaps with silence so the record stays contiguous in time.
+// Snapshot() copies from any thread. Both sides take a mutex; the writer
+// holds it for one fragment and a snapshot for a single memcpy of at most
+// the whole buffer, which the server-side buffer easily absorbs.
+class HistoryBuffer {
+public:
+    HistoryBuffer(uint32_t sampleRate, size_t capacityFrames, size_t frameSize);
+
+    // `captureNanos` is the capture time of the first frame.
+    void Write(const uint8_t* data, size_t frames, int64_t captureNanos);
+    void WriteSilence(size_t frames);
+
+    // Copies the newest min(frames, held) frames into `out`, oldest first,
+    // and returns how many were copied. `firstFrame` receives their stream
+    // position and `firstNanos` the capture time of the first one.
+    size_t Snapshot(size_t frames, uint8_t* out, uint64_t* firstFrame, int64_t* firstNanos);
+
+    size_t Held();
+
+    size_t CapacityFrames() const {
+        return capacityFrames;
+    }
+
+private:
+    void Append(const uint8_t* data, size_t frames);
+
+    uint32_t sampleRate;
+    size_t capacityFrames;
+    size_t frameSize;
+    std::unique_ptr<uint8_t[]> buffer;
+
+    std::mutex mutex;
+    // Stream position just past the newest frame, and its capture time.
+    uint64_t endFrame;
+    int64_t endNanos;
+    size_t held;
+};
@@ -0,0 +1,207 @@
+#include "opus-encoder-stage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef HAVE_OPUS
+#include <opus/opus.h>
+#endif
+
+// Largest packet libopus produces for a 60 ms frame is 3 * 1275 bytes.
+static const size_t kMaxPacketBytes = 4000;
+
+OpusEncoderStage::OpusEncoderStage(const OpusEncoderConfig& config, Sink sink)
+    : config(config), sink(std::move(sink)), encoder(nullptr),
+      frameSize(static_cast<uint32_t>(config.sampleRate * config.frameMs / 1000.0)),
+      bytesPerFrame(config.channels * (config.floatInput ? sizeof(float) : sizeof(int16_t))),
+      preSkip(0), bitrate(config.bitrate), queuedFrames(0), maxQueuedFrames(config.sampleRate),
+      droppedGapFrames(0), finishing(false), pending(frameSize * bytesPerFrame), pendingFrames(0),
+      pendingFrame(0), pendingNanos(0), pendingGap(0), output(kMaxPacketBytes) {
+}
+
+std::unique_ptr<OpusEncoderStage> OpusEncoderStage::Create(const OpusEncoderConfig& config, Sink sink,
+    std::string* error) {
+#ifdef HAVE_OPUS
+    const uint32_t rate = config.sampleRate;
+    if (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000) {
+        *error = "Opus encoding needs a rate of 8, 12, 16, 24 or 48 kHz; use convert.rate";
+        return nullptr;
+    }
+    if (config.channels != 1 && config.channels != 2) {
+        *error = "Opus encoding needs 1 or 2 channels; use convert.channels";
+        return nullptr;
+    }
+    const double frameMs = config.frameMs;
+    if (frameMs != 2.5 && frameMs != 5 && frameMs != 10 && frameMs != 20 && frameMs != 40 && frameMs != 60) {
+        *error = "encode.frameMs must be 2.5, 5, 10, 20, 40 or 60";
+        return nullptr;
+    }
+    if (config.bitrate != 0 && (config.bitrate < 500 || config.bitrate > 512000)) {
+        *error = "encode.bitrate must be between 500 and 512000";
+        return nullptr;
+    }
+
+    int application = OPUS_APPLICATION_AUDIO;
+    if (config.application == OpusApplication::Voip) {
+        application = OPUS_APPLICATION_VOIP;
+    } else if (config.application == OpusApplication::LowDelay) {
+        application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+    }
+
+    std::unique_ptr<OpusEncoderStage> stage(new OpusEncoderStage(config, std::move(sink)));
+    int status = OPUS_OK;
+    stage->encoder = opus_encoder_create(static_cast<opus_int32>(rate), static_cast<int>(config.channels),
+        application, &status);
+    if (status != OPUS_OK || !stage->encoder) {
+        *error = std::string("Failed to create Opus encoder: ") + opus_strerror(status);
+        return nullptr;
+    }
+
+    opus_encoder_ctl(stage->encoder, OPUS_SET_BITRATE(config.bitrate > 0 ? config.bitrate : OPUS_AUTO));
+    opus_encoder_ctl(stage->encoder, OPUS_SET_COMPLEXITY(std::max(0, std::min(10, config.complexity))));
+    opus_int32 value = 0;
+    if (opus_encoder_ctl(stage->encoder, OPUS_GET_LOOKAHEAD(&value)) == OPUS_OK) {
+        stage->preSkip = value;
+    }
+    if (opus_encoder_ctl(stage->encoder, OPUS_GET_BITRATE(&value)) == OPUS_OK) {
+        stage->bitrate = value;
+    }
+
+    stage->worker = std::thread(&OpusEncoderStage::Run, stage.get());
+    return stage;
+#else
+    *error = "Opus encoding is unavailable: the addon was built without libopus";
+    return nullptr;
+#endif
+}
+
+OpusEncoderStage::~OpusEncoderStage() {
+    Finish();
+#ifdef HAVE_OPUS
+    if (encoder) {
+        opus_encoder_destroy(encoder);
+    }
+#endif
+}
+
+void OpusEncoderStage::Submit(const uint8_t* data, size_t frames, uint64_t frame, int64_t captureNanos,
+    uint64_t gapFrames, uint64_t peekNanos) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (finishing) {
+        return;
+    }
+    if (queuedFrames + frames > maxQueuedFrames) {
+        droppedGapFrames += gapFrames + frames;
+        framesDropped.fetch_add(frames, std::memory_order_relaxed);
+        return;
+    }
+
+    Chunk chunk;
+    chunk.data.assign(data, data + frames * bytesPerFrame);
+    chunk.frames = frames;
+    chunk.frame = frame;
+    chunk.captureNanos = captureNanos;
+    chunk.gapFrames = gapFrames + droppedGapFrames;
+    chunk.peekNanos = peekNanos;
+    droppedGapFrames = 0;
+    queue.push_back(std::move(chunk));
+    queuedFrames += frames;
+    lock.unlock();
+    wake.notify_one();
+}
+
+void OpusEncoderStage::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishing = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void OpusEncoderStage::Run() {
+    uint64_t lastPeek = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return !queue.empty() || finishing; });
+        if (queue.empty()) {
+            break;
+        }
+        Chunk chunk = std::move(queue.front());
+        queue.pop_front();
+        queuedFrames -= chunk.frames;
+        lock.unlock();
+
+        Consume(chunk);
+        lastPeek = chunk.peekNanos;
+
+        lock.lock();
+    }
+    lock.unlock();
+
+    if (pendingFrames > 0) {
+        EncodePending(lastPeek);
+    }
+}
+
+void OpusEncoderStage::Consume(const Chunk& chunk) {
+    if (pendingFrames > 0 && chunk.frame != pendingFrame + pendingFrames) {
+        EncodePending(chunk.peekNanos);
+    }
+    pendingGap += chunk.gapFrames;
+
+    size_t offset = 0;
+    while (offset < chunk.frames) {
+        if (pendingFrames == 0) {
+            pendingFrame = chunk.frame + offset;
+            pendingNanos = chunk.captureNanos + static_cast<int64_t>(offset) * 1000000000 / config.sampleRate;
+        }
+        size_t n = std::min<size_t>(frameSize - pendingFrames, chunk.frames - offset);
+        std::memcpy(pending.data() + pendingFrames * bytesPerFrame, chunk.data.data() + offset * bytesPerFrame,
+            n * bytesPerFrame);
+        pendingFrames += n;
+        offset += n;
+
+        if (pendingFrames == frameSize) {
+            EncodePending(chunk.peekNanos);
+        }
+    }
+}
+
+// Encodes the frame being filled, padding it with silence if it is short.
+// Every packet therefore decodes to exactly frameSize frames.
+void OpusEncoderStage::EncodePending(uint64_t peekNanos) {
+    std::memset(pending.data() + pendingFrames * bytesPerFrame, 0, (frameSize - pendingFrames) * bytesPerFrame);
+    pendingFrames = 0;
+
+    int32_t bytes = -1;
+#ifdef HAVE_OPUS
+    if (config.floatInput) {
+        bytes = opus_encode_float(encoder, reinterpret_cast<const float*>(pending.data()), static_cast<int>(frameSize),
+            output.data(), static_cast<opus_int32>(output.size()));
+    } else {
+        bytes = opus_encode(encoder, reinterpret_cast<const opus_int16*>(pending.data()), static_cast<int>(frameSize),
+            output.data(), static_cast<opus_int32>(output.size()));
+    }
+#endif
+    if (bytes < 0) {
+        framesDropped.fetch_add(frameSize, std::memory_order_relaxed);
+        pendingGap += frameSize;
+        return;
+    }
+
+    EncodedPacket* packet = new EncodedPacket();
+    packet->data.assign(output.data(), output.data() + bytes);
+    packet->frame = pendingFrame;
+    packet->captureNanos = pendingNanos;
+    packet->frames = frameSize;
+    packet->gapFrames = pendingGap;
+    packet->peekNanos = peekNanos;
+    pendingGap = 0;
+
+    packetsEncoded.fetch_add(1, std::memory_order_relaxed);
+    bytesEncoded.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+    sink(packet);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct OpusEncoder;
+
+enum class OpusApplication {
+    Voip,
+    Audio,
+    LowDelay
+};
+
+struct OpusEncoderConfig {
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    // Interleaved float32 input; otherwise int16.
+    bool floatInput = true;
+    // Bits per second; 0 lets libopus pick from rate and channels.
+    int32_t bitrate = 0;
+    // One of 2.5, 5, 10, 20, 40, 60.
+    double frameMs = 20.0;
+    int32_t complexity = 10;
+    OpusApplication application = OpusApplication::Audio;
+};
+
+struct EncodedPacket {
+    std::vector<uint8_t> data;
+    // Stream position and CLOCK_MONOTONIC capture time of the first frame.
+    uint64_t frame;
+    int64_t captureNanos;
+    uint32_t frames;
+    // Frames lost (upstream or to a full input queue) since the previous packet.
+    uint64_t gapFrames;
+    // CaptureStats::NowNanos() of the peek that completed the packet.
+    uint64_t peekNanos;
+};
+
+// Encodes the delivered stream to Opus on its own thread so the PulseAudio
+// mainloop only pays for a copy. Submit() queues converted PCM together with
+// its stream position; the worker cuts it into fixed Opus frames and hands
+// each packet to the sink on the worker thread. A packet never spans a
+// discontinuity: when the stream position jumps (a gap, or audio held back
+// by the VAD gate) the partial frame is padded with silence and encoded.
+//
+// Without libopus at build time Create() always fails.
+class OpusEncoderStage {
+public:
+    using Sink = std::function<void(EncodedPacket*)>;
+
+    static std::unique_ptr<OpusEncoderStage> Create(const OpusEncoderConfig& config, Sink sink, std::string* error);
+
+    ~OpusEncoderStage();
+
+    // Mainloop thread. Drops the chunk (reported as a gap) if more than a
+    // second of audio is already waiting.
+    void Submit(const uint8_t* data, size_t frames, uint64_t frame, int64_t captureNanos,
+        uint64_t gapFrames, uint64_t peekNanos);
+
+    // Encodes what is queued, pads and encodes the last partial frame, and
+    // joins the worker. The sink is not called afterwards.
+    void Finish();
+
+    const OpusEncoderConfig& Config() const {
+        return config;
+    }
+
+    uint32_t FrameSize() const {
+        return frameSize;
+    }
+
+    // Samples the decoder should discard at the start (encoder lookahead).
+    int32_t PreSkip() const {
+        return preSkip;
+    }
+
+    int32_t Bitrate() const {
+        return bitrate;
+    }
+
+    std::atomic<uint64_t> packetsEncoded{0};
+    std::atomic<uint64_t> bytesEncoded{0};
+    std::atomic<uint64_t> framesDropped{0};
+
+private:
+    struct Chunk {
+        std::vector<uint8_t> data;
+        size_t frames;
+        uint64_t frame;
+        int64_t captureNanos;
+        uint64_t gapFrames;
+        uint64_t peekNanos;
+    };
+
+    OpusEncoderStage(const OpusEncoderConfig& config, Sink sink);
+
+    void Run();
+    void Consume(const Chunk& chunk);
+    void EncodePending(uint64_t peekNanos);
+
+    OpusEncoderConfig config;
+    Sink sink;
+    OpusEncoder* encoder;
+    uint32_t frameSize;
+    size_t bytesPerFrame;
+    int32_t preSkip;
+    int32_t bitrate;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Chunk> queue;
+    size_t queuedFrames;
+    size_t maxQueuedFrames;
+    uint64_t droppedGapFrames;
+    bool finishing;
+    std::thread worker;
+
+    // Worker-thread state of the frame being filled.
+    std::vector<uint8_t> pending;
+    size_t pendingFrames;
+    uint64_t pendingFrame;
+    int64_t pendingNanos;
+    uint64_t pendingGap;
+    std::vector<uint8_t> output;
+};
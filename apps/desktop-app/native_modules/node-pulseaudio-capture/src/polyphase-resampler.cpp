@@ -0,0 +1,116 @@
+#include "polyphase-resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static const double kPi = 3.14159265358979323846;
+
+// Kaiser beta for roughly 80 dB of stopband attenuation.
+static const double kKaiserBeta = 8.0;
+
+// Passband edge as a fraction of the output Nyquist frequency.
+static const double kPassbandFraction = 0.91;
+
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+PolyphaseResampler::PolyphaseResampler(uint32_t inputRate, uint32_t outputRate, uint32_t channels,
+                                       uint32_t zeroCrossings, SimdKernels kernels)
+    : channels(channels), kernels(kernels), history(channels), inputIndex(0), phase(0) {
+    uint32_t divisor = std::gcd(inputRate, outputRate);
+    interpolation = outputRate / divisor;
+    decimation = inputRate / divisor;
+
+    // Rounded up to a multiple of 8 so the AVX2 dot product has no tail.
+    uint64_t prototypeLength = 2ull * std::max<uint32_t>(2, zeroCrossings) * std::max(interpolation, decimation);
+    taps = static_cast<uint32_t>((prototypeLength + interpolation - 1) / interpolation);
+    taps = (taps + 7) & ~7u;
+
+    // Prototype runs at inputRate * L; cut off below the lower Nyquist.
+    size_t length = static_cast<size_t>(interpolation) * taps;
+    double cutoff = kPassbandFraction * 0.5 / std::max(interpolation, decimation);
+    double center = (static_cast<double>(length) - 1.0) / 2.0;
+    double norm = BesselI0(kKaiserBeta);
+
+    std::vector<double> prototype(length);
+    for (size_t n = 0; n < length; n++) {
+        double t = static_cast<double>(n) - center;
+        double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * kPi * cutoff * t) / (2.0 * kPi * cutoff * t);
+        double ratio = t / (center + 1.0);
+        double window = BesselI0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / norm;
+        prototype[n] = 2.0 * cutoff * sinc * window * interpolation;
+    }
+
+    coefficients.resize(length);
+    for (uint32_t p = 0; p < interpolation; p++) {
+        for (uint32_t k = 0; k < taps; k++) {
+            coefficients[p * taps + (taps - 1 - k)] = static_cast<float>(prototype[p + static_cast<size_t>(k) * interpolation]);
+        }
+    }
+
+    Reset();
+}
+
+void PolyphaseResampler::Reset() {
+    for (std::vector<float>& channelHistory : history) {
+        channelHistory.assign(taps - 1, 0.0f);
+    }
+    inputIndex = 0;
+    phase = 0;
+}
+
+size_t PolyphaseResampler::MaxOutputFrames(size_t inputFrames) const {
+    return (inputFrames * interpolation) / decimation + 2;
+}
+
+double PolyphaseResampler::DelayFrames() const {
+    double prototypeDelay = (static_cast<double>(interpolation) * taps - 1.0) / 2.0;
+    return prototypeDelay / decimation;
+}
+
+size_t PolyphaseResampler::Process(const float* input, size_t frames, float* output) {
+    size_t keep = taps - 1;
+    for (uint32_t c = 0; c < channels; c++) {
+        std::vector<float>& channelHistory = history[c];
+        channelHistory.resize(keep + frames);
+        float* dst = channelHistory.data() + keep;
+        for (size_t i = 0; i < frames; i++) {
+            dst[i] = input[i * channels + c];
+        }
+    }
+
+    // inputIndex is relative to the first new sample; the window for input
+    // sample i starts at history[i] and ends at history[i + taps - 1].
+    size_t produced = 0;
+    while (inputIndex < frames) {
+        const float* phaseCoefficients = coefficients.data() + static_cast<size_t>(phase) * taps;
+        for (uint32_t c = 0; c < channels; c++) {
+            output[produced * channels + c] = kernels.dotProduct(phaseCoefficients, history[c].data() + inputIndex, taps);
+        }
+        produced++;
+
+        phase += decimation;
+        inputIndex += phase / interpolation;
+        phase %= interpolation;
+    }
+    inputIndex -= frames;
+
+    for (uint32_t c = 0; c < channels; c++) {
+        std::vector<float>& channelHistory = history[c];
+        std::copy(channelHistory.end() - keep, channelHistory.end(), channelHistory.begin());
+        channelHistory.resize(keep);
+    }
+
+    return produced;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simd-kernels.h"
+
+// Streaming rational resampler (out/in = L/M after reducing by the GCD)
+// built on a Kaiser-windowed sinc prototype split into L polyphase branches.
+// Each output sample is one dot product of TapsPerPhase() coefficients with a
+// contiguous window of input history, which is what the SIMD kernels do.
+//
+// `zeroCrossings` is the one-sided length of the prototype in zero crossings
+// of the cutoff sinc; it sets the transition width independently of the
+// ratio, so decimating 48k -> 16k gets three times the taps of 48k -> 48k.
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(uint32_t inputRate, uint32_t outputRate, uint32_t channels,
+                       uint32_t zeroCrossings = 16, SimdKernels kernels = GetSimdKernels());
+
+    // Upper bound on the frames Process() produces for `inputFrames`.
+    size_t MaxOutputFrames(size_t inputFrames) const;
+
+    // Consumes interleaved input and writes interleaved output. Returns the
+    // number of output frames written.
+    size_t Process(const float* input, size_t frames, float* output);
+
+    void Reset();
+
+    uint32_t Interpolation() const {
+        return interpolation;
+    }
+
+    uint32_t Decimation() const {
+        return decimation;
+    }
+
+    uint32_t TapsPerPhase() const {
+        return taps;
+    }
+
+    // Group delay of the filter in output frames.
+    double DelayFrames() const;
+
+    SimdLevel Level() const {
+        return kernels.level;
+    }
+
+private:
+    uint32_t interpolation;
+    uint32_t decimation;
+    uint32_t channels;
+    uint32_t taps;
+    SimdKernels kernels;
+
+    // coefficients[phase * taps + j], time-reversed so that each phase is a
+    // plain dot product with history ending at the current input sample.
+    std::vector<float> coefficients;
+
+    // Per channel: taps - 1 samples of history followed by the current block.
+    std::vector<std::vector<float>> history;
+
+    uint64_t inputIndex;
+    uint32_t phase;
+};
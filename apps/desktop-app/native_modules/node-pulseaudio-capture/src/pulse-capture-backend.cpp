@@ -0,0 +1,210 @@
+#include "pulse-capture-backend.h"
+
+#include "capture-stats.h"
+
+PulseCaptureBackend::PulseCaptureBackend(const PulseBackendConfig& config)
+    : config(config), stream(nullptr), fragmentUsec(0), corkSucceeded(false) {
+}
+
+PulseCaptureBackend::~PulseCaptureBackend() {
+    Close();
+}
+
+// Joins the shared PulseAudio connection, then connects the record stream
+// on it and waits until it is READY. Only the first capture (or device
+// query) in the process pays for the server connection.
+bool PulseCaptureBackend::Open(const std::string& device, pa_sample_spec* spec, const pa_channel_map& channelMap,
+    pa_usec_t fragmentUsec, CaptureBackendCallbacks callbacks, std::string* error) {
+    connection = PulseConnection::Acquire(error);
+    if (!connection) {
+        return false;
+    }
+
+    PulseConnection::Lock lock(*connection);
+    if (!connection->WaitReady(error)) {
+        return false;
+    }
+
+    this->callbacks = std::move(callbacks);
+    stream = pa_stream_new(connection->Context(), "Angela Audio Capture", spec, &channelMap);
+    if (!stream) {
+        *error = connection->Error("Failed to create stream");
+        return false;
+    }
+
+    pa_stream_set_state_callback(stream, StreamStateCallback, this);
+    pa_stream_set_read_callback(stream, StreamReadCallback, this);
+    pa_stream_set_overflow_callback(stream, StreamOverflowCallback, this);
+    pa_stream_set_underflow_callback(stream, StreamUnderflowCallback, this);
+
+    pa_buffer_attr bufferAttr;
+    bufferAttr.maxlength = (uint32_t)-1;
+    bufferAttr.tlength = (uint32_t)-1;
+    bufferAttr.prebuf = (uint32_t)-1;
+    bufferAttr.minreq = (uint32_t)-1;
+    bufferAttr.fragsize = pa_usec_to_bytes(fragmentUsec, spec);
+
+    const char* monitorName = device.empty() ? NULL : device.c_str();
+
+    // Timing interpolation keeps pa_stream_get_latency() current between
+    // server updates; the read callback timestamps every fragment with it.
+    pa_stream_flags_t flags = static_cast<pa_stream_flags_t>(
+        PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE);
+    if (config.adjustLatency) {
+        flags = static_cast<pa_stream_flags_t>(flags | PA_STREAM_ADJUST_LATENCY);
+    }
+    if (pa_stream_connect_record(stream, monitorName, &bufferAttr, flags) < 0) {
+        *error = connection->Error("Failed to connect stream");
+        return false;
+    }
+
+    while (true) {
+        pa_stream_state_t state = pa_stream_get_state(stream);
+        if (state == PA_STREAM_READY) {
+            break;
+        }
+        if (!PA_STREAM_IS_GOOD(state)) {
+            *error = connection->Error("Stream connection failed");
+            return false;
+        }
+        pa_threaded_mainloop_wait(connection->Mainloop());
+    }
+
+    const pa_sample_spec* negotiated = pa_stream_get_sample_spec(stream);
+    if (negotiated) {
+        *spec = *negotiated;
+    }
+    sampleSpec = *spec;
+    const pa_buffer_attr* granted = pa_stream_get_buffer_attr(stream);
+    this->fragmentUsec = granted ? pa_bytes_to_usec(granted->fragsize, &sampleSpec) : fragmentUsec;
+    return true;
+}
+
+void PulseCaptureBackend::Close() {
+    if (connection) {
+        PulseConnection::Lock lock(*connection);
+        if (stream) {
+            pa_stream_set_state_callback(stream, NULL, NULL);
+            pa_stream_set_read_callback(stream, NULL, NULL);
+            pa_stream_set_overflow_callback(stream, NULL, NULL);
+            pa_stream_set_underflow_callback(stream, NULL, NULL);
+            pa_stream_disconnect(stream);
+            pa_stream_unref(stream);
+            stream = nullptr;
+        }
+    }
+    // Dropping the last reference closes the shared connection.
+    connection.reset();
+}
+
+void PulseCaptureBackend::LockDelivery() {
+    pa_threaded_mainloop_lock(connection->Mainloop());
+}
+
+void PulseCaptureBackend::UnlockDelivery() {
+    pa_threaded_mainloop_unlock(connection->Mainloop());
+}
+
+// Resuming first drops whatever the server recorded for the stream before
+// it was corked. The flush is pipelined with the uncork, so both cost one
+// round trip.
+bool PulseCaptureBackend::SetPaused(bool paused, std::string* error) {
+    if (!paused) {
+        pa_operation* flush = pa_stream_flush(stream, NULL, NULL);
+        if (flush) {
+            pa_operation_unref(flush);
+        }
+    }
+
+    corkSucceeded = false;
+    pa_operation* op = pa_stream_cork(stream, paused ? 1 : 0, StreamCorkCallback, this);
+    if (!op) {
+        *error = connection->Error(paused ? "Failed to pause stream" : "Failed to resume stream");
+        return false;
+    }
+    while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+        pa_threaded_mainloop_wait(connection->Mainloop());
+    }
+    pa_operation_unref(op);
+
+    if (!corkSucceeded) {
+        *error = connection->Error(paused ? "Failed to pause stream" : "Failed to resume stream");
+        return false;
+    }
+    return true;
+}
+
+// For a record stream the latency covers the source plus everything queued
+// ahead of the read pointer, so the fragment's first frame was captured
+// that long ago. Before the first timing update, assume the fragment just
+// completed.
+void PulseCaptureBackend::StreamReadCallback(pa_stream* p, size_t nbytes, void* userdata) {
+    PulseCaptureBackend* backend = static_cast<PulseCaptureBackend*>(userdata);
+    const void* data;
+    size_t length;
+
+    if (pa_stream_peek(p, &data, &length) < 0) {
+        return;
+    }
+
+    if (length == 0) {
+        return;
+    }
+
+    int64_t now = CaptureStats::MonotonicNanos();
+    int64_t duration = static_cast<int64_t>(length / pa_frame_size(&backend->sampleSpec)) * 1000000000
+        / backend->sampleSpec.rate;
+    pa_usec_t latency = 0;
+    int negative = 0;
+    bool measured = pa_stream_get_latency(p, &latency, &negative) == 0;
+
+    CaptureFragment fragment;
+    fragment.data = data;
+    fragment.length = length;
+    fragment.timed = measured;
+    fragment.captureNanos = !measured ? now - duration
+        : negative ? now + static_cast<int64_t>(latency) * 1000
+        : now - static_cast<int64_t>(latency) * 1000;
+    if (backend->callbacks.fragment) {
+        backend->callbacks.fragment(fragment);
+    }
+
+    pa_stream_drop(p);
+}
+
+// libpulse documents overflow/underflow notifications for playback streams;
+// on record streams server-side overruns show up as holes.
+void PulseCaptureBackend::StreamOverflowCallback(pa_stream* p, void* userdata) {
+    PulseCaptureBackend* backend = static_cast<PulseCaptureBackend*>(userdata);
+    if (backend->callbacks.overflow) {
+        backend->callbacks.overflow();
+    }
+}
+
+void PulseCaptureBackend::StreamUnderflowCallback(pa_stream* p, void* userdata) {
+    PulseCaptureBackend* backend = static_cast<PulseCaptureBackend*>(userdata);
+    if (backend->callbacks.underflow) {
+        backend->callbacks.underflow();
+    }
+}
+
+void PulseCaptureBackend::StreamStateCallback(pa_stream* p, void* userdata) {
+    PulseCaptureBackend* backend = static_cast<PulseCaptureBackend*>(userdata);
+    pa_stream_state_t state = pa_stream_get_state(p);
+
+    switch (state) {
+        case PA_STREAM_READY:
+        case PA_STREAM_FAILED:
+        case PA_STREAM_TERMINATED:
+            pa_threaded_mainloop_signal(backend->connection->Mainloop(), 0);
+            break;
+        default:
+            break;
+    }
+}
+
+void PulseCaptureBackend::StreamCorkCallback(pa_stream* p, int success, void* userdata) {
+    PulseCaptureBackend* backend = static_cast<PulseCaptureBackend*>(userdata);
+    backend->corkSucceeded = success != 0;
+    pa_threaded_mainloop_signal(backend->connection->Mainloop(), 0);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+
+#include <memory>
+#include <string>
+
+#include "capture-backend.h"
+#include "pulse-connection.h"
+
+struct PulseBackendConfig {
+    // PA_STREAM_ADJUST_LATENCY: the server sizes the source latency to the
+    // requested fragment instead of buffering at its own default.
+    bool adjustLatency = true;
+};
+
+// A record stream on the shared PulseAudio connection. The delivery thread
+// is the connection's mainloop and the Lock is the mainloop lock. Every
+// fragment is timestamped from the stream latency, which timing
+// interpolation keeps current between server updates.
+class PulseCaptureBackend : public CaptureBackend {
+public:
+    explicit PulseCaptureBackend(const PulseBackendConfig& config);
+    ~PulseCaptureBackend() override;
+
+    bool Open(const std::string& device, pa_sample_spec* spec, const pa_channel_map& channelMap,
+        pa_usec_t fragmentUsec, CaptureBackendCallbacks callbacks, std::string* error) override;
+    bool SetPaused(bool paused, std::string* error) override;
+    void Close() override;
+
+    const char* Name() const override {
+        return "pulse";
+    }
+
+    pa_usec_t FragmentUsec() const override {
+        return fragmentUsec;
+    }
+
+    void LockDelivery() override;
+    void UnlockDelivery() override;
+
+private:
+    static void StreamReadCallback(pa_stream* p, size_t nbytes, void* userdata);
+    static void StreamOverflowCallback(pa_stream* p, void* userdata);
+    static void StreamUnderflowCallback(pa_stream* p, void* userdata);
+    static void StreamStateCallback(pa_stream* p, void* userdata);
+    static void StreamCorkCallback(pa_stream* p, int success, void* userdata);
+
+    PulseBackendConfig config;
+    std::shared_ptr<PulseConnection> connection;
+    pa_stream* stream;
+    pa_sample_spec sampleSpec;
+    CaptureBackendCallbacks callbacks;
+    pa_usec_t fragmentUsec;
+    bool corkSucceeded;
+};
@@ -0,0 +1,116 @@
+#include "pulse-connection.h"
+
+#include <algorithm>
+#include <mutex>
+
+std::shared_ptr<PulseConnection> PulseConnection::Acquire(std::string* error) {
+    static std::mutex sharedMutex;
+    static std::weak_ptr<PulseConnection> shared;
+
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    std::shared_ptr<PulseConnection> connection = shared.lock();
+    if (connection && connection->Usable()) {
+        return connection;
+    }
+
+    connection.reset(new PulseConnection());
+    if (!connection->Open(error)) {
+        return nullptr;
+    }
+    shared = connection;
+    return connection;
+}
+
+PulseConnection::PulseConnection() : mainloop(nullptr), context(nullptr) {
+}
+
+PulseConnection::~PulseConnection() {
+    if (!mainloop) {
+        return;
+    }
+
+    pa_threaded_mainloop_lock(mainloop);
+    if (context) {
+        pa_context_set_state_callback(context, NULL, NULL);
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+        context = nullptr;
+    }
+    pa_threaded_mainloop_unlock(mainloop);
+
+    pa_threaded_mainloop_stop(mainloop);
+    pa_threaded_mainloop_free(mainloop);
+}
+
+bool PulseConnection::Open(std::string* error) {
+    mainloop = pa_threaded_mainloop_new();
+    if (!mainloop) {
+        *error = "Failed to create mainloop";
+        return false;
+    }
+
+    if (pa_threaded_mainloop_start(mainloop) < 0) {
+        pa_threaded_mainloop_free(mainloop);
+        mainloop = nullptr;
+        *error = "Failed to start mainloop";
+        return false;
+    }
+
+    Lock lock(*this);
+    context = pa_context_new(pa_threaded_mainloop_get_api(mainloop), "Angela AI Audio Capture");
+    if (!context) {
+        *error = "Failed to create context";
+        return false;
+    }
+
+    pa_context_set_state_callback(context, ContextStateCallback, this);
+    if (pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+        *error = Error("Failed to connect context");
+        return false;
+    }
+    return true;
+}
+
+bool PulseConnection::Usable() {
+    Lock lock(*this);
+    return PA_CONTEXT_IS_GOOD(pa_context_get_state(context));
+}
+
+bool PulseConnection::WaitReady(std::string* error) {
+    while (true) {
+        pa_context_state_t state = pa_context_get_state(context);
+        if (state == PA_CONTEXT_READY) {
+            return true;
+        }
+        if (!PA_CONTEXT_IS_GOOD(state)) {
+            *error = Error("Context connection failed");
+            return false;
+        }
+        pa_threaded_mainloop_wait(mainloop);
+    }
+}
+
+std::string PulseConnection::Error(const char* message) const {
+    return std::string(message) + ": " + pa_strerror(pa_context_errno(context));
+}
+
+void PulseConnection::AddStateListener(const void* owner, StateListener listener) {
+    listeners.emplace_back(owner, std::move(listener));
+}
+
+void PulseConnection::RemoveStateListener(const void* owner) {
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+        [owner](const std::pair<const void*, StateListener>& entry) { return entry.first == owner; }),
+        listeners.end());
+}
+
+void PulseConnection::ContextStateCallback(pa_context* c, void* userdata) {
+    PulseConnection* connection = static_cast<PulseConnection*>(userdata);
+    pa_context_state_t state = pa_context_get_state(c);
+
+    // Wakes every thread blocked in WaitReady() or waiting for a stream.
+    pa_threaded_mainloop_signal(connection->mainloop, 0);
+    for (const auto& entry : connection->listeners) {
+        entry.second(state);
+    }
+}
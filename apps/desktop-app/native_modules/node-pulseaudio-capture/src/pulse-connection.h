@@ -0,0 +1,72 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The process-wide PulseAudio connection: one threaded mainloop and one
+// pa_context that every capture stream and the device registry multiplex
+// over. Acquire() hands out shared references and the last holder to let go
+// disconnects the context and joins the mainloop thread, so a reference must
+// never be dropped from inside a mainloop callback.
+//
+// A connection whose context has failed (e.g. the server restarted) is not
+// handed out again; the next Acquire() opens a fresh one while existing
+// holders keep the dead one until they release it.
+class PulseConnection {
+public:
+    using StateListener = std::function<void(pa_context_state_t)>;
+
+    // Scoped pa_threaded_mainloop lock.
+    class Lock {
+    public:
+        explicit Lock(PulseConnection& connection) : mainloop(connection.mainloop) {
+            pa_threaded_mainloop_lock(mainloop);
+        }
+        ~Lock() {
+            pa_threaded_mainloop_unlock(mainloop);
+        }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+
+    private:
+        pa_threaded_mainloop* mainloop;
+    };
+
+    // Returns the shared connection, opening it if there is none. Does not
+    // wait for the server; use WaitReady() before creating streams.
+    static std::shared_ptr<PulseConnection> Acquire(std::string* error);
+
+    ~PulseConnection();
+
+    pa_threaded_mainloop* Mainloop() const { return mainloop; }
+    pa_context* Context() const { return context; }
+
+    // Waits until the context is READY. The caller holds the Lock; false
+    // with `error` set if the connection failed.
+    bool WaitReady(std::string* error);
+
+    // `message` followed by the context's last error.
+    std::string Error(const char* message) const;
+
+    // Listeners run on the mainloop thread for every context state change
+    // and are added and removed with the Lock held.
+    void AddStateListener(const void* owner, StateListener listener);
+    void RemoveStateListener(const void* owner);
+
+private:
+    PulseConnection();
+
+    bool Open(std::string* error);
+    bool Usable();
+
+    static void ContextStateCallback(pa_context* context, void* userdata);
+
+    pa_threaded_mainloop* mainloop;
+    pa_context* context;
+    std::vector<std::pair<const void*, StateListener>> listeners;
+};
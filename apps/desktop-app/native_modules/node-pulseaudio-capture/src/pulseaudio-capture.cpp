@@ -3,159 +3,885 @@
 #include <pulse/simple.h>
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstring>
 #include <mutex>
 #include <atomic>
 #include <memory>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+#include "audio-converter.h"
+#include "capture-session.h"
+#include "capture-stats.h"
+#include "device-registry.h"
+#include "shared-memory-ring.h"
+#include "envelope-follower.h"
+#include "feature-extractor.h"
+#include "history-buffer.h"
+#include "opus-encoder-stage.h"
+#include "recording-sink.h"
+#include "rolling-archive.h"
+#include "capture-backend.h"
+#include "fake-capture-backend.h"
+#include "pulse-capture-backend.h"
+#include "spsc-ring-buffer.h"
+#include "voice-activity-detector.h"
+
+static const pa_usec_t kDefaultFragmentUsec = 20000;
+static const uint32_t kDefaultBufferMs = 1000;
+static const uint32_t kDefaultRate = 48000;
+static const uint8_t kDefaultChannels = 2;
+static const uint32_t kDefaultResamplerQuality = 16;
+static const double kDefaultEnvelopeRate = 60.0;
+// A fragment starting later than this past the end of the previous one (or
+// a fragment's duration, if longer) is counted as a server-side overrun.
+static const int64_t kGapToleranceNanos = 5000000;
+static const double kMaxHistorySeconds = 600.0;
+static const double kDefaultArchiveSeconds = 300.0;
+static const double kMaxArchiveSeconds = 6 * 3600.0;
+// getDevices() waits this long for the registry's first query; afterwards it
+// is served from the cache.
+static const std::chrono::milliseconds kDeviceListTimeout(2000);
+
+enum class DeliveryMode {
+    TypedArray,
+    Array
+};
+
+struct CaptureBlock {
+    std::unique_ptr<uint8_t[]> data;
+    size_t byteLength;
+    uint64_t peekNanos;
+    // Assigned at dispatch, one per block handed to the queue.
+    uint64_t sequence;
+    // Position of the first frame in the delivered stream. Frames lost to
+    // gaps and frames held back by the VAD gate are counted, so a block
+    // never covers a discontinuity.
+    uint64_t frame;
+    // CLOCK_MONOTONIC time at which the first frame was captured.
+    int64_t captureNanos;
+    // Frames lost to holes or overruns since the previous block.
+    uint64_t gapFrames;
+    // Blocks the full queue dropped since the previous dispatched block.
+    uint64_t droppedBlocks;
+};
+
+static bool ParseSampleFormat(const std::string& name, pa_sample_format_t* format) {
+    if (name == "f32le") {
+        *format = PA_SAMPLE_FLOAT32LE;
+    } else if (name == "s16le") {
+        *format = PA_SAMPLE_S16LE;
+    } else if (name == "s32le") {
+        *format = PA_SAMPLE_S32LE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char* SampleFormatName(pa_sample_format_t format) {
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+            return "int16";
+        case PA_SAMPLE_S32LE:
+            return "int32";
+        default:
+            return "float32";
+    }
+}
+
+static SampleType SampleTypeFor(pa_sample_format_t format) {
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+            return SampleType::Int16;
+        case PA_SAMPLE_S32LE:
+            return SampleType::Int32;
+        default:
+            return SampleType::Float32;
+    }
+}
+
+static napi_typedarray_type TypedArrayTypeFor(pa_sample_format_t format) {
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+            return napi_int16_array;
+        case PA_SAMPLE_S32LE:
+            return napi_int32_array;
+        default:
+            return napi_float32_array;
+    }
+}
+
+// Reads `features` options into `config`; the sample rate is left to the
+// caller. Throws and returns false on invalid values.
+static bool ParseFeatureConfig(Napi::Env env, Napi::Object options, FeatureConfig* config) {
+    if (options.Has("fftSize") && options.Get("fftSize").IsNumber()) {
+        config->fftSize = options.Get("fftSize").As<Napi::Number>().Uint32Value();
+    }
+    if (options.Has("hopLength") && options.Get("hopLength").IsNumber()) {
+        config->hopLength = options.Get("hopLength").As<Napi::Number>().Uint32Value();
+    }
+    if (options.Has("melBands") && options.Get("melBands").IsNumber()) {
+        config->melBands = options.Get("melBands").As<Napi::Number>().Uint32Value();
+    }
+    if (options.Has("mfccCount") && options.Get("mfccCount").IsNumber()) {
+        config->mfccCount = options.Get("mfccCount").As<Napi::Number>().Uint32Value();
+    }
+    
+    if (config->fftSize < 16 || (config->fftSize & (config->fftSize - 1)) != 0) {
+        Napi::RangeError::New(env, "fftSize must be a power of two >= 16").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (config->hopLength == 0 || config->hopLength > config->fftSize) {
+        Napi::RangeError::New(env, "hopLength must be between 1 and fftSize").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (config->melBands == 0 || config->mfccCount > config->melBands) {
+        Napi::RangeError::New(env, "melBands must be positive and mfccCount at most melBands").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+static Napi::Float32Array FloatsToTypedArray(Napi::Env env, const std::vector<float>& values) {
+    Napi::Float32Array array = Napi::Float32Array::New(env, values.size());
+    if (!values.empty()) {
+        std::memcpy(array.Data(), values.data(), values.size() * sizeof(float));
+    }
+    return array;
+}
+
+// Out-of-band notification for the JS `onEvent` callback, e.g. speechStart.
+struct CaptureEvent {
+    std::string type;
+    std::vector<std::pair<std::string, double>> fields;
+    std::vector<std::pair<std::string, std::vector<float>>> arrays;
+};
+
+// Per-environment state shared by all instances. The registry is declared
+// last so it is destroyed (detaching from the connection) before the TSFN.
+struct AddonData {
+    Napi::FunctionReference constructor;
+    Napi::ThreadSafeFunction deviceTsfn;
+    DeviceRegistry registry;
+};
+
+static Napi::Array DevicesToArray(Napi::Env env, const std::vector<DeviceInfo>& devices) {
+    Napi::Array array = Napi::Array::New(env);
+    for (const DeviceInfo& info : devices) {
+        Napi::Object device = Napi::Object::New(env);
+        device.Set("id", info.id);
+        device.Set("name", info.name);
+        device.Set("description", info.description);
+        array.Set(array.Length(), device);
+    }
+    return array;
+}
+
+static Napi::Value DefaultDeviceToValue(Napi::Env env, const std::string& name) {
+    if (name.empty()) {
+        return env.Null();
+    }
+    Napi::Object device = Napi::Object::New(env);
+    device.Set("id", name);
+    device.Set("name", name);
+    return device;
+}
 
 class PulseAudioCapture : public Napi::ObjectWrap<PulseAudioCapture> {
 private:
-    pa_threaded_mainloop* mainloop;
-    pa_context* context;
-    pa_stream* stream;
+    // Created by Connect() for each start(): PulseAudio, or a fake source
+    // for tests and benchmarks.
+    std::unique_ptr<CaptureBackend> backend;
+    bool useFakeBackend;
+    FakeBackendConfig fakeConfig;
+    PulseBackendConfig pulseConfig;
     pa_sample_spec sampleSpec;
+    pa_sample_spec outputSpec;
     pa_channel_map channelMap;
+    size_t frameSize;
+    uint32_t resamplerQuality;
+    std::unique_ptr<AudioConverter> converter;
     bool isCapturing;
+    // start() is in flight on a worker thread; stop() during that window
+    // sets stopRequested and the worker tears down instead of resolving.
+    // The stop() promises wait in stopWaiters until it has.
+    bool isStarting;
+    bool stopRequested;
+    std::vector<Napi::Promise::Deferred> stopWaiters;
+    // pause()/resume() cork the stream but keep it and the connection, so
+    // resuming costs one server round trip instead of a new stream.
+    bool isPaused;
+    bool isCorking;
+    DeliveryMode deliveryMode;
+    OverflowPolicy overflowPolicy;
+    uint32_t bufferFrames;
+    uint32_t blockFrames;
+    pa_usec_t fragmentUsec;
+    std::unique_ptr<CaptureBlock> pendingBlock;
+    // Mainloop-thread clock of the delivered stream. streamFrame is the
+    // delivered-rate position of the next fragment; anchorFrame/anchorNanos
+    // pin the current fragment to CLOCK_MONOTONIC. expectedNanos is when
+    // the next fragment should start if nothing was lost in between.
+    uint64_t streamFrame;
+    uint64_t anchorFrame;
+    int64_t anchorNanos;
+    int64_t expectedNanos;
+    bool timingValid;
+    uint64_t pendingGapFrames;
+    uint64_t nextSequence;
+    uint64_t pendingDrops;
+    std::unique_ptr<SpscRingBuffer<uint8_t>> ring;
+    // The format the pull ring holds; like historySpec it survives a
+    // rejected start() that already parsed another format.
+    pa_sample_spec ringSpec;
+    // Armed by notifyWhenAvailable(): once the ring holds this many bytes
+    // the mainloop thread disarms it and posts a 'readable' event.
+    std::atomic<size_t> readThreshold;
+    std::unique_ptr<SharedMemoryRing> sharedRing;
+    std::string sharedMemoryName;
+    uint32_t sharedMemoryFrames;
+    std::unique_ptr<EnvelopeFollower> envelope;
+    std::vector<EnvelopeTick> envelopeTicks;
+    bool envelopeEnabled;
+    double envelopeRate;
+    bool envelopeBands;
+    std::unique_ptr<FeatureExtractor> features;
+    bool featuresEnabled;
+    FeatureConfig featureConfig;
+    std::unique_ptr<VoiceActivityDetector> vad;
+    std::vector<VadEvent> vadEvents;
+    std::unique_ptr<SpscRingBuffer<uint8_t>> vadPreroll;
+    std::vector<uint8_t> vadScratch;
+    bool vadEnabled;
+    VadConfig vadConfig;
+    // Rolling record of the last historySeconds, kept past stop() so the
+    // moments before it can still be snapshotted.
+    std::unique_ptr<HistoryBuffer> history;
+    // Built by start() and swapped into history once the stream has
+    // connected, so a start() rejected asynchronously keeps the old one.
+    std::unique_ptr<HistoryBuffer> startingHistory;
+    // The buffer the running capture records into; only the delivery
+    // thread writes through it.
+    HistoryBuffer* liveHistory;
+    double historySeconds;
+    // The format history was recorded in; a rejected start() may already
+    // have parsed a different outputSpec.
+    pa_sample_spec historySpec;
+    // With encode set, delivered audio goes through the Opus stage and the
+    // callback receives packets; the stage's thread is then the only one
+    // dispatching to tsfn.
+    std::unique_ptr<OpusEncoderStage> encoder;
+    bool encodeEnabled;
+    OpusEncoderConfig encoderConfig;
+    // Set and taken under the mainloop lock; the read callback feeds it.
+    std::unique_ptr<RecordingSink> recorder;
+    // Memory-mapped look-back file. Views handed to JS hold a reference,
+    // so the mapping outlives both stop() and a new start().
+    std::shared_ptr<RollingArchive> archive;
+    std::string archivePath;
+    double archiveSeconds;
+    pa_sample_spec archiveSpec;
+    std::shared_ptr<CaptureStats> stats;
     std::atomic<bool> shouldStop;
     std::mutex captureMutex;
     Napi::ThreadSafeFunction tsfn;
+    Napi::ThreadSafeFunction eventTsfn;
     std::thread captureThread;
     
     void Cleanup() {
         shouldStop = true;
         
-        if (mainloop) {
-            pa_threaded_mainloop_signal(mainloop, 0);
-        }
-        
         if (captureThread.joinable()) {
             captureThread.join();
         }
         
+        if (backend) {
+            backend->Close();
+            backend.reset();
+        }
+        liveHistory = nullptr;
+        
+        // Backend callbacks run with its lock held, so once Close() has
+        // returned none of them can still reach the TSFNs.
+        FlushPendingBlock(CaptureStats::NowNanos());
+        pendingBlock.reset();
+        
+        // Encodes the tail and joins the encoder thread while tsfn is alive.
+        encoder.reset();
+        
+        // stop() also finalises a recording that stopRecording() did not.
+        recorder.reset();
+        
+        // Readers keep their mapping; the name is unlinked here.
+        sharedRing.reset();
+        
         if (tsfn) {
             tsfn.Release();
+            tsfn = Napi::ThreadSafeFunction();
         }
         
-        if (stream) {
-            pa_stream_disconnect(stream);
-            pa_stream_unref(stream);
-            stream = nullptr;
+        if (eventTsfn) {
+            eventTsfn.Release();
+            eventTsfn = Napi::ThreadSafeFunction();
+        }
+    }
+
+    // A typed array of `format` over `length` samples of `arrayBuffer`. On
+    // failure the N-API error is thrown and null returned.
+    static Napi::Value SampleArray(Napi::Env env, napi_value arrayBuffer, pa_sample_format_t format, size_t length) {
+        napi_value typedArray;
+        if (napi_create_typedarray(env, TypedArrayTypeFor(format), length, arrayBuffer, 0, &typedArray) != napi_ok) {
+            Napi::Error::New(env).ThrowAsJavaScriptException();
+            return env.Null();
         }
+        return Napi::Value(env, typedArray);
+    }
+
+    // Hands the block's buffer to V8 as the backing store of a typed array
+    // matching the negotiated sample format. Runtimes built with the V8
+    // sandbox (Electron >= 21) refuse external buffers; there we fall back to
+    // a single copy into a V8-owned buffer.
+    static Napi::Value BlockToTypedArray(Napi::Env env, CaptureBlock* block, pa_sample_format_t format) {
+        napi_value arrayBuffer;
+        napi_status status = napi_create_external_arraybuffer(
+            env, block->data.get(), block->byteLength,
+            [](napi_env, void* data, void*) { delete[] static_cast<uint8_t*>(data); },
+            nullptr, &arrayBuffer
+        );
         
-        if (context) {
-            pa_context_disconnect(context);
-            pa_context_unref(context);
-            context = nullptr;
+        if (status == napi_ok) {
+            block->data.release();
+        } else {
+            Napi::ArrayBuffer copied = Napi::ArrayBuffer::New(env, block->byteLength);
+            std::memcpy(copied.Data(), block->data.get(), block->byteLength);
+            arrayBuffer = copied;
         }
         
-        if (mainloop) {
-            pa_threaded_mainloop_stop(mainloop);
-            pa_threaded_mainloop_free(mainloop);
-            mainloop = nullptr;
+        return SampleArray(env, arrayBuffer, format, block->byteLength / pa_sample_size_of_format(format));
+    }
+
+    static Napi::Value BlockToArray(Napi::Env env, CaptureBlock* block, pa_sample_format_t format) {
+        size_t sampleCount = block->byteLength / pa_sample_size_of_format(format);
+        Napi::Array arr = Napi::Array::New(env, sampleCount);
+        for (size_t i = 0; i < sampleCount; i++) {
+            double value;
+            switch (format) {
+                case PA_SAMPLE_S16LE:
+                    value = reinterpret_cast<const int16_t*>(block->data.get())[i];
+                    break;
+                case PA_SAMPLE_S32LE:
+                    value = reinterpret_cast<const int32_t*>(block->data.get())[i];
+                    break;
+                default:
+                    value = reinterpret_cast<const float*>(block->data.get())[i];
+                    break;
+            }
+            arr.Set(static_cast<uint32_t>(i), value);
         }
+        return arr;
     }
 
-    static void StreamReadCallback(pa_stream* p, size_t nbytes, void* userdata) {
-        PulseAudioCapture* capture = static_cast<PulseAudioCapture*>(userdata);
-        
-        if (capture->shouldStop) {
+    static Napi::Object BlockInfo(Napi::Env env, const CaptureBlock* block) {
+        Napi::Object info = Napi::Object::New(env);
+        info.Set("sequence", static_cast<double>(block->sequence));
+        info.Set("frame", static_cast<double>(block->frame));
+        info.Set("timestamp", static_cast<double>(block->captureNanos) / 1e6);
+        info.Set("gap", static_cast<double>(block->gapFrames));
+        info.Set("dropped", static_cast<double>(block->droppedBlocks));
+        return info;
+    }
+
+    void DispatchBlock(CaptureBlock* block) {
+        block->sequence = nextSequence++;
+        block->droppedBlocks = pendingDrops;
+        DeliveryMode mode = deliveryMode;
+        pa_sample_format_t format = outputSpec.format;
+        std::shared_ptr<CaptureStats> blockStats = stats;
+        auto callback = [mode, format, blockStats](Napi::Env env, Napi::Function jsCallback, CaptureBlock* block) {
+            std::unique_ptr<CaptureBlock> owned(block);
+            blockStats->QueuePop();
+            if (env == nullptr || jsCallback.IsEmpty()) {
+                return;
+            }
+            
+            Napi::Value samples = mode == DeliveryMode::Array
+                ? BlockToArray(env, owned.get(), format) : BlockToTypedArray(env, owned.get(), format);
+            if (samples.IsNull()) {
+                // Thrown here it would surface as an uncaught exception;
+                // the block is counted as lost instead.
+                env.GetAndClearPendingException();
+                blockStats->blocksDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            
+            blockStats->deliveryLatency.Record((CaptureStats::NowNanos() - owned->peekNanos) / 1000);
+            blockStats->blocksDelivered.fetch_add(1, std::memory_order_relaxed);
+            jsCallback.Call({samples, BlockInfo(env, owned.get())});
+        };
+        
+        stats->QueuePush();
+        if (tsfn.NonBlockingCall(block, callback) != napi_ok) {
+            stats->QueuePop();
+            stats->blocksDropped.fetch_add(1, std::memory_order_relaxed);
+            delete block;
+            pendingDrops++;
+        } else {
+            pendingDrops = 0;
+        }
+    }
+
+    // Runs on the encoder thread.
+    void DispatchPacket(EncodedPacket* packet) {
+        uint64_t sequence = nextSequence++;
+        uint64_t dropped = pendingDrops;
+        std::shared_ptr<CaptureStats> packetStats = stats;
+        auto callback = [sequence, dropped, packetStats](Napi::Env env, Napi::Function jsCallback, EncodedPacket* packet) {
+            std::unique_ptr<EncodedPacket> owned(packet);
+            packetStats->QueuePop();
+            if (env == nullptr || jsCallback.IsEmpty()) {
+                return;
+            }
+            
+            packetStats->deliveryLatency.Record((CaptureStats::NowNanos() - owned->peekNanos) / 1000);
+            packetStats->blocksDelivered.fetch_add(1, std::memory_order_relaxed);
+            
+            Napi::Object info = Napi::Object::New(env);
+            info.Set("sequence", static_cast<double>(sequence));
+            info.Set("frame", static_cast<double>(owned->frame));
+            info.Set("timestamp", static_cast<double>(owned->captureNanos) / 1e6);
+            info.Set("gap", static_cast<double>(owned->gapFrames));
+            info.Set("dropped", static_cast<double>(dropped));
+            info.Set("frames", owned->frames);
+            jsCallback.Call({Napi::Buffer<uint8_t>::Copy(env, owned->data.data(), owned->data.size()), info});
+        };
+        
+        stats->QueuePush();
+        if (tsfn.NonBlockingCall(packet, callback) != napi_ok) {
+            stats->QueuePop();
+            stats->blocksDropped.fetch_add(1, std::memory_order_relaxed);
+            delete packet;
+            pendingDrops++;
+        } else {
+            pendingDrops = 0;
+        }
+    }
+
+    void FlushPendingBlock(uint64_t peekNanos) {
+        if (tsfn && pendingBlock && pendingBlock->byteLength > 0) {
+            pendingBlock->peekNanos = peekNanos;
+            DispatchBlock(pendingBlock.release());
+        }
+    }
+
+    // Capture time of a delivered-stream frame, extrapolated from the
+    // current fragment's anchor at the delivered rate. Frames replayed from
+    // the VAD preroll lie before the anchor.
+    int64_t FrameNanos(uint64_t frame) const {
+        int64_t offset = static_cast<int64_t>(frame - anchorFrame);
+        return anchorNanos + offset * 1000000000 / static_cast<int64_t>(outputSpec.rate);
+    }
+
+    CaptureBlock* NewBlock(uint64_t frame) {
+        CaptureBlock* block = new CaptureBlock();
+        block->frame = frame;
+        block->captureNanos = FrameNanos(frame);
+        block->gapFrames = pendingGapFrames;
+        pendingGapFrames = 0;
+        return block;
+    }
+
+    // Runs on the mainloop thread. With a delivery block size set, fragments
+    // are coalesced into blocks of exactly blockFrames frames; otherwise each
+    // fragment is delivered as it arrives. A block's latency is measured from
+    // the peek of the fragment that completed it. `frame` is the stream
+    // position of data; a partial block that it does not continue is handed
+    // out short, so every block is contiguous.
+    void DeliverSamples(const uint8_t* data, size_t length, uint64_t frame, uint64_t peekNanos) {
+        size_t blockBytes = static_cast<size_t>(blockFrames) * frameSize;
+        
+        if (blockBytes == 0) {
+            CaptureBlock* block = NewBlock(frame);
+            block->byteLength = length;
+            block->peekNanos = peekNanos;
+            block->data.reset(new uint8_t[length]);
+            std::memcpy(block->data.get(), data, length);
+            DispatchBlock(block);
             return;
         }
         
-        const void* data;
-        size_t length;
+        if (pendingBlock && pendingBlock->frame + pendingBlock->byteLength / frameSize != frame) {
+            FlushPendingBlock(peekNanos);
+        }
         
-        if (pa_stream_peek(p, &data, &length) < 0) {
+        while (length > 0) {
+            if (!pendingBlock) {
+                pendingBlock.reset(NewBlock(frame));
+                pendingBlock->byteLength = 0;
+                pendingBlock->data.reset(new uint8_t[blockBytes]);
+            }
+            
+            size_t n = std::min(length, blockBytes - pendingBlock->byteLength);
+            std::memcpy(pendingBlock->data.get() + pendingBlock->byteLength, data, n);
+            pendingBlock->byteLength += n;
+            data += n;
+            length -= n;
+            frame += n / frameSize;
+            
+            if (pendingBlock->byteLength == blockBytes) {
+                pendingBlock->peekNanos = peekNanos;
+                DispatchBlock(pendingBlock.release());
+            }
+        }
+    }
+
+    void EmitEvent(CaptureEvent* event) {
+        auto callback = [](Napi::Env env, Napi::Function jsCallback, CaptureEvent* event) {
+            std::unique_ptr<CaptureEvent> owned(event);
+            if (env == nullptr || jsCallback.IsEmpty()) {
+                return;
+            }
+            
+            Napi::Object payload = Napi::Object::New(env);
+            for (const auto& field : owned->fields) {
+                payload.Set(field.first, field.second);
+            }
+            for (const auto& array : owned->arrays) {
+                payload.Set(array.first, FloatsToTypedArray(env, array.second));
+            }
+            jsCallback.Call({Napi::String::New(env, owned->type), payload});
+        };
+        
+        if (!eventTsfn || eventTsfn.NonBlockingCall(event, callback) != napi_ok) {
+            delete event;
+        }
+    }
+
+    // Feeds the whole converted stream (gated or not) to the extractor and
+    // posts the frames completed by this fragment as one 'features' event.
+    void ExtractFeatures(const uint8_t* data, size_t length) {
+        uint64_t firstFrame = features->FrameIndex();
+        std::vector<float> logMel;
+        std::vector<float> mfcc;
+        size_t frames = features->Process(data, length / frameSize, &logMel, &mfcc);
+        if (frames == 0) {
             return;
         }
         
-        if (data && length > 0) {
-            std::vector<float> samples;
-            size_t sampleCount = length / sizeof(float);
-            samples.reserve(sampleCount);
-            
-            const float* floatData = static_cast<const float*>(data);
-            for (size_t i = 0; i < sampleCount; i++) {
-                samples.push_back(floatData[i]);
+        const FeatureConfig& config = features->Config();
+        CaptureEvent* event = new CaptureEvent();
+        event->type = "features";
+        event->fields.push_back({"frames", static_cast<double>(frames)});
+        event->fields.push_back({"frameIndex", static_cast<double>(firstFrame)});
+        event->fields.push_back({"time", static_cast<double>(firstFrame) * config.hopLength / config.sampleRate});
+        event->fields.push_back({"melBands", static_cast<double>(config.melBands)});
+        event->fields.push_back({"mfccCount", static_cast<double>(config.mfccCount)});
+        event->arrays.push_back({"logMel", std::move(logMel)});
+        event->arrays.push_back({"mfcc", std::move(mfcc)});
+        EmitEvent(event);
+    }
+
+    void FollowEnvelope(const uint8_t* data, size_t length) {
+        envelopeTicks.clear();
+        envelope->Process(data, length / frameSize, &envelopeTicks);
+        
+        for (const EnvelopeTick& tick : envelopeTicks) {
+            CaptureEvent* event = new CaptureEvent();
+            event->type = "envelope";
+            event->fields.push_back({"rms", tick.rms});
+            event->fields.push_back({"peak", tick.peak});
+            event->fields.push_back({"time", static_cast<double>(tick.frame) / outputSpec.rate});
+            if (envelope->Bands()) {
+                event->fields.push_back({"low", tick.bands[0]});
+                event->fields.push_back({"mid", tick.bands[1]});
+                event->fields.push_back({"high", tick.bands[2]});
             }
+            EmitEvent(event);
+        }
+    }
+
+    void EmitSamples(const uint8_t* data, size_t length, uint64_t frame, uint64_t peekNanos) {
+        if (ring) {
+            ring->Write(data, length);
             
-            if (capture->tsfn) {
-                auto callback = [samples](Napi::Env env, Napi::Function jsCallback) {
-                    Napi::Array arr = Napi::Array::New(env, samples.size());
-                    for (size_t i = 0; i < samples.size(); i++) {
-                        arr.Set(i, samples[i]);
+            size_t threshold = readThreshold.load(std::memory_order_acquire);
+            if (threshold > 0 && ring->Available() >= threshold
+                && readThreshold.compare_exchange_strong(threshold, 0, std::memory_order_acq_rel)) {
+                CaptureEvent* event = new CaptureEvent();
+                event->type = "readable";
+                event->fields.push_back({"available", static_cast<double>(ring->Available() / frameSize)});
+                EmitEvent(event);
+            }
+        }
+        
+        if (sharedRing) {
+            sharedRing->Write(data, length);
+        }
+        
+        if (encoder) {
+            encoder->Submit(data, length / frameSize, frame, FrameNanos(frame), pendingGapFrames, peekNanos);
+            pendingGapFrames = 0;
+        } else if (tsfn) {
+            DeliverSamples(data, length, frame, peekNanos);
+        }
+    }
+
+    // Runs the VAD over a converted fragment and forwards only the spans
+    // inside speech. Speech starts are backdated by the attack time, so the
+    // most recent gated-out audio is kept in vadPreroll to be replayed.
+    // The VAD counts only the frames it saw; streamStart maps its position
+    // back onto the delivered stream, which also counts gaps.
+    void GateSamples(const uint8_t* data, size_t length, uint64_t streamStart, uint64_t peekNanos) {
+        size_t frames = length / frameSize;
+        uint64_t fragmentStart = vad->Position();
+        auto streamFrameOf = [streamStart, fragmentStart](uint64_t position) {
+            return streamStart + (position - fragmentStart);
+        };
+        bool open = vad->Active();
+        
+        vadEvents.clear();
+        vad->Process(data, frames, &vadEvents);
+        
+        uint64_t position = fragmentStart;
+        size_t forwarded = 0;
+        for (const VadEvent& event : vadEvents) {
+            if (event.speech) {
+                if (event.frame < fragmentStart) {
+                    size_t buffered = vadPreroll->Available() / frameSize;
+                    uint64_t prerollStart = fragmentStart - buffered;
+                    size_t skip = static_cast<size_t>(std::max(event.frame, prerollStart) - prerollStart);
+                    size_t copied = vadPreroll->Read(vadScratch.data(), buffered * frameSize);
+                    if (copied > skip * frameSize) {
+                        EmitSamples(vadScratch.data() + skip * frameSize, copied - skip * frameSize,
+                            streamFrameOf(prerollStart + skip), peekNanos);
                     }
-                    jsCallback.Call({arr});
-                };
-                
-                capture->tsfn.NonBlockingCall(callback);
+                }
+                position = std::max(event.frame, fragmentStart);
+                open = true;
+            } else {
+                if (open && event.frame > position) {
+                    size_t bytes = static_cast<size_t>(event.frame - position) * frameSize;
+                    EmitSamples(data + (position - fragmentStart) * frameSize, bytes, streamFrameOf(position), peekNanos);
+                    forwarded += bytes;
+                }
+                position = event.frame;
+                open = false;
             }
+            
+            // Reported on the delivered stream, like block info.frame and
+            // info.timestamp, not the VAD's own gap-free count.
+            uint64_t eventFrame = streamFrameOf(event.frame);
+            CaptureEvent* notification = new CaptureEvent();
+            notification->type = event.speech ? "speechStart" : "speechEnd";
+            notification->fields.push_back({"sampleOffset", static_cast<double>(eventFrame)});
+            notification->fields.push_back({"time", static_cast<double>(eventFrame) / outputSpec.rate});
+            notification->fields.push_back({"timestamp", static_cast<double>(FrameNanos(eventFrame)) / 1e6});
+            EmitEvent(notification);
         }
         
-        pa_stream_drop(p);
+        uint64_t fragmentEnd = fragmentStart + frames;
+        if (open && fragmentEnd > position) {
+            size_t bytes = static_cast<size_t>(fragmentEnd - position) * frameSize;
+            EmitSamples(data + (position - fragmentStart) * frameSize, bytes, streamFrameOf(position), peekNanos);
+            forwarded += bytes;
+        }
+        
+        if (open) {
+            vadPreroll->Clear();
+        } else {
+            vadPreroll->Write(data, length);
+        }
+        stats->bytesGated.fetch_add(length - forwarded, std::memory_order_relaxed);
     }
 
-    static void StreamStateCallback(pa_stream* p, void* userdata) {
-        PulseAudioCapture* capture = static_cast<PulseAudioCapture*>(userdata);
-        pa_stream_state_t state = pa_stream_get_state(p);
+    // Runs on the backend's delivery thread for every fragment, with the
+    // backend lock held.
+    void OnFragment(const CaptureFragment& fragment) {
+        if (shouldStop) {
+            return;
+        }
+        
+        // Delivery latency is measured from the fragment's arrival.
+        uint64_t peekNanos = CaptureStats::NowNanos();
+        const void* data = fragment.data;
+        size_t length = fragment.length;
+        CaptureStats& s = *stats;
+        s.fragmentsRead.fetch_add(1, std::memory_order_relaxed);
+        s.bytesRead.fetch_add(length, std::memory_order_relaxed);
         
-        switch (state) {
-            case PA_STREAM_READY:
-                pa_threaded_mainloop_signal(capture->mainloop, 0);
-                break;
-            case PA_STREAM_FAILED:
-            case PA_STREAM_TERMINATED:
-                pa_threaded_mainloop_signal(capture->mainloop, 0);
-                break;
-            default:
-                break;
+        if (!data) {
+            s.holes.fetch_add(1, std::memory_order_relaxed);
         }
+        TrackFragment(length / pa_frame_size(&sampleSpec), !data, fragment.captureNanos, fragment.timed);
+        
+        const uint8_t* output = static_cast<const uint8_t*>(data);
+        size_t outputLength = length;
+        
+        if (data && converter) {
+            size_t frames = 0;
+            const float* converted = converter->Process(data, length / pa_frame_size(&sampleSpec), &frames);
+            output = reinterpret_cast<const uint8_t*>(converted);
+            outputLength = frames * frameSize;
+        }
+        
+        if (data && outputLength > 0 && envelope) {
+            FollowEnvelope(output, outputLength);
+        }
+        
+        if (data && outputLength > 0 && features) {
+            ExtractFeatures(output, outputLength);
+        }
+        
+        if (data && outputLength > 0 && liveHistory) {
+            liveHistory->Write(output, outputLength / frameSize, anchorNanos);
+        }
+        
+        if (data && outputLength > 0 && archive) {
+            archive->Write(output, outputLength / frameSize, anchorNanos);
+        }
+        
+        if (data && outputLength > 0 && recorder) {
+            recorder->Write(output, outputLength / frameSize);
+        }
+        
+        if (data && outputLength > 0) {
+            if (vad) {
+                GateSamples(output, outputLength, streamFrame, peekNanos);
+            } else {
+                EmitSamples(output, outputLength, streamFrame, peekNanos);
+            }
+            streamFrame += outputLength / frameSize;
+        }
+        
+        s.callbackDuration.Record((CaptureStats::NowNanos() - peekNanos) / 1000);
     }
 
-    static void ContextStateCallback(pa_context* c, void* userdata) {
-        PulseAudioCapture* capture = static_cast<PulseAudioCapture*>(userdata);
-        pa_context_state_t state = pa_context_get_state(c);
+    // Runs on the delivery thread for every fragment before any of it is
+    // delivered. `captureNanos` is the capture time the backend gave the
+    // fragment's first frame; `measured` says whether it is more than a
+    // guess. A hole, or a fragment starting well after the previous one
+    // ended (the server overran the stream buffer), advances the stream
+    // position by the frames lost and posts a 'gap'.
+    void TrackFragment(size_t inputFrames, bool hole, int64_t captureNanos, bool measured) {
+        int64_t duration = static_cast<int64_t>(inputFrames) * 1000000000 / sampleSpec.rate;
+        
+        uint64_t lost = 0;
+        int64_t gapNanos = captureNanos;
+        if (hole) {
+            lost = (static_cast<uint64_t>(inputFrames) * outputSpec.rate + sampleSpec.rate / 2) / sampleSpec.rate;
+        } else if (measured && timingValid) {
+            int64_t late = captureNanos - expectedNanos;
+            if (late > std::max(kGapToleranceNanos, duration)) {
+                lost = static_cast<uint64_t>((late * outputSpec.rate + 500000000) / 1000000000);
+                gapNanos = expectedNanos;
+            }
+        }
+        
+        timingValid = measured;
+        expectedNanos = captureNanos + duration;
+        
+        if (lost > 0) {
+            uint64_t gapStart = streamFrame;
+            streamFrame += lost;
+            pendingGapFrames += lost;
+            if (liveHistory) {
+                liveHistory->WriteSilence(lost);
+            }
+            if (recorder) {
+                recorder->WriteSilence(lost);
+            }
+            stats->gaps.fetch_add(1, std::memory_order_relaxed);
+            stats->framesLost.fetch_add(lost, std::memory_order_relaxed);
+            
+            CaptureEvent* event = new CaptureEvent();
+            event->type = "gap";
+            event->fields.push_back({"frame", static_cast<double>(gapStart)});
+            event->fields.push_back({"frames", static_cast<double>(lost)});
+            event->fields.push_back({"timestamp", static_cast<double>(gapNanos) / 1e6});
+            EmitEvent(event);
+        }
         
-        switch (state) {
-            case PA_CONTEXT_READY:
-                pa_threaded_mainloop_signal(capture->mainloop, 0);
-                break;
-            case PA_CONTEXT_FAILED:
-            case PA_CONTEXT_TERMINATED:
-                pa_threaded_mainloop_signal(capture->mainloop, 0);
-                break;
-            default:
-                break;
+        if (!hole) {
+            anchorFrame = streamFrame;
+            anchorNanos = captureNanos;
         }
     }
 
+    // A finite fake source ran out; the capture stays open but silent.
+    void OnEnded() {
+        FlushPendingBlock(CaptureStats::NowNanos());
+        CaptureEvent* event = new CaptureEvent();
+        event->type = "ended";
+        event->fields.push_back({"frame", static_cast<double>(streamFrame)});
+        EmitEvent(event);
+    }
+
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports) {
         Napi::Function func = DefineClass(env, "PulseAudioCapture", {
             InstanceMethod("start", &PulseAudioCapture::Start),
             InstanceMethod("stop", &PulseAudioCapture::Stop),
             InstanceMethod("getFormat", &PulseAudioCapture::GetFormat),
-            InstanceMethod("getDevices", &PulseAudioCapture::GetDevices).Static(),
-            StaticMethod<&PulseAudioCapture::getDefaultDevice>("getDefaultDevice")
+            InstanceMethod("read", &PulseAudioCapture::Read),
+            InstanceMethod("available", &PulseAudioCapture::Available),
+            InstanceMethod("snapshot", &PulseAudioCapture::Snapshot),
+            InstanceMethod("readRange", &PulseAudioCapture::ReadRange),
+            InstanceMethod("startRecording", &PulseAudioCapture::StartRecording),
+            InstanceMethod("stopRecording", &PulseAudioCapture::StopRecording),
+            InstanceMethod("notifyWhenAvailable", &PulseAudioCapture::NotifyWhenAvailable),
+            InstanceMethod("getStats", &PulseAudioCapture::GetStats),
+            InstanceMethod("pause", &PulseAudioCapture::Pause),
+            InstanceMethod("resume", &PulseAudioCapture::Resume),
+            StaticMethod("getDevices", &PulseAudioCapture::GetDevices),
+            StaticMethod("extractFeatures", &PulseAudioCapture::ExtractFeaturesOffline),
+            StaticMethod("getDefaultDevice", &PulseAudioCapture::GetDefaultDevice),
+            StaticMethod("listDevices", &PulseAudioCapture::ListDevices),
+            StaticMethod("watchDevices", &PulseAudioCapture::WatchDevices)
         });
 
-        Napi::FunctionReference* constructor = new Napi::FunctionReference();
-        *constructor = Napi::Persistent(func);
-        env.SetInstanceData<Napi::FunctionReference>(constructor);
+        AddonData* data = new AddonData();
+        data->constructor = Napi::Persistent(func);
+        env.SetInstanceData<AddonData>(data);
 
         exports.Set("PulseAudioCapture", func);
         return exports;
     }
 
     PulseAudioCapture(const Napi::CallbackInfo& info) : Napi::ObjectWrap<PulseAudioCapture>(info) {
-        mainloop = nullptr;
-        context = nullptr;
-        stream = nullptr;
+        useFakeBackend = false;
         isCapturing = false;
+        isStarting = false;
+        stopRequested = false;
+        isPaused = false;
+        isCorking = false;
+        deliveryMode = DeliveryMode::TypedArray;
+        overflowPolicy = OverflowPolicy::DropOldest;
+        bufferFrames = 0;
+        blockFrames = 0;
+        fragmentUsec = kDefaultFragmentUsec;
+        readThreshold = 0;
+        sharedMemoryFrames = 0;
+        envelopeEnabled = false;
+        featuresEnabled = false;
+        vadEnabled = false;
+        historySeconds = 0;
+        liveHistory = nullptr;
+        encodeEnabled = false;
+        archiveSeconds = 0;
+        stats = std::make_shared<CaptureStats>();
         shouldStop = false;
         
         sampleSpec.format = PA_SAMPLE_FLOAT32LE;
-        sampleSpec.rate = 48000;
-        sampleSpec.channels = 2;
+        sampleSpec.rate = kDefaultRate;
+        sampleSpec.channels = kDefaultChannels;
+        outputSpec = sampleSpec;
+        historySpec = sampleSpec;
+        ringSpec = sampleSpec;
+        archiveSpec = sampleSpec;
+        frameSize = pa_frame_size(&outputSpec);
+        resamplerQuality = kDefaultResamplerQuality;
         
         pa_channel_map_init_stereo(&channelMap);
     }
@@ -167,7 +893,7 @@ public:
     Napi::Value Start(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         
-        if (isCapturing) {
+        if (isCapturing || isStarting) {
             Napi::Error::New(env, "Already capturing").ThrowAsJavaScriptException();
             return env.Null();
         }
@@ -183,297 +909,1385 @@ public:
             callback = info[1].As<Napi::Function>();
         }
         
-        mainloop = pa_threaded_mainloop_new();
-        if (!mainloop) {
-            Napi::Error::New(env, "Failed to create mainloop").ThrowAsJavaScriptException();
+        Napi::Object options = (info.Length() >= 3 && info[2].IsObject())
+            ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+        if (!ParseStartOptions(env, options)) {
             return env.Null();
         }
-        
-        if (pa_threaded_mainloop_start(mainloop) < 0) {
-            pa_threaded_mainloop_free(mainloop);
-            mainloop = nullptr;
-            Napi::Error::New(env, "Failed to start mainloop").ThrowAsJavaScriptException();
+        if (encodeEnabled && callback.IsEmpty()) {
+            Napi::TypeError::New(env, "encode requires a callback").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (encodeEnabled && outputSpec.format != PA_SAMPLE_FLOAT32LE && outputSpec.format != PA_SAMPLE_S16LE) {
+            Napi::TypeError::New(env, "encode needs f32le or s16le samples").ThrowAsJavaScriptException();
             return env.Null();
         }
         
-        pa_threaded_mainloop_lock(mainloop);
+        uint32_t fragmentFrames = static_cast<uint32_t>(outputSpec.rate * fragmentUsec / 1000000);
+        uint32_t deliveredFrames = blockFrames > 0 ? blockFrames : fragmentFrames;
+        size_t maxQueuedBlocks = std::max<size_t>(2, bufferFrames / std::max<uint32_t>(1, deliveredFrames));
+        
+        stats = std::make_shared<CaptureStats>();
+        streamFrame = 0;
+        anchorFrame = 0;
+        anchorNanos = CaptureStats::MonotonicNanos();
+        expectedNanos = 0;
+        timingValid = false;
+        pendingGapFrames = 0;
+        nextSequence = 0;
+        pendingDrops = 0;
+        converter.reset();
+        if (!pa_sample_spec_equal(&sampleSpec, &outputSpec)) {
+            converter.reset(new AudioConverter(SampleTypeFor(sampleSpec.format), sampleSpec.rate, sampleSpec.channels,
+                outputSpec.rate, outputSpec.channels, resamplerQuality));
+        }
         
-        context = pa_context_new(pa_threaded_mainloop_get_api(mainloop), "Angela AI Audio Capture");
-        if (!context) {
-            pa_threaded_mainloop_unlock(mainloop);
-            Cleanup();
-            Napi::Error::New(env, "Failed to create context").ThrowAsJavaScriptException();
-            return env.Null();
+        envelope.reset();
+        if (envelopeEnabled) {
+            envelope.reset(new EnvelopeFollower(outputSpec.rate, outputSpec.channels,
+                SampleTypeFor(outputSpec.format), envelopeRate, envelopeBands));
         }
         
-        pa_context_set_state_callback(context, ContextStateCallback, this);
+        features.reset();
+        if (featuresEnabled) {
+            featureConfig.sampleRate = outputSpec.rate;
+            features.reset(new FeatureExtractor(outputSpec.channels, SampleTypeFor(outputSpec.format), featureConfig));
+        }
         
-        if (pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
-            pa_threaded_mainloop_unlock(mainloop);
-            Cleanup();
-            Napi::Error::New(env, "Failed to connect context").ThrowAsJavaScriptException();
-            return env.Null();
+        vad.reset();
+        vadPreroll.reset();
+        if (vadEnabled) {
+            vad.reset(new VoiceActivityDetector(outputSpec.rate, outputSpec.channels,
+                SampleTypeFor(outputSpec.format), vadConfig));
+            size_t prerollBytes = static_cast<size_t>(vad->MaxBackdateFrames()) * frameSize;
+            vadPreroll.reset(new SpscRingBuffer<uint8_t>(prerollBytes, OverflowPolicy::DropOldest));
+            vadScratch.assign(prerollBytes, 0);
         }
         
-        while (true) {
-            pa_context_state_t state = pa_context_get_state(context);
-            if (state == PA_CONTEXT_READY) {
-                break;
+        encoder.reset();
+        if (encodeEnabled) {
+            encoderConfig.sampleRate = outputSpec.rate;
+            encoderConfig.channels = outputSpec.channels;
+            encoderConfig.floatInput = outputSpec.format == PA_SAMPLE_FLOAT32LE;
+            std::string error;
+            encoder = OpusEncoderStage::Create(encoderConfig, [this](EncodedPacket* packet) { DispatchPacket(packet); }, &error);
+            if (!encoder) {
+                Napi::Error::New(env, error).ThrowAsJavaScriptException();
+                return env.Null();
             }
-            if (!PA_CONTEXT_IS_GOOD(state)) {
-                pa_threaded_mainloop_unlock(mainloop);
-                Cleanup();
-                Napi::Error::New(env, "Context connection failed").ThrowAsJavaScriptException();
+        }
+        
+        // Readers attach as soon as the segment exists, so it must not
+        // outlive a rejected start().
+        if (!sharedMemoryName.empty()) {
+            std::string error;
+            sharedRing = SharedMemoryRing::Create(sharedMemoryName, sharedMemoryFrames, outputSpec.rate,
+                outputSpec.channels, static_cast<uint32_t>(SampleTypeFor(outputSpec.format)), frameSize, &error);
+            if (!sharedRing) {
+                encoder.reset();
+                Napi::Error::New(env, error).ThrowAsJavaScriptException();
                 return env.Null();
             }
-            pa_threaded_mainloop_wait(mainloop);
         }
         
-        stream = pa_stream_new(context, "Angela Audio Capture", &sampleSpec, &channelMap);
-        if (!stream) {
-            pa_threaded_mainloop_unlock(mainloop);
-            Cleanup();
-            Napi::Error::New(env, "Failed to create stream").ThrowAsJavaScriptException();
-            return env.Null();
+        // Last of the steps that can fail: replacing the file discards the
+        // archived audio, so it waits until nothing else can reject start().
+        if (archivePath.empty()) {
+            archive.reset();
+        } else {
+            // A second of slack keeps readers clear of the slots being written.
+            size_t archiveFrames = static_cast<size_t>(std::ceil(archiveSeconds * outputSpec.rate)) + outputSpec.rate;
+            uint32_t sampleType = static_cast<uint32_t>(SampleTypeFor(outputSpec.format));
+            if (!archive || !archive->Matches(archivePath, archiveFrames, outputSpec.rate, outputSpec.channels, sampleType)) {
+                // Release the file lock before reopening the same path;
+                // readRange() views hold only the mapping.
+                archive.reset();
+                std::string error;
+                archive = RollingArchive::Open(archivePath, archiveFrames, outputSpec.rate, outputSpec.channels,
+                    sampleType, frameSize, &error);
+                if (!archive) {
+                    sharedRing.reset();
+                    encoder.reset();
+                    Napi::Error::New(env, error).ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+            }
+            archiveSpec = outputSpec;
         }
         
-        pa_stream_set_state_callback(stream, StreamStateCallback, this);
-        pa_stream_set_read_callback(stream, StreamReadCallback, this);
+        ring.reset();
+        readThreshold = 0;
+        if (callback.IsEmpty()) {
+            ring.reset(new SpscRingBuffer<uint8_t>(static_cast<size_t>(bufferFrames) * frameSize, overflowPolicy));
+            ringSpec = outputSpec;
+        }
+        
+        shouldStop = false;
+        
+        // Created before the stream connects so the read callback never
+        // observes a half-initialised TSFN. The queue is bounded to the same
+        // duration as the pull buffer; blocks beyond it are dropped.
+        if (!callback.IsEmpty()) {
+            tsfn = Napi::ThreadSafeFunction::New(
+                env, callback, "PulseAudioCaptureCallback", maxQueuedBlocks, 1
+            );
+        }
         
-        pa_buffer_attr bufferAttr;
-        bufferAttr.maxlength = (uint32_t)-1;
-        bufferAttr.tlength = (uint32_t)-1;
-        bufferAttr.prebuf = (uint32_t)-1;
-        bufferAttr.minreq = (uint32_t)-1;
-        bufferAttr.fragsize = pa_usec_to_bytes(20000, &sampleSpec);
+        if (options.Has("onEvent") && options.Get("onEvent").IsFunction()) {
+            eventTsfn = Napi::ThreadSafeFunction::New(
+                env, options.Get("onEvent").As<Napi::Function>(), "PulseAudioCaptureEvent", 0, 1
+            );
+        }
         
-        const char* monitorName = deviceId.empty() ? NULL : deviceId.c_str();
+        // The previous capture's history stays readable until the stream
+        // has connected; StartWorker::OnOK swaps this one in.
+        startingHistory.reset();
+        if (historySeconds > 0) {
+            size_t historyFrames = static_cast<size_t>(std::ceil(historySeconds * outputSpec.rate));
+            startingHistory.reset(new HistoryBuffer(outputSpec.rate, historyFrames, frameSize));
+        }
+        liveHistory = startingHistory.get();
+        
+        isStarting = true;
+        stopRequested = false;
+        Ref();
+        StartWorker* worker = new StartWorker(env, this, deviceId);
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+
+    // Runs Connect() off the JS thread and settles the promise returned by
+    // start() with the negotiated format. The wrapper is Ref()'d by Start()
+    // so it cannot be collected while the worker holds a pointer to it.
+    class StartWorker : public Napi::AsyncWorker {
+    public:
+        StartWorker(Napi::Env env, PulseAudioCapture* capture, const std::string& deviceId)
+            : Napi::AsyncWorker(env, "PulseAudioCaptureStart"), capture(capture), deviceId(deviceId),
+              deferred(Napi::Promise::Deferred::New(env)) {
+        }
         
-        if (pa_stream_connect_record(stream, monitorName, &bufferAttr, PA_STREAM_ADJUST_LATENCY) < 0) {
-            pa_threaded_mainloop_unlock(mainloop);
-            Cleanup();
-            Napi::Error::New(env, "Failed to connect stream").ThrowAsJavaScriptException();
-            return env.Null();
+        Napi::Promise Promise() const {
+            return deferred.Promise();
+        }
+        
+    protected:
+        void Execute() override {
+            std::string error;
+            if (!capture->Connect(deviceId, &error)) {
+                SetError(error);
+            }
+        }
+        
+        void OnOK() override {
+            Napi::Env env = Env();
+            capture->isStarting = false;
+            capture->Unref();
+            
+            if (capture->stopRequested) {
+                capture->stopRequested = false;
+                capture->Cleanup();
+                capture->startingHistory.reset();
+                deferred.Reject(Napi::Error::New(env, "Capture stopped while starting").Value());
+                capture->ResolveStopWaiters(env);
+                return;
+            }
+            
+            // The delivery thread keeps writing through liveHistory; only
+            // ownership moves here.
+            capture->history = std::move(capture->startingHistory);
+            capture->historySpec = capture->outputSpec;
+            capture->isCapturing = true;
+            deferred.Resolve(capture->FormatObject(env));
+        }
+        
+        void OnError(const Napi::Error& error) override {
+            capture->isStarting = false;
+            capture->stopRequested = false;
+            capture->Unref();
+            capture->Cleanup();
+            capture->startingHistory.reset();
+            deferred.Reject(error.Value());
+            capture->ResolveStopWaiters(Env());
+        }
+        
+    private:
+        PulseAudioCapture* capture;
+        std::string deviceId;
+        Napi::Promise::Deferred deferred;
+    };
+
+    // Opens the selected backend and waits until it delivers; for
+    // PulseAudio that is joining the shared connection and connecting the
+    // record stream. Runs on a worker thread (StartWorker); on failure the
+    // caller runs Cleanup() on the JS thread.
+    bool Connect(const std::string& deviceId, std::string* error) {
+        if (useFakeBackend) {
+            backend.reset(new FakeCaptureBackend(fakeConfig));
+        } else {
+            backend.reset(new PulseCaptureBackend(pulseConfig));
+        }
+        
+        CaptureBackendCallbacks callbacks;
+        callbacks.fragment = [this](const CaptureFragment& fragment) { OnFragment(fragment); };
+        callbacks.overflow = [this]() { stats->overflows.fetch_add(1, std::memory_order_relaxed); };
+        callbacks.underflow = [this]() { stats->underflows.fetch_add(1, std::memory_order_relaxed); };
+        callbacks.ended = [this]() { OnEnded(); };
+        if (!backend->Open(deviceId, &sampleSpec, channelMap, fragmentUsec, std::move(callbacks), error)) {
+            return false;
+        }
+        
+        if (!converter) {
+            outputSpec = sampleSpec;
+            frameSize = pa_frame_size(&outputSpec);
+        }
+        
+        return true;
+    }
+
+    bool ParseStartOptions(Napi::Env env, Napi::Object options) {
+        sampleSpec.format = PA_SAMPLE_FLOAT32LE;
+        if (options.Has("format") && options.Get("format").IsString()) {
+            if (!ParseSampleFormat(options.Get("format").As<Napi::String>().Utf8Value(), &sampleSpec.format)) {
+                Napi::TypeError::New(env, "format must be 'f32le', 's16le' or 's32le'").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        sampleSpec.rate = kDefaultRate;
+        if (options.Has("rate") && options.Get("rate").IsNumber()) {
+            sampleSpec.rate = options.Get("rate").As<Napi::Number>().Uint32Value();
+        }
+        
+        sampleSpec.channels = kDefaultChannels;
+        if (options.Has("channels") && options.Get("channels").IsNumber()) {
+            sampleSpec.channels = static_cast<uint8_t>(options.Get("channels").As<Napi::Number>().Uint32Value());
+        }
+        
+        if (!pa_sample_spec_valid(&sampleSpec)) {
+            Napi::RangeError::New(env, "Invalid sample spec (rate/channels)").ThrowAsJavaScriptException();
+            return false;
+        }
+        
+        if (sampleSpec.channels == 1) {
+            pa_channel_map_init_mono(&channelMap);
+        } else if (sampleSpec.channels == 2) {
+            pa_channel_map_init_stereo(&channelMap);
+        } else {
+            pa_channel_map_init_extend(&channelMap, sampleSpec.channels, PA_CHANNEL_MAP_DEFAULT);
         }
         
-        while (true) {
-            pa_stream_state_t state = pa_stream_get_state(stream);
-            if (state == PA_STREAM_READY) {
-                break;
+        outputSpec = sampleSpec;
+        resamplerQuality = kDefaultResamplerQuality;
+        if (options.Has("convert") && options.Get("convert").IsObject()) {
+            Napi::Object convert = options.Get("convert").As<Napi::Object>();
+            outputSpec.format = PA_SAMPLE_FLOAT32LE;
+            if (convert.Has("rate") && convert.Get("rate").IsNumber()) {
+                outputSpec.rate = convert.Get("rate").As<Napi::Number>().Uint32Value();
             }
-            if (!PA_STREAM_IS_GOOD(state)) {
-                pa_threaded_mainloop_unlock(mainloop);
-                Cleanup();
-                Napi::Error::New(env, "Stream connection failed").ThrowAsJavaScriptException();
+            if (convert.Has("channels") && convert.Get("channels").IsNumber()) {
+                outputSpec.channels = static_cast<uint8_t>(convert.Get("channels").As<Napi::Number>().Uint32Value());
+            }
+            if (convert.Has("quality") && convert.Get("quality").IsNumber()) {
+                resamplerQuality = std::max<uint32_t>(2, convert.Get("quality").As<Napi::Number>().Uint32Value());
+            }
+            
+            if (!pa_sample_spec_valid(&outputSpec)
+                || !AudioConverter::SupportsChannels(sampleSpec.channels, outputSpec.channels)) {
+                Napi::RangeError::New(env, "convert supports a positive rate and channels equal to the stream or 1").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        frameSize = pa_frame_size(&outputSpec);
+        
+        deliveryMode = DeliveryMode::TypedArray;
+        if (options.Has("delivery") && options.Get("delivery").IsString()) {
+            std::string delivery = options.Get("delivery").As<Napi::String>().Utf8Value();
+            if (delivery == "array") {
+                deliveryMode = DeliveryMode::Array;
+            } else if (delivery != "typedarray" && delivery != "float32array") {
+                Napi::TypeError::New(env, "delivery must be 'typedarray' or 'array'").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        overflowPolicy = OverflowPolicy::DropOldest;
+        if (options.Has("overflow") && options.Get("overflow").IsString()) {
+            std::string overflow = options.Get("overflow").As<Napi::String>().Utf8Value();
+            if (overflow == "drop-newest") {
+                overflowPolicy = OverflowPolicy::DropNewest;
+            } else if (overflow != "drop-oldest") {
+                Napi::TypeError::New(env, "overflow must be 'drop-oldest' or 'drop-newest'").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        bufferFrames = outputSpec.rate * kDefaultBufferMs / 1000;
+        if (options.Has("bufferFrames") && options.Get("bufferFrames").IsNumber()) {
+            int64_t frames = options.Get("bufferFrames").As<Napi::Number>().Int64Value();
+            if (frames <= 0) {
+                Napi::RangeError::New(env, "bufferFrames must be positive").ThrowAsJavaScriptException();
+                return false;
+            }
+            bufferFrames = static_cast<uint32_t>(frames);
+        }
+        
+        fragmentUsec = kDefaultFragmentUsec;
+        if (options.Has("fragmentMs") && options.Get("fragmentMs").IsNumber()) {
+            double ms = options.Get("fragmentMs").As<Napi::Number>().DoubleValue();
+            if (!(ms > 0)) {
+                Napi::RangeError::New(env, "fragmentMs must be positive").ThrowAsJavaScriptException();
+                return false;
+            }
+            fragmentUsec = static_cast<pa_usec_t>(ms * 1000);
+        }
+        
+        pulseConfig = PulseBackendConfig();
+        if (options.Has("adjustLatency") && options.Get("adjustLatency").IsBoolean()) {
+            pulseConfig.adjustLatency = options.Get("adjustLatency").As<Napi::Boolean>().Value();
+        }
+        
+        blockFrames = 0;
+        if (options.Has("blockFrames") && options.Get("blockFrames").IsNumber()) {
+            int64_t frames = options.Get("blockFrames").As<Napi::Number>().Int64Value();
+            if (frames <= 0) {
+                Napi::RangeError::New(env, "blockFrames must be positive").ThrowAsJavaScriptException();
+                return false;
+            }
+            blockFrames = static_cast<uint32_t>(frames);
+        } else if (options.Has("blockMs") && options.Get("blockMs").IsNumber()) {
+            double ms = options.Get("blockMs").As<Napi::Number>().DoubleValue();
+            if (!(ms > 0)) {
+                Napi::RangeError::New(env, "blockMs must be positive").ThrowAsJavaScriptException();
+                return false;
+            }
+            blockFrames = std::max<uint32_t>(1, static_cast<uint32_t>(outputSpec.rate * ms / 1000.0));
+        }
+        
+        sharedMemoryName.clear();
+        sharedMemoryFrames = bufferFrames;
+        if (options.Has("sharedMemory")) {
+            Napi::Value shared = options.Get("sharedMemory");
+            if (shared.IsString()) {
+                sharedMemoryName = shared.As<Napi::String>().Utf8Value();
+            } else if (shared.IsObject()) {
+                Napi::Object config = shared.As<Napi::Object>();
+                if (config.Has("name") && config.Get("name").IsString()) {
+                    sharedMemoryName = config.Get("name").As<Napi::String>().Utf8Value();
+                }
+                if (config.Has("bufferFrames") && config.Get("bufferFrames").IsNumber()) {
+                    int64_t frames = config.Get("bufferFrames").As<Napi::Number>().Int64Value();
+                    if (frames <= 0) {
+                        Napi::RangeError::New(env, "sharedMemory.bufferFrames must be positive").ThrowAsJavaScriptException();
+                        return false;
+                    }
+                    sharedMemoryFrames = static_cast<uint32_t>(frames);
+                }
+            }
+            if (!shared.IsUndefined() && !shared.IsNull() && sharedMemoryName.empty()) {
+                Napi::TypeError::New(env, "sharedMemory needs a name").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        envelopeEnabled = false;
+        envelopeRate = kDefaultEnvelopeRate;
+        envelopeBands = false;
+        if (options.Has("envelope")) {
+            Napi::Value envelopeOption = options.Get("envelope");
+            if (envelopeOption.IsBoolean()) {
+                envelopeEnabled = envelopeOption.As<Napi::Boolean>().Value();
+            } else if (envelopeOption.IsObject()) {
+                Napi::Object config = envelopeOption.As<Napi::Object>();
+                envelopeEnabled = true;
+                if (config.Has("rate") && config.Get("rate").IsNumber()) {
+                    envelopeRate = config.Get("rate").As<Napi::Number>().DoubleValue();
+                }
+                if (config.Has("bands") && config.Get("bands").IsBoolean()) {
+                    envelopeBands = config.Get("bands").As<Napi::Boolean>().Value();
+                }
+            }
+            if (envelopeEnabled && !(envelopeRate > 0 && envelopeRate <= outputSpec.rate)) {
+                Napi::RangeError::New(env, "envelope rate must be positive and at most the sample rate").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        historySeconds = 0;
+        if (options.Has("history") && !options.Get("history").IsUndefined()) {
+            Napi::Value historyOption = options.Get("history");
+            historySeconds = historyOption.IsNumber() ? historyOption.As<Napi::Number>().DoubleValue() : -1;
+            if (!(historySeconds > 0 && historySeconds <= kMaxHistorySeconds)) {
+                Napi::RangeError::New(env, "history must be a number of seconds in (0, 600]").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        archivePath.clear();
+        archiveSeconds = kDefaultArchiveSeconds;
+        if (options.Has("archive") && !options.Get("archive").IsUndefined() && !options.Get("archive").IsNull()) {
+            Napi::Value archiveOption = options.Get("archive");
+            if (archiveOption.IsString()) {
+                archivePath = archiveOption.As<Napi::String>().Utf8Value();
+            } else if (archiveOption.IsObject()) {
+                Napi::Object config = archiveOption.As<Napi::Object>();
+                if (config.Has("path") && config.Get("path").IsString()) {
+                    archivePath = config.Get("path").As<Napi::String>().Utf8Value();
+                }
+                if (config.Has("minutes") && config.Get("minutes").IsNumber()) {
+                    archiveSeconds = config.Get("minutes").As<Napi::Number>().DoubleValue() * 60.0;
+                }
+                if (config.Has("seconds") && config.Get("seconds").IsNumber()) {
+                    archiveSeconds = config.Get("seconds").As<Napi::Number>().DoubleValue();
+                }
+            }
+            if (archivePath.empty()) {
+                Napi::TypeError::New(env, "archive needs a file path").ThrowAsJavaScriptException();
+                return false;
+            }
+            if (!(archiveSeconds > 0 && archiveSeconds <= kMaxArchiveSeconds)) {
+                Napi::RangeError::New(env, "archive length must be positive and at most 6 hours").ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        
+        useFakeBackend = false;
+        fakeConfig = FakeBackendConfig();
+        if (options.Has("backend") && !options.Get("backend").IsUndefined()) {
+            Napi::Value backendOption = options.Get("backend");
+            std::string type = backendOption.IsString() ? backendOption.As<Napi::String>().Utf8Value() : "";
+            Napi::Object config = backendOption.IsObject() ? backendOption.As<Napi::Object>() : Napi::Object::New(env);
+            if (backendOption.IsObject() && config.Has("type") && config.Get("type").IsString()) {
+                type = config.Get("type").As<Napi::String>().Utf8Value();
+            }
+            if (type == "fake") {
+                useFakeBackend = true;
+            } else if (type != "pulse") {
+                Napi::TypeError::New(env, "backend must be 'pulse' or 'fake'").ThrowAsJavaScriptException();
+                return false;
+            }
+            
+            if (config.Has("path") && config.Get("path").IsString()) {
+                fakeConfig.source = FakeSource::File;
+                fakeConfig.path = config.Get("path").As<Napi::String>().Utf8Value();
+            }
+            if (config.Has("source") && config.Get("source").IsString()) {
+                std::string source = config.Get("source").As<Napi::String>().Utf8Value();
+                if (source == "sine") {
+                    fakeConfig.source = FakeSource::Sine;
+                } else if (source == "noise") {
+                    fakeConfig.source = FakeSource::Noise;
+                } else if (source == "silence") {
+                    fakeConfig.source = FakeSource::Silence;
+                } else if (source == "file") {
+                    fakeConfig.source = FakeSource::File;
+                } else {
+                    Napi::TypeError::New(env, "backend.source must be 'sine', 'noise', 'silence' or 'file'")
+                        .ThrowAsJavaScriptException();
+                    return false;
+                }
+            }
+            if (fakeConfig.source == FakeSource::File && fakeConfig.path.empty()) {
+                Napi::TypeError::New(env, "backend.source 'file' needs a path").ThrowAsJavaScriptException();
+                return false;
+            }
+            if (config.Has("frequency") && config.Get("frequency").IsNumber()) {
+                fakeConfig.frequency = config.Get("frequency").As<Napi::Number>().DoubleValue();
+            }
+            if (config.Has("amplitude") && config.Get("amplitude").IsNumber()) {
+                fakeConfig.amplitude = config.Get("amplitude").As<Napi::Number>().DoubleValue();
+            }
+            if (config.Has("realtime") && config.Get("realtime").IsBoolean()) {
+                fakeConfig.realtime = config.Get("realtime").As<Napi::Boolean>().Value();
+            }
+            if (config.Has("loop") && config.Get("loop").IsBoolean()) {
+                fakeConfig.loop = config.Get("loop").As<Napi::Boolean>().Value();
+            }
+            if (config.Has("duration") && config.Get("duration").IsNumber()) {
+                fakeConfig.duration = config.Get("duration").As<Napi::Number>().DoubleValue();
+                if (!(fakeConfig.duration >= 0)) {
+                    Napi::RangeError::New(env, "backend.duration must not be negative").ThrowAsJavaScriptException();
+                    return false;
+                }
+            }
+            if (config.Has("gap") && config.Get("gap").IsObject()) {
+                Napi::Object gap = config.Get("gap").As<Napi::Object>();
+                if (gap.Has("at") && gap.Get("at").IsNumber()) {
+                    fakeConfig.gapAt = gap.Get("at").As<Napi::Number>().DoubleValue();
+                }
+                if (gap.Has("seconds") && gap.Get("seconds").IsNumber()) {
+                    fakeConfig.gapSeconds = gap.Get("seconds").As<Napi::Number>().DoubleValue();
+                }
+                if (!(fakeConfig.gapAt >= 0 && fakeConfig.gapSeconds >= 0)) {
+                    Napi::RangeError::New(env, "backend.gap times must not be negative").ThrowAsJavaScriptException();
+                    return false;
+                }
+            }
+        }
+        
+        encodeEnabled = false;
+        encoderConfig = OpusEncoderConfig();
+        if (options.Has("encode")) {
+            Napi::Value encodeOption = options.Get("encode");
+            if (encodeOption.IsString()) {
+                std::string codec = encodeOption.As<Napi::String>().Utf8Value();
+                if (codec != "opus") {
+                    Napi::TypeError::New(env, "Unsupported codec: " + codec).ThrowAsJavaScriptException();
+                    return false;
+                }
+                encodeEnabled = true;
+            } else if (encodeOption.IsObject()) {
+                Napi::Object config = encodeOption.As<Napi::Object>();
+                encodeEnabled = true;
+                if (config.Has("codec") && config.Get("codec").IsString()
+                    && config.Get("codec").As<Napi::String>().Utf8Value() != "opus") {
+                    Napi::TypeError::New(env, "Unsupported codec: " + config.Get("codec").As<Napi::String>().Utf8Value())
+                        .ThrowAsJavaScriptException();
+                    return false;
+                }
+                if (config.Has("bitrate") && config.Get("bitrate").IsNumber()) {
+                    encoderConfig.bitrate = config.Get("bitrate").As<Napi::Number>().Int32Value();
+                }
+                if (config.Has("frameMs") && config.Get("frameMs").IsNumber()) {
+                    encoderConfig.frameMs = config.Get("frameMs").As<Napi::Number>().DoubleValue();
+                }
+                if (config.Has("complexity") && config.Get("complexity").IsNumber()) {
+                    encoderConfig.complexity = config.Get("complexity").As<Napi::Number>().Int32Value();
+                }
+                if (config.Has("application") && config.Get("application").IsString()) {
+                    std::string application = config.Get("application").As<Napi::String>().Utf8Value();
+                    if (application == "voip") {
+                        encoderConfig.application = OpusApplication::Voip;
+                    } else if (application == "audio") {
+                        encoderConfig.application = OpusApplication::Audio;
+                    } else if (application == "lowdelay") {
+                        encoderConfig.application = OpusApplication::LowDelay;
+                    } else {
+                        Napi::TypeError::New(env, "encode.application must be 'voip', 'audio' or 'lowdelay'")
+                            .ThrowAsJavaScriptException();
+                        return false;
+                    }
+                }
+            } else if (encodeOption.IsBoolean()) {
+                encodeEnabled = encodeOption.As<Napi::Boolean>().Value();
+            }
+        }
+        
+        featuresEnabled = false;
+        featureConfig = FeatureConfig();
+        if (options.Has("features")) {
+            Napi::Value featuresOption = options.Get("features");
+            if (featuresOption.IsBoolean()) {
+                featuresEnabled = featuresOption.As<Napi::Boolean>().Value();
+            } else if (featuresOption.IsObject()) {
+                featuresEnabled = true;
+                if (!ParseFeatureConfig(env, featuresOption.As<Napi::Object>(), &featureConfig)) {
+                    return false;
+                }
+            }
+        }
+        
+        vadEnabled = false;
+        vadConfig = VadConfig();
+        if (options.Has("vad")) {
+            Napi::Value vadOption = options.Get("vad");
+            if (vadOption.IsBoolean()) {
+                vadEnabled = vadOption.As<Napi::Boolean>().Value();
+            } else if (vadOption.IsObject()) {
+                Napi::Object config = vadOption.As<Napi::Object>();
+                vadEnabled = true;
+                if (config.Has("thresholdDb") && config.Get("thresholdDb").IsNumber()) {
+                    vadConfig.thresholdDb = config.Get("thresholdDb").As<Napi::Number>().FloatValue();
+                }
+                if (config.Has("minEnergyDb") && config.Get("minEnergyDb").IsNumber()) {
+                    vadConfig.minEnergyDb = config.Get("minEnergyDb").As<Napi::Number>().FloatValue();
+                }
+                if (config.Has("maxFlatness") && config.Get("maxFlatness").IsNumber()) {
+                    vadConfig.maxFlatness = config.Get("maxFlatness").As<Napi::Number>().FloatValue();
+                }
+                if (config.Has("maxZeroCrossingRate") && config.Get("maxZeroCrossingRate").IsNumber()) {
+                    vadConfig.maxZeroCrossingRate = config.Get("maxZeroCrossingRate").As<Napi::Number>().FloatValue();
+                }
+                if (config.Has("frameMs") && config.Get("frameMs").IsNumber()) {
+                    vadConfig.frameMs = std::max<uint32_t>(5, config.Get("frameMs").As<Napi::Number>().Uint32Value());
+                }
+                if (config.Has("attackMs") && config.Get("attackMs").IsNumber()) {
+                    vadConfig.attackMs = config.Get("attackMs").As<Napi::Number>().Uint32Value();
+                }
+                if (config.Has("hangoverMs") && config.Get("hangoverMs").IsNumber()) {
+                    vadConfig.hangoverMs = config.Get("hangoverMs").As<Napi::Number>().Uint32Value();
+                }
+            }
+        }
+        
+        return true;
+    }
+
+    Napi::Value Read(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        
+        if (!ring) {
+            Napi::Error::New(env, "read() requires start() without a callback").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        size_t ringFrameSize = pa_frame_size(&ringSpec);
+        size_t frames = ring->Available() / ringFrameSize;
+        if (info.Length() >= 1 && info[0].IsNumber()) {
+            int64_t requested = info[0].As<Napi::Number>().Int64Value();
+            frames = std::min(frames, static_cast<size_t>(std::max<int64_t>(0, requested)));
+        }
+        
+        // DropOldest may discard frames between Available() and Read(), so
+        // the view is sized by what was actually copied.
+        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, frames * ringFrameSize);
+        size_t copied = ring->Read(static_cast<uint8_t*>(buffer.Data()), frames * ringFrameSize);
+        return SampleArray(env, buffer, ringSpec.format, copied / pa_sample_size(&ringSpec));
+    }
+
+    // snapshot(seconds?): copies the newest `seconds` of history (all of it
+    // if omitted) in one step and returns { samples, frame, timestamp }.
+    // Works during capture and after stop() until the next start().
+    Napi::Value Snapshot(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        
+        if (!history) {
+            Napi::Error::New(env, "snapshot() requires start() with the history option").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        size_t frames = history->Held();
+        if (info.Length() >= 1 && info[0].IsNumber()) {
+            double seconds = info[0].As<Napi::Number>().DoubleValue();
+            if (!(seconds >= 0)) {
+                Napi::RangeError::New(env, "seconds must not be negative").ThrowAsJavaScriptException();
                 return env.Null();
             }
-            pa_threaded_mainloop_wait(mainloop);
+            frames = std::min(frames, static_cast<size_t>(std::min(seconds * historySpec.rate,
+                static_cast<double>(history->CapacityFrames()))));
         }
         
-        pa_threaded_mainloop_unlock(mainloop);
+        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, frames * pa_frame_size(&historySpec));
+        uint64_t firstFrame = 0;
+        int64_t firstNanos = 0;
+        size_t copied = history->Snapshot(frames, static_cast<uint8_t*>(buffer.Data()), &firstFrame, &firstNanos);
+        Napi::Value samples = SampleArray(env, buffer, historySpec.format, copied * historySpec.channels);
+        if (samples.IsNull()) {
+            return env.Null();
+        }
         
-        isCapturing = true;
-        shouldStop = false;
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("samples", samples);
+        result.Set("frame", static_cast<double>(firstFrame));
+        result.Set("timestamp", static_cast<double>(firstNanos) / 1e6);
+        return result;
+    }
+
+    // A typed array over part of the archive mapping. The buffer keeps the
+    // mapping alive, but not the archive's file lock; under the V8 sandbox
+    // the span is copied instead.
+    static Napi::Value ArchiveView(Napi::Env env, const std::shared_ptr<ArchiveMapping>& mapping,
+        const uint8_t* span, size_t bytes, pa_sample_format_t format) {
+        napi_value arrayBuffer;
+        std::shared_ptr<ArchiveMapping>* keepAlive = new std::shared_ptr<ArchiveMapping>(mapping);
+        napi_status status = napi_create_external_arraybuffer(
+            env, const_cast<uint8_t*>(span), bytes,
+            [](napi_env, void*, void* hint) { delete static_cast<std::shared_ptr<ArchiveMapping>*>(hint); },
+            keepAlive, &arrayBuffer
+        );
         
-        if (!callback.IsEmpty()) {
-            tsfn = Napi::ThreadSafeFunction::New(
-                env, callback, "PulseAudioCaptureCallback", 0, 1
-            );
+        if (status != napi_ok) {
+            delete keepAlive;
+            Napi::ArrayBuffer copied = Napi::ArrayBuffer::New(env, bytes);
+            std::memcpy(copied.Data(), span, bytes);
+            arrayBuffer = copied;
         }
         
-        return Napi::Boolean::New(env, true);
+        return SampleArray(env, arrayBuffer, format, bytes / pa_sample_size_of_format(format));
     }
 
-    Napi::Value Stop(const Napi::CallbackInfo& info) {
+    // readRange(startMs, endMs): the archived audio between two
+    // CLOCK_MONOTONIC times (ms, as in block info), clamped to what the
+    // archive holds. Returns { chunks, frame, timestamp, frames } with one
+    // chunk, or two where the range wraps, or null if nothing overlaps.
+    Napi::Value ReadRange(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         
-        if (!isCapturing) {
-            return Napi::Boolean::New(env, true);
+        if (!archive) {
+            Napi::Error::New(env, "readRange() requires start() with the archive option").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "readRange() needs start and end times in ms").ThrowAsJavaScriptException();
+            return env.Null();
         }
         
-        Cleanup();
-        isCapturing = false;
+        int64_t startNanos = static_cast<int64_t>(info[0].As<Napi::Number>().DoubleValue() * 1e6);
+        int64_t endNanos = static_cast<int64_t>(info[1].As<Napi::Number>().DoubleValue() * 1e6);
+        ArchiveRange range;
+        if (!archive->Range(startNanos, endNanos, &range)) {
+            return env.Null();
+        }
+        
+        Napi::Array chunks = Napi::Array::New(env);
+        for (size_t i = 0; i < 2; i++) {
+            if (range.spanBytes[i] > 0) {
+                Napi::Value view = ArchiveView(env, archive->Mapping(), range.spans[i], range.spanBytes[i], archiveSpec.format);
+                if (view.IsNull()) {
+                    return env.Null();
+                }
+                chunks.Set(chunks.Length(), view);
+            }
+        }
         
-        return Napi::Boolean::New(env, true);
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("chunks", chunks);
+        result.Set("frame", static_cast<double>(range.frame));
+        result.Set("timestamp", static_cast<double>(range.nanos) / 1e6);
+        result.Set("frames", static_cast<double>(range.frames));
+        // Checked against the mapping the chunks view, which may outlive
+        // this archive.
+        std::shared_ptr<ArchiveMapping> mapping = archive->Mapping();
+        uint64_t frame = range.frame;
+        result.Set("valid", Napi::Function::New(env, [mapping, frame](const Napi::CallbackInfo& info) -> Napi::Value {
+            return Napi::Boolean::New(info.Env(), RollingArchive::Holds(*mapping, frame));
+        }, "valid"));
+        return result;
     }
 
-    Napi::Value GetFormat(const Napi::CallbackInfo& info) {
+    Napi::Value Available(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        size_t frames = ring ? ring->Available() / pa_frame_size(&ringSpec) : 0;
+        return Napi::Number::New(env, static_cast<double>(frames));
+    }
+
+    // notifyWhenAvailable(frames): returns true if `frames` can be read now.
+    // Otherwise arms a one-shot 'readable' event for when they can, and
+    // returns false. Requests larger than the ring can never be met.
+    Napi::Value NotifyWhenAvailable(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         
-        Napi::Object formatObj = Napi::Object::New(env);
-        formatObj.Set("sampleRate", sampleSpec.rate);
-        formatObj.Set("channels", sampleSpec.channels);
-        formatObj.Set("format", static_cast<int>(sampleSpec.format));
-        formatObj.Set("sampleFormat", "float32");
+        if (!ring) {
+            Napi::Error::New(env, "notifyWhenAvailable() requires start() without a callback").ThrowAsJavaScriptException();
+            return env.Null();
+        }
         
-        return formatObj;
+        size_t frames = 1;
+        if (info.Length() >= 1 && info[0].IsNumber()) {
+            frames = static_cast<size_t>(std::max<int64_t>(1, info[0].As<Napi::Number>().Int64Value()));
+        }
+        size_t ringFrameSize = pa_frame_size(&ringSpec);
+        if (frames * ringFrameSize > ring->Capacity()) {
+            Napi::RangeError::New(env, "Requested frames exceed bufferFrames").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        size_t threshold = frames * ringFrameSize;
+        
+        // Arm before checking so a write racing with the check either sees
+        // the threshold or is seen by it; whoever disarms it reports.
+        readThreshold.store(threshold, std::memory_order_release);
+        if (ring->Available() >= threshold
+            && readThreshold.compare_exchange_strong(threshold, 0, std::memory_order_acq_rel)) {
+            return Napi::Boolean::New(env, true);
+        }
+        return Napi::Boolean::New(env, false);
     }
 
-    static Napi::Value GetDevices(const Napi::CallbackInfo& info) {
+    static Napi::Object HistogramToObject(Napi::Env env, const DurationHistogram& histogram) {
+        Napi::Object obj = Napi::Object::New(env);
+        Napi::Array buckets = Napi::Array::New(env);
+        for (size_t i = 0; i < DurationHistogram::kBuckets; i++) {
+            uint64_t count = histogram.Count(i);
+            if (count == 0) {
+                continue;
+            }
+            Napi::Object bucket = Napi::Object::New(env);
+            bucket.Set("ltUs", static_cast<double>(DurationHistogram::UpperBound(i)));
+            bucket.Set("count", static_cast<double>(count));
+            buckets.Set(buckets.Length(), bucket);
+        }
+        obj.Set("count", static_cast<double>(histogram.Total()));
+        obj.Set("p50Us", static_cast<double>(histogram.Quantile(0.5)));
+        obj.Set("p99Us", static_cast<double>(histogram.Quantile(0.99)));
+        obj.Set("maxUs", static_cast<double>(histogram.Max()));
+        obj.Set("buckets", buckets);
+        return obj;
+    }
+
+    Napi::Value GetStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        const CaptureStats& s = *stats;
+        
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("fragmentsRead", static_cast<double>(s.fragmentsRead.load(std::memory_order_relaxed)));
+        obj.Set("bytesRead", static_cast<double>(s.bytesRead.load(std::memory_order_relaxed)));
+        obj.Set("blocksDelivered", static_cast<double>(s.blocksDelivered.load(std::memory_order_relaxed)));
+        obj.Set("blocksDropped", static_cast<double>(s.blocksDropped.load(std::memory_order_relaxed)));
+        obj.Set("samplesDropped", static_cast<double>(ring ? ring->Dropped() / pa_sample_size(&outputSpec) : 0));
+        obj.Set("queueDepth", static_cast<double>(s.queueDepth.load(std::memory_order_relaxed)));
+        obj.Set("queueHighWater", static_cast<double>(s.queueHighWater.load(std::memory_order_relaxed)));
+        obj.Set("overflows", static_cast<double>(s.overflows.load(std::memory_order_relaxed)));
+        obj.Set("underflows", static_cast<double>(s.underflows.load(std::memory_order_relaxed)));
+        obj.Set("holes", static_cast<double>(s.holes.load(std::memory_order_relaxed)));
+        obj.Set("bytesGated", static_cast<double>(s.bytesGated.load(std::memory_order_relaxed)));
+        obj.Set("gaps", static_cast<double>(s.gaps.load(std::memory_order_relaxed)));
+        obj.Set("framesLost", static_cast<double>(s.framesLost.load(std::memory_order_relaxed)));
+        obj.Set("callbackDuration", HistogramToObject(env, s.callbackDuration));
+        obj.Set("deliveryLatency", HistogramToObject(env, s.deliveryLatency));
+        if (encoder) {
+            Napi::Object encoderObj = Napi::Object::New(env);
+            encoderObj.Set("packets", static_cast<double>(encoder->packetsEncoded.load(std::memory_order_relaxed)));
+            encoderObj.Set("bytes", static_cast<double>(encoder->bytesEncoded.load(std::memory_order_relaxed)));
+            encoderObj.Set("framesDropped", static_cast<double>(encoder->framesDropped.load(std::memory_order_relaxed)));
+            obj.Set("encoder", encoderObj);
+        } else {
+            obj.Set("encoder", env.Null());
+        }
+        if (recorder) {
+            Napi::Object recordingObj = Napi::Object::New(env);
+            recordingObj.Set("path", recorder->Config().path);
+            recordingObj.Set("frames", static_cast<double>(recorder->FramesWritten()));
+            recordingObj.Set("framesDropped", static_cast<double>(recorder->FramesDropped()));
+            recordingObj.Set("ioUring", recorder->UsingIoUring());
+            obj.Set("recording", recordingObj);
+        } else {
+            obj.Set("recording", env.Null());
+        }
+        return obj;
+    }
+
+    // Resolves once the capture is torn down: at once, or after a pending
+    // start(), pause() or resume() has finished with it.
+    Napi::Value Stop(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
         
-        Napi::Array devices = Napi::Array::New(env);
+        if (isStarting || isCorking) {
+            stopRequested = true;
+            stopWaiters.push_back(deferred);
+            return deferred.Promise();
+        }
         
-        pa_threaded_mainloop* mainloop = pa_threaded_mainloop_new();
-        if (!mainloop) {
-            return devices;
+        if (isCapturing) {
+            Cleanup();
+            isCapturing = false;
+            isPaused = false;
         }
         
-        if (pa_threaded_mainloop_start(mainloop) < 0) {
-            pa_threaded_mainloop_free(mainloop);
-            return devices;
+        deferred.Resolve(Napi::Boolean::New(env, true));
+        return deferred.Promise();
+    }
+
+    void ResolveStopWaiters(Napi::Env env) {
+        for (Napi::Promise::Deferred& waiter : stopWaiters) {
+            waiter.Resolve(Napi::Boolean::New(env, true));
+        }
+        stopWaiters.clear();
+    }
+
+    Napi::Value Pause(const Napi::CallbackInfo& info) {
+        return QueueCork(info.Env(), true);
+    }
+
+    Napi::Value Resume(const Napi::CallbackInfo& info) {
+        return QueueCork(info.Env(), false);
+    }
+
+    Napi::Value QueueCork(Napi::Env env, bool pause) {
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        if (!isCapturing) {
+            deferred.Reject(Napi::Error::New(env, "Not capturing").Value());
+            return deferred.Promise();
+        }
+        if (isCorking) {
+            deferred.Reject(Napi::Error::New(env, "pause() or resume() already in progress").Value());
+            return deferred.Promise();
+        }
+        if (isPaused == pause) {
+            deferred.Resolve(env.Undefined());
+            return deferred.Promise();
+        }
+        
+        isCorking = true;
+        stopRequested = false;
+        Ref();
+        CorkWorker* worker = new CorkWorker(env, this, pause);
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+    // Settles pause()/resume() once the server acknowledged the cork. A
+    // stop() that arrived meanwhile is carried out here.
+    class CorkWorker : public Napi::AsyncWorker {
+    public:
+        CorkWorker(Napi::Env env, PulseAudioCapture* capture, bool pause)
+            : Napi::AsyncWorker(env, "PulseAudioCaptureCork"), capture(capture), pause(pause),
+              deferred(Napi::Promise::Deferred::New(env)) {
         }
         
-        pa_threaded_mainloop_lock(mainloop);
+        Napi::Promise Promise() const {
+            return deferred.Promise();
+        }
         
-        pa_context* context = pa_context_new(pa_threaded_mainloop_get_api(mainloop), "Angela Device List");
-        if (!context) {
-            pa_threaded_mainloop_unlock(mainloop);
-            pa_threaded_mainloop_free(mainloop);
-            return devices;
+    protected:
+        void Execute() override {
+            std::string error;
+            if (!capture->Cork(pause, &error)) {
+                SetError(error);
+            }
         }
         
-        if (pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
-            pa_context_unref(context);
-            pa_threaded_mainloop_unlock(mainloop);
-            pa_threaded_mainloop_free(mainloop);
-            return devices;
+        void OnOK() override {
+            if (!Finish()) {
+                capture->isPaused = pause;
+            }
+            deferred.Resolve(Env().Undefined());
         }
         
-        while (true) {
-            pa_context_state_t state = pa_context_get_state(context);
-            if (state == PA_CONTEXT_READY) break;
-            if (!PA_CONTEXT_IS_GOOD(state)) {
-                pa_context_disconnect(context);
-                pa_context_unref(context);
-                pa_threaded_mainloop_unlock(mainloop);
-                pa_threaded_mainloop_free(mainloop);
-                return devices;
+        void OnError(const Napi::Error& error) override {
+            if (Finish()) {
+                deferred.Resolve(Env().Undefined());
+            } else {
+                deferred.Reject(error.Value());
             }
-            pa_threaded_mainloop_wait(mainloop);
         }
         
-        pa_operation* op = pa_context_get_sink_info_list(context, 
-            [](pa_context* c, const pa_sink_info* i, int eol, void* userdata) {
-                if (eol > 0) {
-                    pa_threaded_mainloop_signal(static_cast<pa_threaded_mainloop*>(userdata), 0);
-                    return;
+    private:
+        // True if a pending stop() tore the capture down.
+        bool Finish() {
+            capture->isCorking = false;
+            capture->Unref();
+            if (!capture->stopRequested) {
+                return false;
+            }
+            capture->stopRequested = false;
+            capture->Cleanup();
+            capture->isCapturing = false;
+            capture->isPaused = false;
+            capture->ResolveStopWaiters(Env());
+            return true;
+        }
+        
+        PulseAudioCapture* capture;
+        bool pause;
+        Napi::Promise::Deferred deferred;
+    };
+
+    // startRecording(path, options?): streams the converted capture, ungated
+    // and with gaps as silence, to a WAV or raw file from a writer thread.
+    Napi::Value StartRecording(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        
+        if (!isCapturing) {
+            Napi::Error::New(env, "startRecording() requires a running capture").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (recorder) {
+            Napi::Error::New(env, "Already recording").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (info.Length() < 1 || !info[0].IsString()) {
+            Napi::TypeError::New(env, "startRecording() needs a file path").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        RecordingConfig config;
+        config.path = info[0].As<Napi::String>().Utf8Value();
+        config.sampleRate = outputSpec.rate;
+        config.channels = outputSpec.channels;
+        config.bytesPerSample = static_cast<uint32_t>(pa_sample_size(&outputSpec));
+        config.floatSamples = outputSpec.format == PA_SAMPLE_FLOAT32LE;
+        
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object options = info[1].As<Napi::Object>();
+            if (options.Has("format") && options.Get("format").IsString()) {
+                std::string format = options.Get("format").As<Napi::String>().Utf8Value();
+                if (format == "wav") {
+                    config.format = RecordingFormat::Wav;
+                } else if (format == "raw") {
+                    config.format = RecordingFormat::Raw;
+                } else {
+                    Napi::TypeError::New(env, "format must be 'wav' or 'raw'").ThrowAsJavaScriptException();
+                    return env.Null();
                 }
-                
-                if (i && i->monitor_source_name) {
-                    Napi::Array* devices = static_cast<Napi::Array*>(pa_threaded_mainloop_get_api(
-                        static_cast<pa_threaded_mainloop*>(userdata))->userdata);
-                    
-                    Napi::Env env = devices->Env();
-                    Napi::Object device = Napi::Object::New(env);
-                    
-                    device.Set("id", i->monitor_source_name);
-                    device.Set("name", i->name ? i->name : "Unknown");
-                    device.Set("description", i->description ? i->description : "Unknown");
-                    
-                    devices->Set(devices->Length(), device);
+            }
+            if (options.Has("bufferMs") && options.Get("bufferMs").IsNumber()) {
+                int64_t ms = options.Get("bufferMs").As<Napi::Number>().Int64Value();
+                if (ms <= 0) {
+                    Napi::RangeError::New(env, "bufferMs must be positive").ThrowAsJavaScriptException();
+                    return env.Null();
                 }
-            }, 
-            mainloop
-        );
+                config.bufferMs = static_cast<uint32_t>(ms);
+            }
+            if (options.Has("ioUring") && options.Get("ioUring").IsBoolean()) {
+                config.ioUring = options.Get("ioUring").As<Napi::Boolean>().Value();
+            }
+        }
+        
+        std::string error;
+        std::unique_ptr<RecordingSink> sink = RecordingSink::Open(config, &error);
+        if (!sink) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        CaptureBackend::Lock lock(*backend);
+        recorder = std::move(sink);
+        return env.Undefined();
+    }
+
+    // stopRecording(): detaches the sink and finalises the file on a worker
+    // thread; resolves with { path, frames, bytes, framesDropped, ioUring }.
+    Napi::Value StopRecording(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        std::unique_ptr<RecordingSink> sink;
+        if (backend) {
+            CaptureBackend::Lock lock(*backend);
+            sink = std::move(recorder);
+        }
+        if (!sink) {
+            Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+            deferred.Reject(Napi::Error::New(env, "Not recording").Value());
+            return deferred.Promise();
+        }
+        
+        RecordingWorker* worker = new RecordingWorker(env, std::move(sink));
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+    class RecordingWorker : public Napi::AsyncWorker {
+    public:
+        RecordingWorker(Napi::Env env, std::unique_ptr<RecordingSink> sink)
+            : Napi::AsyncWorker(env, "PulseAudioCaptureRecording"), sink(std::move(sink)),
+              deferred(Napi::Promise::Deferred::New(env)) {
+        }
+        
+        Napi::Promise Promise() const {
+            return deferred.Promise();
+        }
+        
+    protected:
+        void Execute() override {
+            std::string error;
+            if (!sink->Finish(&summary, &error)) {
+                SetError(error);
+            }
+        }
         
-        if (op) {
-            pa_operation_unref(op);
+        void OnOK() override {
+            Napi::Env env = Env();
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("path", sink->Config().path);
+            result.Set("frames", static_cast<double>(summary.frames));
+            result.Set("bytes", static_cast<double>(summary.bytes));
+            result.Set("framesDropped", static_cast<double>(summary.framesDropped));
+            result.Set("ioUring", summary.ioUring);
+            deferred.Resolve(result);
         }
         
-        pa_threaded_mainloop_wait(mainloop);
+        void OnError(const Napi::Error& error) override {
+            deferred.Reject(error.Value());
+        }
         
-        pa_context_disconnect(context);
-        pa_context_unref(context);
+    private:
+        std::unique_ptr<RecordingSink> sink;
+        RecordingSummary summary;
+        Napi::Promise::Deferred deferred;
+    };
+
+    // Runs on a CorkWorker thread. Pausing hands out the partial delivery
+    // block so no block spans the gap; on resume the backend discards what
+    // it captured before the pause.
+    bool Cork(bool pause, std::string* error) {
+        CaptureBackend::Lock lock(*backend);
+        
+        if (pause) {
+            // No fragment can be delivered while the backend lock is held.
+            FlushPendingBlock(CaptureStats::NowNanos());
+        } else {
+            // The paused span is not a loss: the stream position carries on
+            // and the next fragment re-anchors the clock.
+            timingValid = false;
+        }
         
-        pa_threaded_mainloop_unlock(mainloop);
-        pa_threaded_mainloop_free(mainloop);
+        return backend->SetPaused(pause, error);
+    }
+
+    Napi::Value GetFormat(const Napi::CallbackInfo& info) {
+        return FormatObject(info.Env());
+    }
+
+    Napi::Object FormatObject(Napi::Env env) {
+        Napi::Object formatObj = Napi::Object::New(env);
+        formatObj.Set("sampleRate", outputSpec.rate);
+        formatObj.Set("channels", outputSpec.channels);
+        formatObj.Set("format", static_cast<int>(outputSpec.format));
+        formatObj.Set("sampleFormat", SampleFormatName(outputSpec.format));
+        formatObj.Set("bytesPerSample", static_cast<double>(pa_sample_size(&outputSpec)));
+        
+        Napi::Object streamObj = Napi::Object::New(env);
+        streamObj.Set("sampleRate", sampleSpec.rate);
+        streamObj.Set("channels", sampleSpec.channels);
+        streamObj.Set("sampleFormat", SampleFormatName(sampleSpec.format));
+        formatObj.Set("stream", streamObj);
+        formatObj.Set("backend", useFakeBackend ? "fake" : "pulse");
+        
+        if (converter) {
+            Napi::Object conversionObj = Napi::Object::New(env);
+            conversionObj.Set("resampling", converter->Resampling());
+            conversionObj.Set("quality", resamplerQuality);
+            conversionObj.Set("simd", SimdLevelName(converter->Level()));
+            formatObj.Set("conversion", conversionObj);
+        } else {
+            formatObj.Set("conversion", env.Null());
+        }
+        formatObj.Set("delivery", deliveryMode == DeliveryMode::Array ? "array" : "typedarray");
+        formatObj.Set("blockFrames", blockFrames);
+        formatObj.Set("bufferFrames", bufferFrames);
+        formatObj.Set("fragmentMs", static_cast<double>(fragmentUsec) / 1000.0);
+        if (backend) {
+            formatObj.Set("grantedFragmentMs", static_cast<double>(backend->FragmentUsec()) / 1000.0);
+        }
+        formatObj.Set("adjustLatency", pulseConfig.adjustLatency);
+        formatObj.Set("vad", vad != nullptr);
+        if (sharedRing) {
+            Napi::Object sharedObj = Napi::Object::New(env);
+            sharedObj.Set("name", sharedRing->Name());
+            sharedObj.Set("bufferFrames", static_cast<double>(sharedRing->CapacityFrames()));
+            formatObj.Set("sharedMemory", sharedObj);
+        } else {
+            formatObj.Set("sharedMemory", env.Null());
+        }
+        if (envelope) {
+            Napi::Object envelopeObj = Napi::Object::New(env);
+            envelopeObj.Set("rate", envelope->TickRate());
+            envelopeObj.Set("bands", envelope->Bands());
+            formatObj.Set("envelope", envelopeObj);
+        } else {
+            formatObj.Set("envelope", env.Null());
+        }
+        if (features) {
+            const FeatureConfig& config = features->Config();
+            Napi::Object featuresObj = Napi::Object::New(env);
+            featuresObj.Set("sampleRate", config.sampleRate);
+            featuresObj.Set("fftSize", config.fftSize);
+            featuresObj.Set("hopLength", config.hopLength);
+            featuresObj.Set("melBands", config.melBands);
+            featuresObj.Set("mfccCount", config.mfccCount);
+            formatObj.Set("features", featuresObj);
+        } else {
+            formatObj.Set("features", env.Null());
+        }
+        if (encoder) {
+            const OpusEncoderConfig& config = encoder->Config();
+            Napi::Object encodingObj = Napi::Object::New(env);
+            encodingObj.Set("codec", "opus");
+            encodingObj.Set("frameMs", config.frameMs);
+            encodingObj.Set("frameSize", encoder->FrameSize());
+            encodingObj.Set("bitrate", encoder->Bitrate());
+            encodingObj.Set("complexity", config.complexity);
+            encodingObj.Set("application", config.application == OpusApplication::Voip ? "voip"
+                : config.application == OpusApplication::LowDelay ? "lowdelay" : "audio");
+            encodingObj.Set("preSkip", encoder->PreSkip());
+            formatObj.Set("encoding", encodingObj);
+        } else {
+            formatObj.Set("encoding", env.Null());
+        }
+        if (archive) {
+            Napi::Object archiveObj = Napi::Object::New(env);
+            archiveObj.Set("path", archive->Path());
+            archiveObj.Set("seconds", static_cast<double>(archive->CapacityFrames()) / archiveSpec.rate - 1.0);
+            archiveObj.Set("frames", static_cast<double>(archive->CapacityFrames()));
+            archiveObj.Set("written", static_cast<double>(archive->Written()));
+            formatObj.Set("archive", archiveObj);
+        } else {
+            formatObj.Set("archive", env.Null());
+        }
+        if (history) {
+            Napi::Object historyObj = Napi::Object::New(env);
+            historyObj.Set("seconds", static_cast<double>(history->CapacityFrames()) / historySpec.rate);
+            historyObj.Set("frames", static_cast<double>(history->CapacityFrames()));
+            formatObj.Set("history", historyObj);
+        } else {
+            formatObj.Set("history", env.Null());
+        }
         
-        return devices;
+        return formatObj;
     }
 
-    static Napi::Value GetDefaultDevice(const Napi::CallbackInfo& info) {
+    // extractFeatures(samples: Float32Array, options?) runs the streaming
+    // extractor over a whole mono buffer, for offline use and for checking
+    // it against AudioSpectralEncoder.
+    static Napi::Value ExtractFeaturesOffline(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         
-        pa_threaded_mainloop* mainloop = pa_threaded_mainloop_new();
-        if (!mainloop) {
+        if (info.Length() < 1 || !info[0].IsTypedArray()
+            || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+            Napi::TypeError::New(env, "samples must be a Float32Array").ThrowAsJavaScriptException();
             return env.Null();
         }
+        Napi::Float32Array samples = info[0].As<Napi::Float32Array>();
         
-        if (pa_threaded_mainloop_start(mainloop) < 0) {
-            pa_threaded_mainloop_free(mainloop);
+        FeatureConfig config;
+        if (info.Length() >= 2 && info[1].IsObject()) {
+            Napi::Object options = info[1].As<Napi::Object>();
+            if (options.Has("sampleRate") && options.Get("sampleRate").IsNumber()) {
+                config.sampleRate = options.Get("sampleRate").As<Napi::Number>().Uint32Value();
+            }
+            if (!ParseFeatureConfig(env, options, &config)) {
+                return env.Null();
+            }
+        }
+        if (config.sampleRate == 0) {
+            Napi::RangeError::New(env, "sampleRate must be positive").ThrowAsJavaScriptException();
             return env.Null();
         }
         
-        pa_threaded_mainloop_lock(mainloop);
-        
-        pa_context* context = pa_context_new(pa_threaded_mainloop_get_api(mainloop), "Angela Default Device");
-        if (!context) {
-            pa_threaded_mainloop_unlock(mainloop);
-            pa_threaded_mainloop_free(mainloop);
-            return env.Null();
+        FeatureExtractor extractor(1, SampleType::Float32, config);
+        std::vector<float> logMel;
+        std::vector<float> mfcc;
+        size_t frames = extractor.Process(samples.Data(), samples.ElementLength(), &logMel, &mfcc);
+        
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("frames", static_cast<double>(frames));
+        result.Set("melBands", config.melBands);
+        result.Set("mfccCount", config.mfccCount);
+        result.Set("logMel", FloatsToTypedArray(env, logMel));
+        result.Set("mfcc", FloatsToTypedArray(env, mfcc));
+        return result;
+    }
+
+    static DeviceRegistry& Registry(Napi::Env env) {
+        DeviceRegistry& registry = env.GetInstanceData<AddonData>()->registry;
+        registry.Start();
+        return registry;
+    }
+
+    // Served from the registry cache. Only the very first call after load
+    // (or after losing the server) waits for the initial query.
+    static Napi::Value GetDevices(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        DeviceSnapshot snapshot;
+        Registry(env).WaitForSnapshot(&snapshot, kDeviceListTimeout);
+        return DevicesToArray(env, snapshot.devices);
+    }
+
+    static Napi::Value GetDefaultDevice(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        DeviceSnapshot snapshot;
+        Registry(env).WaitForSnapshot(&snapshot, kDeviceListTimeout);
+        return DefaultDeviceToValue(env, snapshot.defaultDevice);
+    }
+
+    // listDevices(): Promise<{ devices, defaultDevice }> that never blocks
+    // the JS thread; the wait for a cold registry runs on a worker.
+    class ListDevicesWorker : public Napi::AsyncWorker {
+    public:
+        ListDevicesWorker(Napi::Env env, DeviceRegistry* registry)
+            : Napi::AsyncWorker(env, "PulseAudioListDevices"), registry(registry),
+              deferred(Napi::Promise::Deferred::New(env)) {
         }
         
-        if (pa_context_connect(context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
-            pa_context_unref(context);
-            pa_threaded_mainloop_unlock(mainloop);
-            pa_threaded_mainloop_free(mainloop);
-            return env.Null();
+        Napi::Promise Promise() const {
+            return deferred.Promise();
         }
         
-        while (true) {
-            pa_context_state_t state = pa_context_get_state(context);
-            if (state == PA_CONTEXT_READY) break;
-            if (!PA_CONTEXT_IS_GOOD(state)) {
-                pa_context_disconnect(context);
-                pa_context_unref(context);
-                pa_threaded_mainloop_unlock(mainloop);
-                pa_threaded_mainloop_free(mainloop);
-                return env.Null();
+    protected:
+        void Execute() override {
+            if (!registry->WaitForSnapshot(&snapshot, kDeviceListTimeout)) {
+                SetError("PulseAudio device list unavailable");
             }
-            pa_threaded_mainloop_wait(mainloop);
         }
         
-        Napi::Object device = Napi::Object::New(env);
-        bool found = false;
-        
-        pa_operation* op = pa_context_get_server_info(context,
-            [](pa_context* c, const pa_server_info* i, void* userdata) {
-                if (i && i->default_sink_name) {
-                    struct DeviceData {
-                        Napi::Object device;
-                        bool* found;
-                    };
-                    DeviceData* data = static_cast<DeviceData*>(userdata);
-                    
-                    data->device.Set("id", i->default_sink_name);
-                    data->device.Set("name", i->default_sink_name);
-                    *data->found = true;
-                }
-                pa_threaded_mainloop_signal(static_cast<pa_threaded_mainloop*>(
-                    static_cast<DeviceData*>(userdata)->device.Data()), 0);
-            },
-            &device
-        );
+        void OnOK() override {
+            deferred.Resolve(SnapshotToObject(Env(), snapshot));
+        }
+        
+        void OnError(const Napi::Error& error) override {
+            deferred.Reject(error.Value());
+        }
+        
+    private:
+        DeviceRegistry* registry;
+        DeviceSnapshot snapshot;
+        Napi::Promise::Deferred deferred;
+    };
+
+    static Napi::Object SnapshotToObject(Napi::Env env, const DeviceSnapshot& snapshot) {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("devices", DevicesToArray(env, snapshot.devices));
+        result.Set("defaultDevice", DefaultDeviceToValue(env, snapshot.defaultDevice));
+        return result;
+    }
+
+    static Napi::Value ListDevices(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        DeviceRegistry& registry = Registry(env);
         
-        if (op) {
-            pa_operation_unref(op);
+        DeviceSnapshot snapshot;
+        if (registry.Snapshot(&snapshot)) {
+            Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+            deferred.Resolve(SnapshotToObject(env, snapshot));
+            return deferred.Promise();
         }
         
-        pa_threaded_mainloop_wait(mainloop);
+        ListDevicesWorker* worker = new ListDevicesWorker(env, &registry);
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+    // watchDevices(callback | null): callback({ devices, defaultDevice }) on
+    // every change after the initial list. The TSFN is unref'd so watching
+    // does not keep the process alive.
+    static Napi::Value WatchDevices(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        AddonData* data = env.GetInstanceData<AddonData>();
         
-        pa_context_disconnect(context);
-        pa_context_unref(context);
+        data->registry.SetListener(nullptr);
+        if (data->deviceTsfn) {
+            data->deviceTsfn.Release();
+            data->deviceTsfn = Napi::ThreadSafeFunction();
+        }
         
-        pa_threaded_mainloop_unlock(mainloop);
-        pa_threaded_mainloop_free(mainloop);
+        if (info.Length() < 1 || !info[0].IsFunction()) {
+            return env.Undefined();
+        }
+        
+        data->deviceTsfn = Napi::ThreadSafeFunction::New(
+            env, info[0].As<Napi::Function>(), "PulseAudioDeviceChange", 0, 1
+        );
+        data->deviceTsfn.Unref(env);
+        
+        Napi::ThreadSafeFunction tsfn = data->deviceTsfn;
+        data->registry.SetListener([tsfn](const DeviceSnapshot& snapshot) {
+            if (snapshot.generation <= 1) {
+                return;
+            }
+            DeviceSnapshot* copy = new DeviceSnapshot(snapshot);
+            auto callback = [](Napi::Env env, Napi::Function jsCallback, DeviceSnapshot* snapshot) {
+                std::unique_ptr<DeviceSnapshot> owned(snapshot);
+                if (env != nullptr && !jsCallback.IsEmpty()) {
+                    jsCallback.Call({SnapshotToObject(env, *owned)});
+                }
+            };
+            if (tsfn.NonBlockingCall(copy, callback) != napi_ok) {
+                delete copy;
+            }
+        });
+        data->registry.Start();
         
-        return found ? device : env.Null();
+        return env.Undefined();
     }
 };
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    return PulseAudioCapture::Init(env, exports);
+    PulseAudioCapture::Init(env, exports);
+    return CaptureSession::Init(env, exports);
 }
 
 NODE_API_MODULE(pulseaudio-capture, Init)
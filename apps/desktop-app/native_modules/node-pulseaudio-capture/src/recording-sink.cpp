@@ -0,0 +1,325 @@
+#include "recording-sink.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+static const size_t kWavHeaderBytes = 44;
+static const size_t kPageBytes = 4096;
+static const std::chrono::milliseconds kWriterPoll(50);
+
+static void PutU16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void PutU32(uint8_t* p, uint32_t value) {
+    PutU16(p, static_cast<uint16_t>(value));
+    PutU16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+// Canonical 44-byte header: PCM (format 1) for integer samples, IEEE float
+// (format 3) for float32.
+static void BuildWavHeader(uint8_t* header, const RecordingConfig& config, uint64_t dataBytes) {
+    uint32_t blockAlign = config.channels * config.bytesPerSample;
+    uint32_t dataSize = static_cast<uint32_t>(std::min<uint64_t>(dataBytes, 0xFFFFFFFFu - 36));
+    std::memcpy(header, "RIFF", 4);
+    PutU32(header + 4, 36 + dataSize);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    PutU32(header + 16, 16);
+    PutU16(header + 20, config.floatSamples ? 3 : 1);
+    PutU16(header + 22, static_cast<uint16_t>(config.channels));
+    PutU32(header + 24, config.sampleRate);
+    PutU32(header + 28, config.sampleRate * blockAlign);
+    PutU16(header + 32, static_cast<uint16_t>(blockAlign));
+    PutU16(header + 34, static_cast<uint16_t>(config.bytesPerSample * 8));
+    std::memcpy(header + 36, "data", 4);
+    PutU32(header + 40, dataSize);
+}
+
+RecordingSink::RecordingSink(const RecordingConfig& config)
+    : config(config), frameSize(config.channels * config.bytesPerSample), fd(-1), stopping(false),
+      finished(false), current(0), staged(0), fileOffset(0), dataBytes(0), failed(false),
+      useIoUring(false) {
+    for (size_t i = 0; i < kBuffers; i++) {
+        buffers[i] = nullptr;
+        busy[i] = false;
+    }
+#ifdef HAVE_LIBURING
+    inFlight = 0;
+#endif
+}
+
+std::unique_ptr<RecordingSink> RecordingSink::Open(const RecordingConfig& config, std::string* error) {
+    std::unique_ptr<RecordingSink> sink(new RecordingSink(config));
+
+    for (size_t i = 0; i < kBuffers; i++) {
+        void* buffer = nullptr;
+        if (posix_memalign(&buffer, kPageBytes, kChunkBytes) != 0) {
+            *error = "Failed to allocate recording buffers";
+            return nullptr;
+        }
+        sink->buffers[i] = static_cast<uint8_t*>(buffer);
+    }
+
+    size_t frameSize = sink->frameSize;
+    size_t ringFrames = static_cast<size_t>(config.sampleRate) * config.bufferMs / 1000;
+    size_t ringBytes = std::max(ringFrames * frameSize, (2 * kChunkBytes / frameSize + 1) * frameSize);
+    sink->ring.reset(new SpscRingBuffer<uint8_t>(ringBytes, OverflowPolicy::DropNewest));
+
+    sink->fd = open(config.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (sink->fd < 0) {
+        *error = "Failed to open " + config.path + ": " + std::strerror(errno);
+        return nullptr;
+    }
+
+#ifdef HAVE_LIBURING
+    if (config.ioUring && io_uring_queue_init(kBuffers, &sink->uring, 0) == 0) {
+        sink->useIoUring = true;
+    }
+#endif
+
+    // The placeholder header goes out with the first chunk so that all
+    // later writes stay chunk-aligned in the file.
+    if (config.format == RecordingFormat::Wav) {
+        BuildWavHeader(sink->buffers[0], config, 0);
+        sink->staged = kWavHeaderBytes;
+    }
+
+    sink->writer = std::thread(&RecordingSink::Run, sink.get());
+    return sink;
+}
+
+RecordingSink::~RecordingSink() {
+    if (!finished) {
+        RecordingSummary summary;
+        std::string error;
+        Finish(&summary, &error);
+    }
+    for (size_t i = 0; i < kBuffers; i++) {
+        free(buffers[i]);
+    }
+}
+
+// Only whole frames are queued: a partly stored frame would shift every
+// later sample in the file.
+void RecordingSink::Write(const uint8_t* data, size_t frames) {
+    size_t free = ring->Capacity() - ring->Available();
+    size_t fit = std::min(frames, free / frameSize);
+    if (fit > 0) {
+        ring->Write(data, fit * frameSize);
+    }
+    if (fit < frames) {
+        framesDropped.fetch_add(frames - fit, std::memory_order_relaxed);
+    }
+}
+
+void RecordingSink::WriteSilence(size_t frames) {
+    static const uint8_t zeros[kPageBytes] = {};
+    size_t chunkFrames = kPageBytes / frameSize;
+    while (frames > 0) {
+        size_t n = std::min(frames, chunkFrames);
+        Write(zeros, n);
+        frames -= n;
+    }
+}
+
+bool RecordingSink::Finish(RecordingSummary* summary, std::string* error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    if (!finished) {
+        finished = true;
+#ifdef HAVE_LIBURING
+        if (useIoUring) {
+            io_uring_queue_exit(&uring);
+        }
+#endif
+        if (fd >= 0 && close(fd) != 0) {
+            Fail(std::string("Failed to close recording: ") + std::strerror(errno));
+        }
+        fd = -1;
+    }
+
+    summary->frames = dataBytes / frameSize;
+    summary->bytes = fileOffset;
+    summary->framesDropped = framesDropped.load(std::memory_order_relaxed);
+    summary->ioUring = useIoUring;
+    if (failed) {
+        *error = errorMessage;
+        return false;
+    }
+    return true;
+}
+
+void RecordingSink::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, kWriterPoll);
+        lock.unlock();
+        Drain(false);
+        lock.lock();
+    }
+    lock.unlock();
+    Drain(true);
+}
+
+// Fills the current staging buffer from the ring and submits it whenever
+// it is full. The final drain also submits the partial tail, waits for
+// every write and rewrites the header.
+bool RecordingSink::Drain(bool final) {
+    while (!failed) {
+        while (busy[current]) {
+            if (!Reap(true)) {
+                return false;
+            }
+        }
+        size_t n = ring->Read(buffers[current] + staged, kChunkBytes - staged);
+        staged += n;
+        dataBytes += n;
+        framesWritten.store(dataBytes / frameSize, std::memory_order_relaxed);
+        if (staged < kChunkBytes) {
+            break;
+        }
+        Submit(kChunkBytes);
+        staged = 0;
+    }
+
+    if (!final) {
+        return !failed;
+    }
+
+    if (!failed && staged > 0) {
+        Submit(staged);
+        staged = 0;
+    }
+#ifdef HAVE_LIBURING
+    while (useIoUring && inFlight > 0) {
+        if (!Reap(true)) {
+            break;
+        }
+    }
+#endif
+    if (!failed && config.format == RecordingFormat::Wav) {
+        WriteHeader();
+    }
+    return !failed;
+}
+
+bool RecordingSink::Submit(size_t length) {
+    size_t index = current;
+    uint64_t offset = fileOffset;
+    fileOffset += length;
+    current = (current + 1) % kBuffers;
+
+#ifdef HAVE_LIBURING
+    if (useIoUring) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&uring);
+        if (!sqe && Reap(true)) {
+            sqe = io_uring_get_sqe(&uring);
+        }
+        if (sqe) {
+            io_uring_prep_write(sqe, fd, buffers[index], static_cast<unsigned>(length), offset);
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+            lengths[index] = length;
+            offsets[index] = offset;
+            busy[index] = true;
+            inFlight++;
+            // A failed submit has already handed the entry to the kernel's
+            // queue and the next one would send it again, so it is retried
+            // rather than written here; completions are reaped to make room.
+            int submitted;
+            while ((submitted = io_uring_submit(&uring)) <= 0) {
+                if (submitted == -EINTR) {
+                    continue;
+                }
+                if ((submitted == 0 || submitted == -EAGAIN || submitted == -EBUSY) && inFlight > 1 && Reap(true)) {
+                    continue;
+                }
+                // Nothing is submitted once the recording has failed, so
+                // the entry is never consumed and no completion is awaited.
+                busy[index] = false;
+                inFlight--;
+                Fail(std::string("io_uring submit failed: ")
+                    + std::strerror(submitted < 0 ? -submitted : EAGAIN));
+                return false;
+            }
+            return true;
+        }
+    }
+#endif
+    return WriteFully(buffers[index], length, offset);
+}
+
+// Completes one io_uring write; a short write is finished with pwrite().
+bool RecordingSink::Reap(bool wait) {
+#ifdef HAVE_LIBURING
+    if (!useIoUring || inFlight == 0) {
+        return false;
+    }
+    io_uring_cqe* cqe = nullptr;
+    int status = wait ? io_uring_wait_cqe(&uring, &cqe) : io_uring_peek_cqe(&uring, &cqe);
+    if (status < 0 || !cqe) {
+        if (wait) {
+            Fail(std::string("io_uring wait failed: ") + std::strerror(-status));
+        }
+        return false;
+    }
+    size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+    int result = cqe->res;
+    io_uring_cqe_seen(&uring, cqe);
+    busy[index] = false;
+    inFlight--;
+
+    if (result < 0) {
+        Fail(std::string("Recording write failed: ") + std::strerror(-result));
+    } else if (static_cast<size_t>(result) < lengths[index]) {
+        WriteFully(buffers[index] + result, lengths[index] - result, offsets[index] + result);
+    }
+    return true;
+#else
+    (void)wait;
+    return false;
+#endif
+}
+
+bool RecordingSink::WriteFully(const uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Fail(std::string("Recording write failed: ") + std::strerror(errno));
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+void RecordingSink::Fail(const std::string& message) {
+    if (!failed) {
+        failed = true;
+        errorMessage = message;
+    }
+}
+
+bool RecordingSink::WriteHeader() {
+    uint8_t header[kWavHeaderBytes];
+    BuildWavHeader(header, config, dataBytes);
+    return WriteFully(header, sizeof(header), 0);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "spsc-ring-buffer.h"
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+enum class RecordingFormat {
+    Wav,
+    Raw
+};
+
+struct RecordingConfig {
+    std::string path;
+    RecordingFormat format = RecordingFormat::Wav;
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    uint32_t bytesPerSample = 4;
+    bool floatSamples = true;
+    // Audio the writer may fall behind by before frames are dropped.
+    uint32_t bufferMs = 2000;
+    // Submit writes through io_uring when the addon was built with liburing
+    // and the kernel allows it; falls back to pwrite() otherwise.
+    bool ioUring = false;
+};
+
+struct RecordingSummary {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t framesDropped = 0;
+    bool ioUring = false;
+};
+
+// Streams the capture to a WAV or raw PCM file from its own thread.
+//
+// The mainloop thread only copies into a lock-free ring (Write() never
+// blocks and never takes a lock); when the writer falls behind by more than
+// bufferMs whole frames are dropped and counted. The writer drains the ring
+// in 256 KiB chunks staged in page-aligned buffers, so every write but the
+// last is a full chunk at a chunk-aligned file offset. The WAV header is
+// staged in front of the first chunk as a placeholder and rewritten with
+// the final sizes by Finish(); a WAV larger than 4 GiB keeps the maximum
+// sizes, which most readers treat as "until end of file".
+class RecordingSink {
+public:
+    static std::unique_ptr<RecordingSink> Open(const RecordingConfig& config, std::string* error);
+
+    ~RecordingSink();
+
+    // Mainloop thread.
+    void Write(const uint8_t* data, size_t frames);
+    void WriteSilence(size_t frames);
+
+    // Drains the ring, finalises the header, closes the file and joins the
+    // writer. Returns false with `error` set if any write failed.
+    bool Finish(RecordingSummary* summary, std::string* error);
+
+    const RecordingConfig& Config() const {
+        return config;
+    }
+
+    uint64_t FramesWritten() const {
+        return framesWritten.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FramesDropped() const {
+        return framesDropped.load(std::memory_order_relaxed);
+    }
+
+    bool UsingIoUring() const {
+        return useIoUring;
+    }
+
+private:
+    static constexpr size_t kChunkBytes = 256 * 1024;
+    static constexpr size_t kBuffers = 4;
+
+    explicit RecordingSink(const RecordingConfig& config);
+
+    void Run();
+    bool Drain(bool final);
+    bool Submit(size_t length);
+    bool Reap(bool wait);
+    bool WriteFully(const uint8_t* data, size_t length, uint64_t offset);
+    void Fail(const std::string& message);
+    bool WriteHeader();
+
+    RecordingConfig config;
+    size_t frameSize;
+    int fd;
+    std::unique_ptr<SpscRingBuffer<uint8_t>> ring;
+
+    std::atomic<uint64_t> framesWritten{0};
+    std::atomic<uint64_t> framesDropped{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    bool finished;
+    std::thread writer;
+
+    // Writer-thread state.
+    uint8_t* buffers[kBuffers];
+    bool busy[kBuffers];
+    size_t current;
+    size_t staged;
+    uint64_t fileOffset;
+    uint64_t dataBytes;
+    bool failed;
+    std::string errorMessage;
+
+    bool useIoUring;
+#ifdef HAVE_LIBURING
+    io_uring uring;
+    size_t inFlight;
+    size_t lengths[kBuffers];
+    uint64_t offsets[kBuffers];
+#endif
+};
@@ -0,0 +1,341 @@
+#include "rolling-archive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(offsetof(ArchiveHeader, capacity) == 32, "archive header layout");
+static_assert(offsetof(ArchiveHeader, bootId) == 40, "archive header layout");
+static_assert(offsetof(ArchiveHeader, sequence) == 128, "archive header layout");
+static_assert(offsetof(ArchiveHeader, written) == 136, "archive header layout");
+static_assert(offsetof(ArchiveHeader, endNanos) == 144, "archive header layout");
+static_assert(offsetof(ArchiveHeader, first) == 152, "archive header layout");
+static_assert(sizeof(ArchiveHeader) <= kArchiveHeaderSize, "archive header size");
+
+// A write starting this much later than the previous one ended is a
+// discontinuity and is filled with silence; less is timestamp jitter.
+static const int64_t kArchiveGapNanos = 20000000;
+
+// Creates a file of `size` bytes next to `path`, locks it and renames it
+// over `path`. Truncating the old file instead would fault readers that
+// still map its tail.
+static int ReplaceFile(const std::string& path, size_t size, std::string* error) {
+    std::vector<char> name(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    name.insert(name.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0) {
+        *error = "Failed to create archive " + path + ": " + std::strerror(errno);
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0 || ftruncate(fd, static_cast<off_t>(size)) < 0
+        || rename(name.data(), path.c_str()) < 0) {
+        *error = "Failed to replace archive " + path + ": " + std::strerror(errno);
+        unlink(name.data());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::string BootId() {
+    std::ifstream file("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    std::getline(file, id);
+    return id.substr(0, sizeof(ArchiveHeader::bootId) - 1);
+}
+
+std::shared_ptr<RollingArchive> RollingArchive::Open(const std::string& path, size_t capacityFrames,
+    uint32_t sampleRate, uint32_t channels, uint32_t sampleType, uint32_t bytesPerFrame, std::string* error) {
+    size_t mappingSize = kArchiveHeaderSize + capacityFrames * bytesPerFrame;
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        *error = "Failed to open archive " + path + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    // One writer per file; the lock goes away with the descriptor.
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        *error = "Archive " + path + " is in use by another capture";
+        close(fd);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        *error = std::string("fstat failed: ") + std::strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+    bool reuse = static_cast<size_t>(st.st_size) == mappingSize;
+    // Nothing can map a file created or replaced here yet.
+    bool blank = !reuse;
+    if (!reuse && st.st_size == 0) {
+        if (ftruncate(fd, static_cast<off_t>(mappingSize)) < 0) {
+            *error = std::string("ftruncate failed: ") + std::strerror(errno);
+            close(fd);
+            return nullptr;
+        }
+    } else if (!reuse) {
+        int replacement = ReplaceFile(path, mappingSize, error);
+        close(fd);
+        if (replacement < 0) {
+            return nullptr;
+        }
+        fd = replacement;
+    }
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        *error = std::string("mmap failed: ") + std::strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+
+    std::shared_ptr<RollingArchive> archive(new RollingArchive(path, fd,
+        std::make_shared<ArchiveMapping>(mapping, mappingSize)));
+    std::string bootId = BootId();
+    ArchiveHeader* header = static_cast<ArchiveHeader*>(mapping);
+    reuse = reuse && std::memcmp(header->magic, kArchiveMagic, sizeof(kArchiveMagic)) == 0
+        && header->version == kArchiveVersion && header->headerSize == kArchiveHeaderSize
+        && header->sampleRate == sampleRate && header->channels == channels
+        && header->sampleType == sampleType && header->bytesPerFrame == bytesPerFrame
+        && header->capacity == capacityFrames
+        && std::strncmp(header->bootId, bootId.c_str(), sizeof(header->bootId)) == 0;
+    // A writer that died inside Publish() left the sequence odd, which
+    // Publish() would keep odd and readers would spin on, and possibly a
+    // cursor and end time that do not belong together.
+    reuse = reuse && (header->sequence.load(std::memory_order_acquire) & 1) == 0;
+
+    // Resetting a file in place would restart the cursor under views that
+    // still map it, which Holds() would then take for current again.
+    if (!reuse && !blank) {
+        int replacement = ReplaceFile(path, mappingSize, error);
+        archive.reset();
+        if (replacement < 0) {
+            return nullptr;
+        }
+        fd = replacement;
+        mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            *error = std::string("mmap failed: ") + std::strerror(errno);
+            close(fd);
+            return nullptr;
+        }
+        archive.reset(new RollingArchive(path, fd, std::make_shared<ArchiveMapping>(mapping, mappingSize)));
+        header = static_cast<ArchiveHeader*>(mapping);
+    }
+
+    if (!reuse) {
+        header = new (mapping) ArchiveHeader();
+        std::memcpy(header->magic, kArchiveMagic, sizeof(kArchiveMagic));
+        header->version = kArchiveVersion;
+        header->headerSize = static_cast<uint32_t>(kArchiveHeaderSize);
+        header->sampleRate = sampleRate;
+        header->channels = channels;
+        header->sampleType = sampleType;
+        header->bytesPerFrame = bytesPerFrame;
+        header->capacity = capacityFrames;
+        std::strncpy(header->bootId, bootId.c_str(), sizeof(header->bootId) - 1);
+        header->written.store(0, std::memory_order_relaxed);
+        header->endNanos.store(0, std::memory_order_relaxed);
+        header->first.store(0, std::memory_order_relaxed);
+        header->sequence.store(0, std::memory_order_release);
+    }
+
+    archive->header = header;
+    archive->data = static_cast<uint8_t*>(mapping) + kArchiveHeaderSize;
+    archive->frameSize = bytesPerFrame;
+    return archive;
+}
+
+ArchiveMapping::~ArchiveMapping() {
+    munmap(address, size);
+}
+
+RollingArchive::RollingArchive(const std::string& path, int fd, std::shared_ptr<ArchiveMapping> mapping)
+    : path(path), fd(fd), mapping(std::move(mapping)), header(nullptr), data(nullptr), frameSize(0) {
+}
+
+// The mapping shares the open file description, and with it the lock, so
+// the lock is dropped explicitly rather than left to the last view.
+RollingArchive::~RollingArchive() {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+bool RollingArchive::Matches(const std::string& otherPath, size_t capacityFrames, uint32_t sampleRate,
+    uint32_t channels, uint32_t sampleType) const {
+    return path == otherPath && header->capacity == capacityFrames && header->sampleRate == sampleRate
+        && header->channels == channels && header->sampleType == sampleType;
+}
+
+void RollingArchive::Write(const uint8_t* samples, size_t frames, int64_t captureNanos) {
+    uint64_t written = header->written.load(std::memory_order_relaxed);
+    int64_t end = header->endNanos.load(std::memory_order_relaxed);
+    uint64_t first = header->first.load(std::memory_order_relaxed);
+    uint64_t capacity = header->capacity;
+
+    if (written > 0 && captureNanos - end > kArchiveGapNanos) {
+        uint64_t silence = static_cast<uint64_t>(
+            static_cast<double>(captureNanos - end) * header->sampleRate / 1e9);
+        if (silence >= capacity) {
+            // Nothing from before the gap survives it: skip the cursor
+            // past it instead of zeroing the whole archive on the mainloop
+            // thread, and keep readers off the stale slots.
+            first = written + silence;
+            written += silence;
+            Publish(written, captureNanos, first);
+        } else {
+            // Published a margin at a time so the writer never stores
+            // further ahead of the cursor than readers are kept back from.
+            uint64_t margin = Margin(header);
+            for (uint64_t stored = 0; stored < silence; ) {
+                uint64_t chunk = std::min(margin, silence - stored);
+                Store(nullptr, static_cast<size_t>(chunk), written);
+                written += chunk;
+                stored += chunk;
+                end += static_cast<int64_t>(static_cast<double>(chunk) * 1e9 / header->sampleRate);
+                Publish(written, end, first);
+            }
+        }
+    }
+
+    // The cursor only moves inside Publish(), together with the end time
+    // that belongs to it.
+    Store(samples, frames, written);
+    Publish(written + frames, captureNanos + static_cast<int64_t>(frames) * 1000000000 / header->sampleRate, first);
+}
+
+// Copies into the slots from frame `position` on without publishing them.
+// A null `samples` stores silence (zero bytes in every supported format).
+void RollingArchive::Store(const uint8_t* samples, size_t frames, uint64_t position) {
+    uint64_t capacity = header->capacity;
+    if (frames > capacity) {
+        size_t skipped = static_cast<size_t>(frames - capacity);
+        if (samples) {
+            samples += skipped * frameSize;
+        }
+        position += skipped;
+        frames = static_cast<size_t>(capacity);
+    }
+
+    size_t offset = static_cast<size_t>(position % capacity);
+    size_t first = std::min<size_t>(frames, static_cast<size_t>(capacity) - offset);
+    if (samples) {
+        std::memcpy(data + offset * frameSize, samples, first * frameSize);
+        std::memcpy(data, samples + first * frameSize, (frames - first) * frameSize);
+    } else {
+        Clear(offset, first);
+        Clear(0, frames - first);
+    }
+}
+
+// Zeroes `frames` slots from `slot` on. Whole pages are punched out of the
+// file, which drops them instead of faulting in and writing every byte;
+// the partial pages at the edges, or everything on a filesystem that
+// cannot punch holes, are cleared by hand.
+void RollingArchive::Clear(size_t slot, size_t frames) {
+    uint8_t* base = mapping->Address();
+    uint8_t* begin = data + slot * frameSize;
+    uint8_t* end = begin + frames * frameSize;
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uint8_t* pagesBegin = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(begin) + page - 1) & ~(page - 1));
+    uint8_t* pagesEnd = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(end) & ~(page - 1));
+    if (pagesEnd > pagesBegin
+        && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pagesBegin - base, pagesEnd - pagesBegin) == 0) {
+        std::memset(begin, 0, static_cast<size_t>(pagesBegin - begin));
+        std::memset(pagesEnd, 0, static_cast<size_t>(end - pagesEnd));
+        return;
+    }
+    std::memset(begin, 0, frames * frameSize);
+}
+
+void RollingArchive::Publish(uint64_t written, int64_t endNanos, uint64_t first) {
+    uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->written.store(written, std::memory_order_relaxed);
+    header->endNanos.store(endNanos, std::memory_order_relaxed);
+    header->first.store(first, std::memory_order_relaxed);
+    header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Spins while the writer is inside Publish().
+RollingArchive::Cursor RollingArchive::LoadCursor(const ArchiveHeader* header) {
+    Cursor cursor;
+    while (true) {
+        uint32_t before = header->sequence.load(std::memory_order_acquire);
+        cursor.written = header->written.load(std::memory_order_relaxed);
+        cursor.endNanos = header->endNanos.load(std::memory_order_relaxed);
+        cursor.first = header->first.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((before & 1) == 0 && header->sequence.load(std::memory_order_relaxed) == before) {
+            return cursor;
+        }
+    }
+}
+
+// The writer stores at most this many frames past the published cursor
+// before publishing them.
+uint64_t RollingArchive::Margin(const ArchiveHeader* header) {
+    return std::min<uint64_t>(header->sampleRate, header->capacity / 2);
+}
+
+// The slots the writer fills next are the oldest ones, so a margin's worth
+// of the archive is kept back from readers.
+uint64_t RollingArchive::Oldest(const ArchiveHeader* header, const Cursor& cursor) {
+    uint64_t held = header->capacity - Margin(header);
+    return std::max<uint64_t>(cursor.first, cursor.written > held ? cursor.written - held : 0);
+}
+
+bool RollingArchive::Range(int64_t startNanos, int64_t endNanos, ArchiveRange* range) const {
+    Cursor cursor = LoadCursor(header);
+    uint64_t written = cursor.written;
+    int64_t end = cursor.endNanos;
+    if (written == 0 || endNanos <= startNanos) {
+        return false;
+    }
+
+    const uint64_t capacity = header->capacity;
+    const double rate = header->sampleRate;
+    int64_t oldest = static_cast<int64_t>(Oldest(header, cursor));
+    auto frameAt = [written, end, rate](int64_t nanos) {
+        return static_cast<int64_t>(written) - static_cast<int64_t>(std::llround(static_cast<double>(end - nanos) * rate / 1e9));
+    };
+    int64_t from = std::max(frameAt(startNanos), oldest);
+    int64_t last = std::min(frameAt(endNanos), static_cast<int64_t>(written));
+    if (last <= from) {
+        return false;
+    }
+
+    uint64_t frames = static_cast<uint64_t>(last - from);
+    range->frame = static_cast<uint64_t>(from);
+    range->nanos = end - static_cast<int64_t>(static_cast<double>(written - range->frame) * 1e9 / rate);
+    range->frames = frames;
+
+    size_t offset = static_cast<size_t>(range->frame % capacity);
+    size_t head = static_cast<size_t>(std::min<uint64_t>(frames, capacity - offset));
+    range->spans[0] = data + offset * frameSize;
+    range->spanBytes[0] = head * frameSize;
+    range->spans[1] = data;
+    range->spanBytes[1] = static_cast<size_t>(frames - head) * frameSize;
+    return true;
+}
+
+bool RollingArchive::Holds(const ArchiveMapping& mapping, uint64_t frame) {
+    const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(mapping.Address());
+    return frame >= Oldest(header, LoadCursor(header));
+}
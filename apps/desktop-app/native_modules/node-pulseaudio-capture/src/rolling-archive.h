@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Fixed header at the start of the archive file. Bump kArchiveVersion on
+// any change; a file with another version, format or capacity, or one
+// whose writer died mid-update, is reset.
+//
+//   0  char[8]  magic "ANGLARCH"
+//   8  u32      version
+//  12  u32      headerSize (offset of the sample data)
+//  16  u32      sampleRate
+//  20  u32      channels
+//  24  u32      sampleType (0 float32, 1 int16, 2 int32)
+//  28  u32      bytesPerFrame
+//  32  u64      capacity in frames
+//  40  char[40] boot id the timestamps belong to, NUL-terminated
+// 128  u32      sequence, odd while the cursor and end time are updated
+// 136  u64      frames written since the archive was created; the newest
+//               frame sits at slot (written - 1) % capacity
+// 144  i64      CLOCK_MONOTONIC capture time just past the newest frame
+// 152  u64      oldest frame still readable; a gap longer than the archive
+//               moves it past everything written before the gap
+static const char kArchiveMagic[8] = { 'A', 'N', 'G', 'L', 'A', 'R', 'C', 'H' };
+static const uint32_t kArchiveVersion = 2;
+static const size_t kArchiveHeaderSize = 4096;
+
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t sampleType;
+    uint32_t bytesPerFrame;
+    uint64_t capacity;
+    char bootId[40];
+    alignas(64) std::atomic<uint32_t> sequence;
+    alignas(8) std::atomic<uint64_t> written;
+    std::atomic<int64_t> endNanos;
+    std::atomic<uint64_t> first;
+};
+
+struct ArchiveRange {
+    // Archive frame index and capture time of the first frame.
+    uint64_t frame;
+    int64_t nanos;
+    uint64_t frames;
+    // The range as one or two spans of the mapping (two when it wraps).
+    const uint8_t* spans[2];
+    size_t spanBytes[2];
+};
+
+// The archive file's mapping. readRange() views hold it, not the archive,
+// so they keep the memory valid without keeping the descriptor and its
+// writer lock: a restart can reopen the path while old views are alive.
+class ArchiveMapping {
+public:
+    ArchiveMapping(void* address, size_t size) : address(address), size(size) {
+    }
+
+    ~ArchiveMapping();
+
+    ArchiveMapping(const ArchiveMapping&) = delete;
+    ArchiveMapping& operator=(const ArchiveMapping&) = delete;
+
+    uint8_t* Address() const {
+        return static_cast<uint8_t*>(address);
+    }
+
+private:
+    void* address;
+    size_t size;
+};
+
+// Circular archive of the last N minutes of capture in a memory-mapped
+// file, so long look-backs cost page cache rather than heap. The mainloop
+// thread appends; readers resolve times to frames from the cursor and end
+// time, read together under a seqlock, and get spans that alias the
+// mapping. The archive is contiguous in time: when a write starts later
+// than the previous one ended (a gap, a pause, a reload of the renderer
+// that reopened the file) the difference is filled with silence. A gap
+// longer than the whole archive instead retires everything before it.
+//
+// Timestamps are CLOCK_MONOTONIC and only meaningful within one boot, so
+// reopening a file written before a reboot starts it afresh.
+class RollingArchive {
+public:
+    static std::shared_ptr<RollingArchive> Open(const std::string& path, size_t capacityFrames, uint32_t sampleRate,
+        uint32_t channels, uint32_t sampleType, uint32_t bytesPerFrame, std::string* error);
+
+    ~RollingArchive();
+
+    bool Matches(const std::string& path, size_t capacityFrames, uint32_t sampleRate, uint32_t channels,
+        uint32_t sampleType) const;
+
+    // Mainloop thread. `captureNanos` is the capture time of the first frame.
+    void Write(const uint8_t* data, size_t frames, int64_t captureNanos);
+
+    // Resolves [startNanos, endNanos) against the archive as it is now,
+    // clamped to what it still holds. False if nothing overlaps.
+    bool Range(int64_t startNanos, int64_t endNanos, ArchiveRange* range) const;
+
+    // True while spans from Range() starting at archive frame `frame` still
+    // hold what they held then, i.e. the frame is still readable. Reads the
+    // cursor from the mapping itself, so views of a replaced file stay valid.
+    static bool Holds(const ArchiveMapping& mapping, uint64_t frame);
+
+    const std::string& Path() const {
+        return path;
+    }
+
+    size_t CapacityFrames() const {
+        return static_cast<size_t>(header->capacity);
+    }
+
+    uint64_t Written() const {
+        return header->written.load(std::memory_order_acquire);
+    }
+
+    // What spans returned by Range() point into.
+    const std::shared_ptr<ArchiveMapping>& Mapping() const {
+        return mapping;
+    }
+
+private:
+    struct Cursor {
+        uint64_t written;
+        int64_t endNanos;
+        uint64_t first;
+    };
+
+    RollingArchive(const std::string& path, int fd, std::shared_ptr<ArchiveMapping> mapping);
+
+    static Cursor LoadCursor(const ArchiveHeader* header);
+    static uint64_t Margin(const ArchiveHeader* header);
+    static uint64_t Oldest(const ArchiveHeader* header, const Cursor& cursor);
+
+    void Store(const uint8_t* data, size_t frames, uint64_t position);
+    void Clear(size_t slot, size_t frames);
+    void Publish(uint64_t written, int64_t endNanos, uint64_t first);
+
+    std::string path;
+    int fd;
+    std::shared_ptr<ArchiveMapping> mapping;
+    ArchiveHeader* header;
+    uint8_t* data;
+    size_t frameSize;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SampleType {
+    Float32,
+    Int16,
+    Int32
+};
+
+inline size_t SampleTypeSize(SampleType type) {
+    return type == SampleType::Int16 ? 2 : 4;
+}
+
+// Reads sample `index` of an interleaved buffer as float in [-1, 1).
+inline float SampleToFloat(const void* data, size_t index, SampleType type) {
+    switch (type) {
+        case SampleType::Int16:
+            return static_cast<const int16_t*>(data)[index] * (1.0f / 32768.0f);
+        case SampleType::Int32:
+            return static_cast<float>(static_cast<const int32_t*>(data)[index]) * (1.0f / 2147483648.0f);
+        default:
+            return static_cast<const float*>(data)[index];
+    }
+}
@@ -0,0 +1,118 @@
+#include "shared-memory-ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(offsetof(SharedRingHeader, capacity) == 32, "shared ring header layout");
+static_assert(offsetof(SharedRingHeader, closed) == 40, "shared ring header layout");
+static_assert(offsetof(SharedRingHeader, committed) == 64, "shared ring header layout");
+static_assert(offsetof(SharedRingHeader, reserved) == 72, "shared ring header layout");
+static_assert(offsetof(SharedRingHeader, futexWord) == 128, "shared ring header layout");
+static_assert(sizeof(SharedRingHeader) <= kSharedRingHeaderSize, "shared ring header size");
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(const std::string& name, size_t capacityFrames,
+    uint32_t sampleRate, uint32_t channels, uint32_t sampleType, uint32_t bytesPerFrame, std::string* error) {
+    std::string objectName = name.empty() || name[0] != '/' ? "/" + name : name;
+    size_t capacity = capacityFrames * bytesPerFrame;
+    size_t mappingSize = kSharedRingHeaderSize + capacity;
+
+    shm_unlink(objectName.c_str());
+    int fd = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        *error = "shm_open(" + objectName + ") failed: " + std::strerror(errno);
+        return nullptr;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(mappingSize)) < 0) {
+        *error = std::string("ftruncate failed: ") + std::strerror(errno);
+        close(fd);
+        shm_unlink(objectName.c_str());
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        *error = std::string("mmap failed: ") + std::strerror(errno);
+        close(fd);
+        shm_unlink(objectName.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing(objectName, fd, mapping, mappingSize));
+    SharedRingHeader* header = new (mapping) SharedRingHeader();
+    std::memcpy(header->magic, kSharedRingMagic, sizeof(kSharedRingMagic));
+    header->version = kSharedRingVersion;
+    header->headerSize = static_cast<uint32_t>(kSharedRingHeaderSize);
+    header->sampleRate = sampleRate;
+    header->channels = channels;
+    header->sampleType = sampleType;
+    header->bytesPerFrame = bytesPerFrame;
+    header->capacity = capacity;
+    header->closed.store(0, std::memory_order_relaxed);
+    header->committed.store(0, std::memory_order_relaxed);
+    header->reserved.store(0, std::memory_order_relaxed);
+    header->futexWord.store(0, std::memory_order_release);
+
+    ring->header = header;
+    ring->data = static_cast<uint8_t*>(mapping) + kSharedRingHeaderSize;
+    ring->capacity = capacity;
+    return ring;
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string& name, int fd, void* mapping, size_t mappingSize)
+    : name(name), fd(fd), mapping(mapping), mappingSize(mappingSize), header(nullptr), data(nullptr), capacity(0) {
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    Close();
+    munmap(mapping, mappingSize);
+    close(fd);
+    shm_unlink(name.c_str());
+}
+
+void SharedMemoryRing::Wake() {
+    header->futexWord.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->futexWord), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void SharedMemoryRing::Write(const uint8_t* source, size_t length) {
+    if (capacity == 0 || length == 0) {
+        return;
+    }
+    if (length > capacity) {
+        source += length - capacity;
+        length = capacity;
+    }
+
+    uint64_t start = header->committed.load(std::memory_order_relaxed);
+    header->reserved.store(start + length, std::memory_order_relaxed);
+    // Readers validate against `reserved` after copying, so it must be
+    // visible before any byte of the region is overwritten.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    size_t offset = static_cast<size_t>(start % capacity);
+    size_t first = std::min(length, capacity - offset);
+    std::memcpy(data + offset, source, first);
+    if (first < length) {
+        std::memcpy(data, source + first, length - first);
+    }
+
+    header->committed.store(start + length, std::memory_order_release);
+    Wake();
+}
+
+void SharedMemoryRing::Close() {
+    if (header->closed.exchange(1, std::memory_order_acq_rel) == 0) {
+        Wake();
+    }
+}
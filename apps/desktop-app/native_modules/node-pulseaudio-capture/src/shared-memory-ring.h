@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Fixed header at the start of the shared-memory object. The layout is read
+// directly by apps/backend/src/ai/audio/shared_capture_ring.py; bump
+// kSharedRingVersion on any change.
+//
+//   0  char[8]  magic "ANGLRING"
+//   8  u32      version
+//  12  u32      headerSize (offset of the sample data)
+//  16  u32      sampleRate
+//  20  u32      channels
+//  24  u32      sampleType (0 float32, 1 int16, 2 int32)
+//  28  u32      bytesPerFrame
+//  32  u64      capacity in bytes (a multiple of bytesPerFrame)
+//  40  u32      closed (set when capture stops)
+//  64  u64      committed: bytes written so far, published after each copy
+//  72  u64      reserved: committed + the size of the copy in progress
+// 128  u32      futex word, incremented after every write
+static const char kSharedRingMagic[8] = { 'A', 'N', 'G', 'L', 'R', 'I', 'N', 'G' };
+static const uint32_t kSharedRingVersion = 1;
+static const size_t kSharedRingHeaderSize = 4096;
+
+struct SharedRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t sampleType;
+    uint32_t bytesPerFrame;
+    uint64_t capacity;
+    std::atomic<uint32_t> closed;
+    alignas(64) std::atomic<uint64_t> committed;
+    std::atomic<uint64_t> reserved;
+    alignas(64) std::atomic<uint32_t> futexWord;
+};
+
+// Single-writer broadcast ring in a POSIX shared-memory object. The writer
+// never waits: readers track their own position and detect being lapped by
+// comparing it with `committed` (before reading) and `reserved` (after
+// reading). Readers block on the futex word, which is woken on every write.
+class SharedMemoryRing {
+public:
+    // Creates (replacing any stale object of the same name) and maps the
+    // ring. Returns null and fills `error` on failure.
+    static std::unique_ptr<SharedMemoryRing> Create(const std::string& name, size_t capacityFrames,
+        uint32_t sampleRate, uint32_t channels, uint32_t sampleType, uint32_t bytesPerFrame, std::string* error);
+
+    ~SharedMemoryRing();
+
+    void Write(const uint8_t* data, size_t length);
+
+    // Marks the ring closed and wakes readers; the object is unlinked on
+    // destruction but stays mapped in readers until they close it.
+    void Close();
+
+    const std::string& Name() const {
+        return name;
+    }
+
+    size_t CapacityFrames() const {
+        return capacity / header->bytesPerFrame;
+    }
+
+private:
+    SharedMemoryRing(const std::string& name, int fd, void* mapping, size_t mappingSize);
+
+    void Wake();
+
+    std::string name;
+    int fd;
+    void* mapping;
+    size_t mappingSize;
+    SharedRingHeader* header;
+    uint8_t* data;
+    size_t capacity;
+};
@@ -0,0 +1,156 @@
+#include "simd-kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PULSEAUDIO_CAPTURE_X86 1
+#endif
+
+static float DotProductScalar(const float* a, const float* b, size_t n) {
+    float sum0 = 0.0f;
+    float sum1 = 0.0f;
+    float sum2 = 0.0f;
+    float sum3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum0 += a[i] * b[i];
+        sum1 += a[i + 1] * b[i + 1];
+        sum2 += a[i + 2] * b[i + 2];
+        sum3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        sum0 += a[i] * b[i];
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+static void DownmixStereoScalar(const float* interleaved, float* mono, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        mono[i] = 0.5f * (interleaved[2 * i] + interleaved[2 * i + 1]);
+    }
+}
+
+#ifdef PULSEAUDIO_CAPTURE_X86
+
+__attribute__((target("sse3")))
+static float HorizontalSum(__m128 v) {
+    v = _mm_hadd_ps(v, v);
+    v = _mm_hadd_ps(v, v);
+    return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse3")))
+static float DotProductSse(const float* a, const float* b, size_t n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sum = HorizontalSum(_mm_add_ps(acc0, acc1));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("sse3")))
+static void DownmixStereoSse(const float* interleaved, float* mono, size_t frames) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 lo = _mm_loadu_ps(interleaved + 2 * i);
+        __m128 hi = _mm_loadu_ps(interleaved + 2 * i + 4);
+        __m128 left = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(mono + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+    DownmixStereoScalar(interleaved + 2 * i, mono + i, frames - i);
+}
+
+__attribute__((target("avx2,fma")))
+static float DotProductAvx2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum4 = _mm_hadd_ps(sum4, sum4);
+    sum4 = _mm_hadd_ps(sum4, sum4);
+    float sum = _mm_cvtss_f32(sum4);
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static void DownmixStereoAvx2(const float* interleaved, float* mono, size_t frames) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 lo = _mm256_loadu_ps(interleaved + 2 * i);
+        __m256 hi = _mm256_loadu_ps(interleaved + 2 * i + 8);
+        // hadd pairs (L+R) per 128-bit lane; the permute restores frame order.
+        __m256 sums = _mm256_hadd_ps(lo, hi);
+        sums = _mm256_permutevar8x32_ps(sums, order);
+        _mm256_storeu_ps(mono + i, _mm256_mul_ps(sums, half));
+    }
+    DownmixStereoScalar(interleaved + 2 * i, mono + i, frames - i);
+}
+
+#endif
+
+SimdLevel DetectSimdLevel() {
+#ifdef PULSEAUDIO_CAPTURE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse3")) {
+        return SimdLevel::Sse;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Sse:
+            return "sse";
+        default:
+            return "scalar";
+    }
+}
+
+SimdKernels GetSimdKernels(SimdLevel level) {
+    SimdLevel supported = DetectSimdLevel();
+    if (static_cast<int>(level) > static_cast<int>(supported)) {
+        level = supported;
+    }
+
+#ifdef PULSEAUDIO_CAPTURE_X86
+    if (level == SimdLevel::Avx2) {
+        return { SimdLevel::Avx2, DotProductAvx2, DownmixStereoAvx2 };
+    }
+    if (level == SimdLevel::Sse) {
+        return { SimdLevel::Sse, DotProductSse, DownmixStereoSse };
+    }
+#endif
+    return { SimdLevel::Scalar, DotProductScalar, DownmixStereoScalar };
+}
+
+SimdKernels GetSimdKernels() {
+    static const SimdKernels kernels = GetSimdKernels(DetectSimdLevel());
+    return kernels;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+enum class SimdLevel {
+    Scalar,
+    Sse,
+    Avx2
+};
+
+// Inner loops of the conversion stage. Each level is compiled with function
+// target attributes, so the addon itself is built for the baseline ISA and
+// the best level is picked at runtime.
+struct SimdKernels {
+    SimdLevel level;
+    float (*dotProduct)(const float* a, const float* b, size_t n);
+    void (*downmixStereo)(const float* interleaved, float* mono, size_t frames);
+};
+
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// Returns the kernels for `level`, clamped to what the CPU supports.
+SimdKernels GetSimdKernels(SimdLevel level);
+SimdKernels GetSimdKernels();
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+enum class OverflowPolicy {
+    DropOldest,
+    DropNewest
+};
+
+// Fixed-capacity single-producer/single-consumer ring of trivially copyable
+// elements. The producer is the PulseAudio mainloop thread, the consumer the
+// JS thread. Indices grow monotonically and are reduced modulo the capacity,
+// so the capacity does not need to be a power of two and can always hold a
+// whole number of frames.
+//
+// With DropOldest the producer may advance the read index itself. The
+// consumer detects this with a CAS on commit and retries the copy, so it
+// never returns samples that were overwritten while it was reading them.
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRingBuffer requires trivially copyable elements");
+
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    SpscRingBuffer(size_t capacity, OverflowPolicy policy)
+        : buffer(new T[capacity]), capacity(capacity), policy(policy) {
+    }
+
+    size_t Capacity() const {
+        return capacity;
+    }
+
+    OverflowPolicy Policy() const {
+        return policy;
+    }
+
+    size_t Available() const {
+        size_t write = writeIndex.load(std::memory_order_acquire);
+        size_t read = readIndex.load(std::memory_order_acquire);
+        return write - read;
+    }
+
+    size_t Dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    // Producer side. Returns the number of elements actually stored.
+    size_t Write(const T* src, size_t count) {
+        if (count > capacity) {
+            size_t skipped = count - capacity;
+            dropped.fetch_add(skipped, std::memory_order_relaxed);
+            if (policy == OverflowPolicy::DropOldest) {
+                src += skipped;
+            }
+            count = capacity;
+        }
+
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        size_t read = readIndex.load(std::memory_order_acquire);
+        size_t free = capacity - (write - read);
+
+        if (count > free) {
+            if (policy == OverflowPolicy::DropNewest) {
+                dropped.fetch_add(count - free, std::memory_order_relaxed);
+                count = free;
+            } else {
+                size_t need = count - free;
+                while (!readIndex.compare_exchange_weak(read, read + need,
+                        std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    free = capacity - (write - read);
+                    if (count <= free) {
+                        need = 0;
+                        break;
+                    }
+                    need = count - free;
+                }
+                dropped.fetch_add(need, std::memory_order_relaxed);
+            }
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+
+        CopyIn(write, src, count);
+        writeIndex.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side. Copies up to `count` elements into `dst` and returns
+    // the number copied.
+    size_t Read(T* dst, size_t count) {
+        while (true) {
+            size_t read = readIndex.load(std::memory_order_acquire);
+            size_t write = writeIndex.load(std::memory_order_acquire);
+            size_t n = std::min(count, write - read);
+            if (n == 0) {
+                return 0;
+            }
+
+            CopyOut(read, dst, n);
+
+            if (readIndex.compare_exchange_strong(read, read + n,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return n;
+            }
+        }
+    }
+
+    // Consumer side. Discards everything currently buffered.
+    void Clear() {
+        size_t read = readIndex.load(std::memory_order_acquire);
+        size_t write = writeIndex.load(std::memory_order_acquire);
+        while (read < write && !readIndex.compare_exchange_weak(read, write,
+                std::memory_order_acq_rel, std::memory_order_acquire)) {
+            write = writeIndex.load(std::memory_order_acquire);
+        }
+    }
+
+private:
+    void CopyIn(size_t index, const T* src, size_t count) {
+        size_t offset = index % capacity;
+        size_t first = std::min(count, capacity - offset);
+        std::memcpy(buffer.get() + offset, src, first * sizeof(T));
+        if (count > first) {
+            std::memcpy(buffer.get(), src + first, (count - first) * sizeof(T));
+        }
+    }
+
+    void CopyOut(size_t index, T* dst, size_t count) const {
+        size_t offset = index % capacity;
+        size_t first = std::min(count, capacity - offset);
+        std::memcpy(dst, buffer.get() + offset, first * sizeof(T));
+        if (count > first) {
+            std::memcpy(dst + first, buffer.get(), (count - first) * sizeof(T));
+        }
+    }
+
+    std::unique_ptr<T[]> buffer;
+    const size_t capacity;
+    const OverflowPolicy policy;
+
+    alignas(kCacheLine) std::atomic<size_t> writeIndex{0};
+    alignas(kCacheLine) std::atomic<size_t> readIndex{0};
+    alignas(kCacheLine) std::atomic<size_t> dropped{0};
+};
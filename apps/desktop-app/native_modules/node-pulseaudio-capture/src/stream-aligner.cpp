@@ -0,0 +1,167 @@
+#include "stream-aligner.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Drift filter: timestamps jitter by a fragment or so, clocks drift by tens
+// of ppm, so a slow average separates the two.
+static const double kOffsetSmoothing = 0.05;
+
+StreamAligner::StreamAligner(uint32_t sampleRate, const std::vector<uint32_t>& channels, size_t blockFrames,
+    size_t maxSkewFrames)
+    : sampleRate(sampleRate), blockFrames(std::max<size_t>(1, blockFrames)), maxSkewFrames(maxSkewFrames),
+      jumpFrames(sampleRate / 50), toleranceFrames(sampleRate / 4000.0), started(false), originNanos(0),
+      nextFrame(0) {
+    for (uint32_t count : channels) {
+        Source source;
+        source.channels = std::max<uint32_t>(1, count);
+        sources.push_back(source);
+    }
+}
+
+int64_t StreamAligner::TimelineFrame(int64_t nanos) const {
+    return static_cast<int64_t>(std::llround(static_cast<double>(nanos - originNanos) * sampleRate / 1e9));
+}
+
+void StreamAligner::Pad(Source& source, size_t frames) {
+    source.samples.insert(source.samples.end(), frames * source.channels, 0.0f);
+    source.tail += static_cast<int64_t>(frames);
+    source.stats.framesPadded += frames;
+}
+
+void StreamAligner::Append(Source& source, const float* data, size_t frames) {
+    if (data) {
+        source.samples.insert(source.samples.end(), data, data + frames * source.channels);
+        source.tail += static_cast<int64_t>(frames);
+    } else {
+        Pad(source, frames);
+    }
+}
+
+// Starts the timeline at the latest first timestamp and trims what the
+// earlier sources recorded before it.
+void StreamAligner::Begin() {
+    started = true;
+    originNanos = 0;
+    bool any = false;
+    for (const Source& source : sources) {
+        if (source.seen && (!any || source.firstNanos > originNanos)) {
+            originNanos = source.firstNanos;
+            any = true;
+        }
+    }
+
+    for (Source& source : sources) {
+        if (!source.seen) {
+            continue;
+        }
+        int64_t lead = TimelineFrame(source.firstNanos);
+        size_t trim = static_cast<size_t>(std::min<int64_t>(-lead, static_cast<int64_t>(source.Buffered())));
+        source.head += trim * source.channels;
+        source.stats.framesDropped += trim;
+        source.tail = static_cast<int64_t>(source.Buffered());
+        source.synced = true;
+    }
+}
+
+void StreamAligner::Push(size_t index, const float* data, size_t frames, int64_t captureNanos) {
+    if (index >= sources.size() || frames == 0) {
+        return;
+    }
+    Source& source = sources[index];
+
+    if (!started) {
+        if (!source.seen) {
+            source.seen = true;
+            source.firstNanos = captureNanos;
+        }
+        Append(source, data, frames);
+
+        bool allSeen = std::all_of(sources.begin(), sources.end(), [](const Source& s) { return s.seen; });
+        // A source that never delivers must not hold the others back.
+        if (allSeen || source.Buffered() > maxSkewFrames) {
+            Begin();
+        }
+        PadStalled();
+        return;
+    }
+
+    // Positive: the timestamps say these frames belong later than the tail,
+    // i.e. frames went missing; negative: the source is ahead.
+    int64_t error = TimelineFrame(captureNanos) - source.tail;
+    int64_t correction = 0;
+    if (!source.synced || std::abs(error) > jumpFrames) {
+        correction = error;
+        source.stats.offsetFrames = 0.0;
+        source.synced = true;
+    } else {
+        source.stats.offsetFrames += (static_cast<double>(error) - source.stats.offsetFrames) * kOffsetSmoothing;
+        if (std::abs(source.stats.offsetFrames) >= toleranceFrames) {
+            correction = static_cast<int64_t>(std::llround(source.stats.offsetFrames));
+            source.stats.offsetFrames -= static_cast<double>(correction);
+        }
+    }
+
+    if (correction != 0) {
+        source.stats.corrections++;
+    }
+    if (correction > 0) {
+        Pad(source, static_cast<size_t>(correction));
+    } else if (correction < 0) {
+        size_t drop = std::min(frames, static_cast<size_t>(-correction));
+        source.stats.framesDropped += drop;
+        frames -= drop;
+        if (data) {
+            data += drop * source.channels;
+        }
+    }
+
+    if (frames > 0) {
+        Append(source, data, frames);
+    }
+    PadStalled();
+}
+
+void StreamAligner::PadStalled() {
+    if (!started) {
+        return;
+    }
+    int64_t leader = 0;
+    for (const Source& source : sources) {
+        leader = std::max(leader, source.tail);
+    }
+    for (Source& source : sources) {
+        if (leader - source.tail > static_cast<int64_t>(maxSkewFrames)) {
+            Pad(source, static_cast<size_t>(leader - source.tail));
+            // Re-anchor on the next real fragment instead of filtering.
+            source.synced = false;
+        }
+    }
+}
+
+bool StreamAligner::Pop(AlignedBlock* block) {
+    if (!started) {
+        return false;
+    }
+    for (const Source& source : sources) {
+        if (source.Buffered() < blockFrames) {
+            return false;
+        }
+    }
+
+    block->frame = nextFrame;
+    block->sources.resize(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        Source& source = sources[i];
+        size_t count = blockFrames * source.channels;
+        block->sources[i].assign(source.samples.begin() + source.head, source.samples.begin() + source.head + count);
+        source.head += count;
+        // Compact once the consumed prefix dominates the buffer.
+        if (source.head > source.samples.size() / 2) {
+            source.samples.erase(source.samples.begin(), source.samples.begin() + source.head);
+            source.head = 0;
+        }
+    }
+    nextFrame += blockFrames;
+    return true;
+}
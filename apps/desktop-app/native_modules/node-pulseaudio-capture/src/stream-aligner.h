@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AlignedBlock {
+    // Position of the block's first frame on the common timeline.
+    uint64_t frame;
+    // Interleaved float samples, one vector per source.
+    std::vector<std::vector<float>> sources;
+};
+
+struct AlignerSourceStats {
+    uint64_t framesPadded = 0;
+    uint64_t framesDropped = 0;
+    uint64_t corrections = 0;
+    // Smoothed difference between where the source's timestamps place its
+    // samples and where they sit on the timeline, in frames.
+    double offsetFrames = 0.0;
+};
+
+// Puts N capture streams running at the same rate on one timeline.
+//
+// Each pushed fragment carries the monotonic capture time of its first
+// frame (derived from pa_stream_get_time). The timeline starts at the
+// latest first timestamp of all sources, so every source contributes from
+// frame 0. Afterwards a source's samples are placed by counting, and its
+// timestamps only steer corrections: a jump beyond 20 ms (a hole,
+// an xrun, a suspended device coming back) is corrected at once by padding
+// with silence or dropping, while clock drift between devices is filtered
+// and corrected in steps once it exceeds a quarter of a millisecond.
+// A source that stops delivering altogether (e.g. the monitor of a
+// suspended sink) is padded with silence once it falls `maxSkewFrames`
+// behind the source furthest ahead, so it cannot stall the others.
+//
+// Not thread-safe; the capture session calls it from the mainloop thread.
+class StreamAligner {
+public:
+    StreamAligner(uint32_t sampleRate, const std::vector<uint32_t>& channels, size_t blockFrames,
+        size_t maxSkewFrames);
+
+    // Appends `frames` interleaved frames for `source`. A null `data` is a
+    // hole in the stream and is filled with silence.
+    void Push(size_t source, const float* data, size_t frames, int64_t captureNanos);
+
+    // Moves the next block into `block` once every source has one.
+    bool Pop(AlignedBlock* block);
+
+    bool Started() const { return started; }
+    // Capture time of timeline frame 0, valid once started.
+    int64_t OriginNanos() const { return originNanos; }
+    size_t BlockFrames() const { return blockFrames; }
+    const AlignerSourceStats& Stats(size_t source) const { return sources[source].stats; }
+
+private:
+    struct Source {
+        uint32_t channels;
+        std::vector<float> samples;
+        size_t head = 0;
+        bool seen = false;
+        int64_t firstNanos = 0;
+        // Timeline frame just past the last buffered frame.
+        int64_t tail = 0;
+        // False until the source's timestamps have been matched against the
+        // timeline once (at start and after padding for a stall).
+        bool synced = false;
+        AlignerSourceStats stats;
+
+        size_t Buffered() const { return (samples.size() - head) / channels; }
+    };
+
+    void Begin();
+    int64_t TimelineFrame(int64_t nanos) const;
+    void Pad(Source& source, size_t frames);
+    void Append(Source& source, const float* data, size_t frames);
+    void PadStalled();
+
+    uint32_t sampleRate;
+    size_t blockFrames;
+    size_t maxSkewFrames;
+    int64_t jumpFrames;
+    double toleranceFrames;
+    std::vector<Source> sources;
+    bool started;
+    int64_t originNanos;
+    uint64_t nextFrame;
+};
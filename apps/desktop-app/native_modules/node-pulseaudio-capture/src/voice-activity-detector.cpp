@@ -0,0 +1,120 @@
+#include "voice-activity-detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+// How fast the noise floor follows non-speech frames (per frame), and how
+// fast it drops when a frame is quieter than the current floor.
+static const float kNoiseFloorRise = 0.02f;
+static const float kNoiseFloorFall = 0.3f;
+
+VoiceActivityDetector::VoiceActivityDetector(uint32_t rate, uint32_t channels, SampleType type, const VadConfig& config)
+    : channels(channels), type(type), config(config),
+      frameLength(std::max<size_t>(16, static_cast<size_t>(rate) * config.frameMs / 1000)),
+      attackFrames(std::max<uint32_t>(1, config.attackMs / std::max<uint32_t>(1, config.frameMs))),
+      hangoverFrames(std::max<uint32_t>(1, config.hangoverMs / std::max<uint32_t>(1, config.frameMs))),
+      fft(Fft::NextPowerOfTwo(frameLength)), window(frameLength), frame(frameLength),
+      padded(fft.Size(), 0.0f), power(fft.Size() / 2 + 1), fill(0),
+      position(0), noiseFloorInitialized(false), noiseFloorDb(0.0f),
+      active(false), speechRun(0), silenceRun(0), runStart(0) {
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < frameLength; i++) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * static_cast<double>(i) / (frameLength - 1)));
+    }
+
+    double binHz = static_cast<double>(rate) / fft.Size();
+    lowBin = std::max<size_t>(1, static_cast<size_t>(100.0 / binHz));
+    highBin = std::min(fft.Size() / 2, std::max(lowBin + 1, static_cast<size_t>(4000.0 / binHz)));
+}
+
+bool VoiceActivityDetector::Classify() {
+    double energy = 0.0;
+    size_t crossings = 0;
+    for (size_t i = 0; i < frameLength; i++) {
+        energy += static_cast<double>(frame[i]) * frame[i];
+        if (i > 0 && (frame[i] >= 0.0f) != (frame[i - 1] >= 0.0f)) {
+            crossings++;
+        }
+    }
+    float energyDb = static_cast<float>(10.0 * std::log10(energy / frameLength + 1e-12));
+    float zeroCrossingRate = static_cast<float>(crossings) / frameLength;
+
+    for (size_t i = 0; i < frameLength; i++) {
+        padded[i] = frame[i] * window[i];
+    }
+    fft.PowerSpectrum(padded.data(), power.data());
+
+    double logSum = 0.0;
+    double linearSum = 0.0;
+    for (size_t k = lowBin; k < highBin; k++) {
+        double p = static_cast<double>(power[k]) + 1e-12;
+        logSum += std::log(p);
+        linearSum += p;
+    }
+    size_t bins = highBin - lowBin;
+    float flatness = static_cast<float>(std::exp(logSum / bins) / (linearSum / bins));
+
+    if (!noiseFloorInitialized) {
+        noiseFloorDb = energyDb;
+        noiseFloorInitialized = true;
+    }
+
+    bool speech = energyDb > config.minEnergyDb
+        && energyDb > noiseFloorDb + config.thresholdDb
+        && flatness < config.maxFlatness
+        && zeroCrossingRate < config.maxZeroCrossingRate;
+
+    if (energyDb < noiseFloorDb) {
+        noiseFloorDb += kNoiseFloorFall * (energyDb - noiseFloorDb);
+    } else if (!speech) {
+        noiseFloorDb += kNoiseFloorRise * (energyDb - noiseFloorDb);
+    }
+
+    return speech;
+}
+
+void VoiceActivityDetector::Process(const void* data, size_t frames, std::vector<VadEvent>* events) {
+    float scale = 1.0f / static_cast<float>(channels);
+
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            sum += SampleToFloat(data, i * channels + c, type);
+        }
+        frame[fill++] = sum * scale;
+
+        if (fill < frameLength) {
+            continue;
+        }
+        fill = 0;
+
+        uint64_t frameEnd = position + i + 1;
+        uint64_t frameStart = frameEnd - frameLength;
+        bool speech = Classify();
+
+        if (!active) {
+            if (speech) {
+                if (speechRun == 0) {
+                    runStart = frameStart;
+                }
+                if (++speechRun >= attackFrames) {
+                    active = true;
+                    silenceRun = 0;
+                    events->push_back({ true, runStart });
+                }
+            } else {
+                speechRun = 0;
+            }
+        } else {
+            if (speech) {
+                silenceRun = 0;
+            } else if (++silenceRun >= hangoverFrames) {
+                active = false;
+                speechRun = 0;
+                events->push_back({ false, frameEnd });
+            }
+        }
+    }
+
+    position += frames;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fft.h"
+#include "sample-type.h"
+
+struct VadConfig {
+    // A frame is speech-like when its energy is this far above the tracked
+    // noise floor and above minEnergyDb.
+    float thresholdDb = 12.0f;
+    float minEnergyDb = -55.0f;
+    // Spectral flatness (0 = tonal, 1 = white noise) over 100 Hz..4 kHz.
+    float maxFlatness = 0.5f;
+    // Zero crossings per sample; fricatives stay well below this.
+    float maxZeroCrossingRate = 0.45f;
+    uint32_t frameMs = 20;
+    uint32_t attackMs = 60;
+    uint32_t hangoverMs = 300;
+};
+
+struct VadEvent {
+    bool speech;
+    // Stream position in frames. Speech starts are backdated to the first
+    // frame of the attack run; speech ends are the frame where the hangover
+    // expired.
+    uint64_t frame;
+};
+
+// Streaming energy / zero-crossing / spectral-flatness voice activity
+// detector with attack and hangover. Accepts interleaved input of any
+// channel count and averages the channels.
+class VoiceActivityDetector {
+public:
+    VoiceActivityDetector(uint32_t rate, uint32_t channels, SampleType type, const VadConfig& config);
+
+    // Appends transitions found while consuming `frames` frames to `events`.
+    void Process(const void* data, size_t frames, std::vector<VadEvent>* events);
+
+    bool Active() const {
+        return active;
+    }
+
+    uint64_t Position() const {
+        return position;
+    }
+
+    // Longest span (in frames) a speech start can be backdated by.
+    uint64_t MaxBackdateFrames() const {
+        return static_cast<uint64_t>(attackFrames + 1) * frameLength;
+    }
+
+    float NoiseFloorDb() const {
+        return noiseFloorDb;
+    }
+
+private:
+    bool Classify();
+
+    uint32_t channels;
+    SampleType type;
+    VadConfig config;
+    size_t frameLength;
+    uint32_t attackFrames;
+    uint32_t hangoverFrames;
+
+    Fft fft;
+    std::vector<float> window;
+    std::vector<float> frame;
+    std::vector<float> padded;
+    std::vector<float> power;
+    size_t fill;
+    size_t lowBin;
+    size_t highBin;
+
+    uint64_t position;
+    bool noiseFloorInitialized;
+    float noiseFloorDb;
+    bool active;
+    uint32_t speechRun;
+    uint32_t silenceRun;
+    uint64_t runStart;
+};
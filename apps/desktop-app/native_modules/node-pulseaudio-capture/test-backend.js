@@ -0,0 +1,365 @@
+// Delivery-path check on the fake backend; needs no sound server.
+// A 48 kHz stereo sine is converted to 16 kHz mono and delivered
+// unthrottled; blocks must be contiguous, gap-free and hold the tone.
+// Pull reads larger than the native buffer must be rejected, not hang, and
+// a live readRange() view must not keep its archive locked. VAD events must
+// agree with the blocks on stream position across a gap, and a rejected
+// start() must leave the previous history and archive readable in their
+// own format and no shared-memory segment behind, and stop() during a
+// pending start() or pause() must let start() follow at once.
+//
+// Usage: node test-backend.js
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const PulseAudioCapture = require('./index');
+
+const DURATION = 2;
+const FREQUENCY = 440;
+
+function run() {
+    return new Promise((resolve, reject) => {
+        const capture = new PulseAudioCapture();
+        const blocks = [];
+        let delivered = 0;
+
+        capture.on('gap', (gap) => reject(new Error(`unexpected gap: ${JSON.stringify(gap)}`)));
+        // 'ended' carries the stream frame the source stopped at. Once the
+        // blocks reach it (or one was dropped and they never will) the
+        // capture is complete.
+        capture.on('ended', ({ frame }) => {
+            waitFor(() => delivered >= frame || capture.getStats().blocksDropped > 0, `blocks up to frame ${frame}`)
+                .then(async () => {
+                    const stats = capture.getStats();
+                    await capture.stop();
+                    if (stats.blocksDropped > 0) {
+                        reject(new Error(`${stats.blocksDropped} blocks dropped`));
+                    } else {
+                        resolve({ blocks, stats });
+                    }
+                }, reject);
+        });
+
+        capture.start(null, (samples, info) => {
+            blocks.push({ samples: samples.slice(), info });
+            delivered = info.frame + samples.length;
+        }, {
+            rate: 48000,
+            channels: 2,
+            convert: { rate: 16000, channels: 1 },
+            bufferFrames: 16000 * DURATION * 2,
+            backend: { type: 'fake', source: 'sine', frequency: FREQUENCY, realtime: false, duration: DURATION }
+        }).then((format) => {
+            if (format.backend !== 'fake') {
+                reject(new Error(`expected the fake backend, got ${format.backend}`));
+            }
+        }, reject);
+    });
+}
+
+function assert(condition, message) {
+    if (!condition) {
+        throw new Error(message);
+    }
+}
+
+function delay(ms) {
+    return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+// Polls instead of sleeping a fixed time: blocks and events arrive through
+// separate queues, in no fixed order.
+function waitFor(predicate, what, timeoutMs = 5000) {
+    return new Promise((resolve, reject) => {
+        const deadline = Date.now() + timeoutMs;
+        const poll = () => {
+            if (predicate()) {
+                resolve();
+            } else if (Date.now() > deadline) {
+                reject(new Error(`timed out waiting for ${what}`));
+            } else {
+                setTimeout(poll, 10);
+            }
+        };
+        poll();
+    });
+}
+
+function writeWav(file, samples, rate) {
+    const header = Buffer.alloc(44);
+    header.write('RIFF', 0);
+    header.writeUInt32LE(36 + samples.byteLength, 4);
+    header.write('WAVEfmt ', 8);
+    header.writeUInt32LE(16, 16);
+    header.writeUInt16LE(3, 20);
+    header.writeUInt16LE(1, 22);
+    header.writeUInt32LE(rate, 24);
+    header.writeUInt32LE(rate * 4, 28);
+    header.writeUInt16LE(4, 32);
+    header.writeUInt16LE(32, 34);
+    header.write('data', 36);
+    header.writeUInt32LE(samples.byteLength, 40);
+    fs.writeFileSync(file, Buffer.concat([header, Buffer.from(samples.buffer)]));
+}
+
+async function expectError(promise, type, what) {
+    try {
+        await promise;
+    } catch (error) {
+        assert(error instanceof type, `${what} failed with ${error.name}, expected ${type.name}`);
+        return;
+    }
+    throw new Error(`${what} did not fail`);
+}
+
+async function checkReadLimit() {
+    const options = {
+        rate: 16000,
+        channels: 1,
+        backend: { type: 'fake', source: 'silence' }
+    };
+    const capture = new PulseAudioCapture();
+    await capture.start(null, null, Object.assign({ bufferFrames: 1600 }, options));
+    const { bufferFrames } = capture.getFormat();
+    assert(bufferFrames === 1600, `getFormat().bufferFrames is ${bufferFrames}, expected 1600`);
+    await expectError(capture.readFrames(bufferFrames + 1), RangeError, 'readFrames(bufferFrames + 1)');
+    const block = await capture.readFrames(bufferFrames);
+    assert(block.length === bufferFrames, `readFrames(bufferFrames) returned ${block.length} frames`);
+    await capture.stop();
+
+    const stream = new PulseAudioCapture().createReadStream(null,
+        Object.assign({ frames: 3200, highWaterMark: 1600 }, options));
+    await expectError(new Promise((resolve, reject) => {
+        stream.on('error', reject);
+        stream.on('data', resolve);
+    }), RangeError, 'createReadStream({ frames > highWaterMark })');
+}
+
+async function checkArchiveRestart() {
+    const archivePath = path.join(os.tmpdir(), `angela-test-archive-${process.pid}.bin`);
+    const options = (rate) => ({
+        rate,
+        channels: 1,
+        format: 's16le',
+        archive: { path: archivePath, seconds: 2 },
+        backend: { type: 'fake', source: 'sine' }
+    });
+    const capture = new PulseAudioCapture();
+    let last = 0;
+    try {
+        await capture.start(null, (samples, info) => {
+            last = info.timestamp;
+        }, options(16000));
+        await delay(300);
+        await capture.stop();
+        const range = capture.readRange(last - 200, last);
+        assert(range && range.chunks.length > 0, 'readRange() found nothing in the archive');
+        const view = range.chunks[0];
+        assert(view instanceof Int16Array, 'readRange() did not return s16le samples');
+        assert(range.valid(), 'a range of the newest audio is already invalid');
+
+        // A start() rejected after parsing another format must not change
+        // how the kept archive is read.
+        await expectError(capture.start(null, null, { rate: 48000, format: 'f32le', encode: 'opus' }),
+            TypeError, 'encode without a callback');
+        const kept = capture.readRange(last - 200, last);
+        assert(kept.chunks[0] instanceof Int16Array, 'a rejected start() changed the archive sample type');
+        assert(capture.getFormat().archive.seconds === 2,
+            `a rejected start() reports a ${capture.getFormat().archive.seconds} s archive`);
+
+        // A different rate rebuilds the archive on the same path.
+        await capture.start(null, () => {}, options(8000));
+        const { archive } = capture.getFormat();
+        assert(archive.frames === 8000 * 3, `rebuilt archive holds ${archive.frames} frames`);
+        assert(Number.isFinite(view[view.length - 1]), 'the old view is no longer readable');
+        assert(range.valid(), 'the old view became invalid when its file was replaced');
+        await capture.stop();
+    } finally {
+        fs.rmSync(archivePath, { force: true });
+    }
+}
+
+// Quiet noise with a one-second tone from 1 s, and 300 ms lost at 0.5 s
+// that the VAD never sees. speechStart must land on the frame and time of
+// the first block it releases.
+async function checkVadAfterGap() {
+    const rate = 16000;
+    const wavPath = path.join(os.tmpdir(), `angela-test-vad-${process.pid}.wav`);
+    const signal = new Float32Array(rate * 2.5);
+    let noise = 1;
+    for (let i = 0; i < signal.length; i++) {
+        noise = (Math.imul(noise, 1103515245) + 12345) >>> 0;
+        signal[i] = 0.001 * (noise / 2147483648 - 1);
+        if (i >= rate && i < rate * 2) {
+            signal[i] += 0.5 * Math.sin(2 * Math.PI * 440 * i / rate);
+        }
+    }
+    writeWav(wavPath, signal, rate);
+
+    const capture = new PulseAudioCapture();
+    const blocks = [];
+    const starts = [];
+    const gaps = [];
+    let speechEnd = null;
+    let ended = false;
+    capture.on('speechStart', (event) => starts.push(event));
+    capture.on('speechEnd', (event) => {
+        speechEnd = event;
+    });
+    capture.on('gap', (gap) => gaps.push(gap));
+    capture.on('ended', () => {
+        ended = true;
+    });
+    try {
+        await capture.start(null, (samples, info) => {
+            blocks.push({ frame: info.frame, timestamp: info.timestamp, end: info.frame + samples.length });
+        }, {
+            rate,
+            channels: 1,
+            vad: true,
+            bufferFrames: rate * 4,
+            backend: { type: 'fake', path: wavPath, realtime: false, gap: { at: 0.5, seconds: 0.3 } }
+        });
+        await waitFor(() => ended && speechEnd && blocks.length > 0
+            && blocks[blocks.length - 1].end >= speechEnd.sampleOffset, 'the gated speech');
+        await capture.stop();
+    } finally {
+        fs.rmSync(wavPath, { force: true });
+    }
+
+    assert(gaps.length === 1 && Math.abs(gaps[0].frames - rate * 0.3) <= 1,
+        `expected one 300 ms gap, got ${JSON.stringify(gaps)}`);
+    assert(starts.length === 1, `expected one speechStart, got ${starts.length}`);
+    const [start] = starts;
+    assert(start.sampleOffset === blocks[0].frame,
+        `speechStart at frame ${start.sampleOffset}, first speech block at ${blocks[0].frame}`);
+    assert(Math.abs(start.timestamp - blocks[0].timestamp) < 0.001,
+        `speechStart at ${start.timestamp} ms, first speech block at ${blocks[0].timestamp} ms`);
+    assert(start.sampleOffset > rate * 1.1, `speechStart at frame ${start.sampleOffset} ignores the gap`);
+}
+
+async function checkHistoryAfterRejectedStart() {
+    const capture = new PulseAudioCapture();
+    await capture.start(null, () => {}, {
+        rate: 16000,
+        channels: 1,
+        history: 1,
+        backend: { type: 'fake', source: 'sine' }
+    });
+    await delay(200);
+    await capture.stop();
+    const before = capture.snapshot();
+
+    // Fails after the new rate and channels have been parsed.
+    await expectError(capture.start(null, () => {}, {
+        rate: 48000,
+        channels: 2,
+        history: 1,
+        backend: { type: 'fake', gap: { at: -1, seconds: 1 } }
+    }), RangeError, 'start() with a negative gap');
+
+    const after = capture.snapshot();
+    assert(after.samples.length === before.samples.length && after.frame === before.frame,
+        `snapshot changed after a rejected start(): ${after.samples.length} samples at frame ${after.frame}, `
+        + `was ${before.samples.length} at ${before.frame}`);
+    assert(capture.getFormat().history.seconds === 1, 'getFormat().history changed after a rejected start()');
+
+    // Rejected only once the backend fails to open the file.
+    await expectError(capture.start(null, () => {}, {
+        rate: 48000,
+        channels: 2,
+        history: 2,
+        backend: { type: 'fake', path: path.join(os.tmpdir(), `angela-test-missing-${process.pid}.wav`) }
+    }), Error, 'start() with a missing file');
+
+    const afterAsync = capture.snapshot();
+    assert(afterAsync.samples.length === before.samples.length && afterAsync.frame === before.frame,
+        `snapshot changed after an asynchronously rejected start(): ${afterAsync.samples.length} samples `
+        + `at frame ${afterAsync.frame}, was ${before.samples.length} at ${before.frame}`);
+    assert(capture.getFormat().history.seconds === 1,
+        'getFormat().history changed after an asynchronously rejected start()');
+}
+
+async function checkSharedMemoryAfterRejectedStart() {
+    const name = `angela-test-${process.pid}`;
+    // encode without a callback is rejected.
+    await expectError(new PulseAudioCapture().start(null, null, {
+        encode: 'opus',
+        sharedMemory: { name },
+        backend: { type: 'fake' }
+    }), TypeError, 'start() with encode and no callback');
+    assert(!fs.existsSync(`/dev/shm/${name}`), 'a rejected start() left its shared-memory segment behind');
+}
+
+// stop() while start() or pause() is pending settles only after the
+// teardown, so start() can follow it at once.
+async function checkStopWhilePending() {
+    const options = {
+        rate: 16000,
+        channels: 1,
+        backend: { type: 'fake', source: 'silence' }
+    };
+    const capture = new PulseAudioCapture();
+    const starting = capture.start(null, () => {}, options);
+    await capture.stop();
+    await expectError(starting, Error, 'start() cancelled by stop()');
+    await capture.start(null, () => {}, options);
+
+    const pausing = capture.pause();
+    // pause() reaches the native side in the next microtask.
+    await null;
+    await capture.stop();
+    await pausing;
+    assert(!capture.isCapturing, 'capture still running after stop() during pause()');
+    await capture.start(null, () => {}, options);
+    await capture.stop();
+}
+
+async function main() {
+    await checkReadLimit();
+    await checkStopWhilePending();
+    await checkSharedMemoryAfterRejectedStart();
+    await checkHistoryAfterRejectedStart();
+    await checkArchiveRestart();
+    await checkVadAfterGap();
+
+    const { blocks, stats } = await run();
+
+    let frame = 0;
+    let sequence = 0;
+    for (const { samples, info } of blocks) {
+        assert(info.sequence === sequence, `block ${sequence} has sequence ${info.sequence}`);
+        assert(info.frame === frame, `block ${sequence} starts at frame ${info.frame}, expected ${frame}`);
+        assert(info.gap === 0 && info.dropped === 0, `block ${sequence} reports lost audio`);
+        frame += samples.length;
+        sequence++;
+    }
+
+    // The resampler holds back its filter delay at the end.
+    const expected = 16000 * DURATION;
+    assert(Math.abs(frame - expected) < 64, `delivered ${frame} frames, expected about ${expected}`);
+
+    // Zero crossings in the steady part give the frequency back.
+    const all = new Float32Array(frame);
+    let offset = 0;
+    for (const { samples } of blocks) {
+        all.set(samples, offset);
+        offset += samples.length;
+    }
+    let crossings = 0;
+    for (let i = 1601; i < all.length - 1600; i++) {
+        if ((all[i - 1] < 0) !== (all[i] < 0)) crossings++;
+    }
+    const measured = crossings / 2 / ((all.length - 3201) / 16000);
+    assert(Math.abs(measured - FREQUENCY) < 2, `measured ${measured.toFixed(1)} Hz, expected ${FREQUENCY}`);
+
+    console.log(`OK: ${blocks.length} blocks, ${frame} frames, ${measured.toFixed(1)} Hz`);
+    console.log(`callback p50/p99: ${stats.callbackDuration.p50Us}/${stats.callbackDuration.p99Us} us, `
+        + `delivery p50/p99: ${stats.deliveryLatency.p50Us}/${stats.deliveryLatency.p99Us} us`);
+}
+
+main().catch((error) => {
+    console.error('FAIL:', error.message);
+    process.exit(1);
+});
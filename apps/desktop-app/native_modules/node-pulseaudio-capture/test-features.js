@@ -0,0 +1,93 @@
+// Numeric equivalence check between the native feature extractor and the
+// backend's AudioSpectralEncoder (_stft -> _mel_spectrogram -> _mfcc).
+//
+// Usage: node test-features.js   (needs python3 with numpy; set PYTHON to override)
+
+const { execFileSync } = require('child_process');
+const path = require('path');
+const PulseAudioCapture = require('./index');
+
+const ENCODER_PATH = path.resolve(__dirname, '../../../backend/src/ai/multimodal/audio_encoder_spectral.py');
+const SAMPLE_RATE = 16000;
+const TOLERANCE = 1e-3;
+
+const REFERENCE_SCRIPT = `
+import importlib.util, json, sys
+import numpy as np
+spec = importlib.util.spec_from_file_location("audio_encoder_spectral", sys.argv[1])
+module = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(module)
+encoder = module.AudioSpectralEncoder()
+samples = np.array(json.load(sys.stdin), dtype=np.float32)
+log_mel = encoder._mel_spectrogram(np.abs(encoder._stft(samples)))
+mfcc = encoder._mfcc(log_mel)
+json.dump({
+    "nMels": encoder.N_MELS, "nMfcc": encoder.N_MFCC,
+    "logMel": log_mel.T.ravel().tolist(), "mfcc": mfcc.T.ravel().tolist()
+}, sys.stdout)
+`;
+
+// Deterministic mix of tones, a chirp and LCG noise, 1.5 s at 16 kHz.
+function makeSignal() {
+    const samples = new Float32Array(SAMPLE_RATE * 1.5);
+    let seed = 12345;
+    for (let i = 0; i < samples.length; i++) {
+        const t = i / SAMPLE_RATE;
+        seed = (seed * 1103515245 + 12345) >>> 0;
+        const noise = (seed / 4294967296) * 2 - 1;
+        samples[i] = 0.3 * Math.sin(2 * Math.PI * 220 * t)
+            + 0.1 * Math.sin(2 * Math.PI * (500 + 2000 * t) * t)
+            + 0.02 * noise;
+    }
+    return samples;
+}
+
+function maxAbsDiff(a, b) {
+    let max = 0;
+    for (let i = 0; i < a.length; i++) {
+        max = Math.max(max, Math.abs(a[i] - b[i]));
+    }
+    return max;
+}
+
+function main() {
+    const samples = makeSignal();
+
+    let reference;
+    try {
+        const output = execFileSync(process.env.PYTHON || 'python3', ['-c', REFERENCE_SCRIPT, ENCODER_PATH], {
+            input: JSON.stringify(Array.from(samples)),
+            maxBuffer: 64 * 1024 * 1024
+        });
+        reference = JSON.parse(output.toString());
+    } catch (error) {
+        console.log(`Skipped: reference encoder unavailable (${error.message.split('\n')[0]})`);
+        return;
+    }
+
+    const native = PulseAudioCapture.extractFeatures(samples, { sampleRate: SAMPLE_RATE });
+    const failures = [];
+
+    if (native.melBands !== reference.nMels || native.mfccCount !== reference.nMfcc) {
+        failures.push(`shape: native ${native.melBands}/${native.mfccCount}, encoder ${reference.nMels}/${reference.nMfcc}`);
+    }
+    if (native.logMel.length !== reference.logMel.length || native.mfcc.length !== reference.mfcc.length) {
+        failures.push(`frames: native ${native.frames}, encoder ${reference.logMel.length / reference.nMels}`);
+    }
+
+    if (failures.length === 0) {
+        const logMelError = maxAbsDiff(native.logMel, reference.logMel);
+        const mfccError = maxAbsDiff(native.mfcc, reference.mfcc);
+        console.log(`Frames: ${native.frames}, max |log-mel diff|: ${logMelError.toExponential(2)}, max |MFCC diff|: ${mfccError.toExponential(2)}`);
+        if (!(logMelError < TOLERANCE)) failures.push(`log-mel differs by ${logMelError}`);
+        if (!(mfccError < TOLERANCE)) failures.push(`MFCC differs by ${mfccError}`);
+    }
+
+    if (failures.length > 0) {
+        failures.forEach((failure) => console.error(`FAIL ${failure}`));
+        process.exit(1);
+    }
+    console.log('Native features match AudioSpectralEncoder');
+}
+
+main();
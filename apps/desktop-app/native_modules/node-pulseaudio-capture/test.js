@@ -36,6 +36,9 @@ async function testPulseAudioCapture() {
             
             if (sampleCount >= 48000) {
                 console.log(`\nTotal samples received: ${sampleCount}`);
+                const stats = capture.getStats();
+                console.log(`Fragments: ${stats.fragmentsRead}, dropped blocks: ${stats.blocksDropped}, queue high-water: ${stats.queueHighWater}`);
+                console.log(`Delivery latency p50/p99: ${stats.deliveryLatency.p50Us}/${stats.deliveryLatency.p99Us} us`);
                 capture.stop().then(() => {
                     console.log('Capture stopped successfully');
                     process.exit(0);